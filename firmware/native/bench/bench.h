@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal benchmark harness for env:native. Each case is run once to warm up,
+// then timed over `iterations` calls with heap accounting from the shim.
+
+#include <Arduino.h>
+#include <native_shim.h>
+#include <chrono>
+
+namespace Bench {
+
+void section(const char* title);
+void report(const char* name, size_t iterations, double totalNs, const NativeShim::HeapStats& heap);
+
+template <typename Fn>
+void run(const char* name, size_t iterations, Fn&& fn) {
+    NativeShim::setSerialEnabled(false);
+    fn();
+
+    NativeShim::resetHeapStats();
+    size_t liveBefore = NativeShim::heapStats().liveBytes;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    NativeShim::HeapStats heap = NativeShim::heapStats();
+    heap.peakLiveBytes -= liveBefore;
+    NativeShim::setSerialEnabled(true);
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    report(name, iterations, ns, heap);
+}
+
+// Keeps the optimizer from discarding a computed value.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
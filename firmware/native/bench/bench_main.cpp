@@ -0,0 +1,521 @@
+#include "bench.h"
+#include "history.h"
+#include "psychrometrics.h"
+#include "sensors.h"
+#include "sensor_config.h"
+#include "sensor_graph.h"
+#include "devices.h"
+#include "device_modes.h"
+#include "registry.h"
+#include "http_engine.h"
+#include "json_scan.h"
+#include "mock_plug.h"
+#include "websocket_server.h"
+#include "ws_frame.h"
+#include "socket_budget.h"
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include <native_shim.h>
+#include <string>
+
+void setup();
+void loop();
+
+namespace {
+    // 10 sensors (two calculated) and 6 devices, matching a typical tent.
+    const char* SENSORS_FIXTURE = R"([
+        {"id":"t_canopy","name":"Canopy temp","type":"temperature","unit":"°C","hardwareType":"sht4x","oversample":5},
+        {"id":"h_canopy","name":"Canopy RH","type":"humidity","unit":"%","hardwareType":"sht4x","oversample":5,"smoothing":0.5},
+        {"id":"t_room","name":"Room temp","type":"temperature","unit":"°C","hardwareType":"sht3x"},
+        {"id":"h_room","name":"Room RH","type":"humidity","unit":"%","hardwareType":"sht3x"},
+        {"id":"co2","name":"CO2","type":"co2","unit":"ppm","hardwareType":"scd4x"},
+        {"id":"t_scd","name":"SCD temp","type":"temperature","unit":"°C","hardwareType":"scd4x"},
+        {"id":"h_scd","name":"SCD RH","type":"humidity","unit":"%","hardwareType":"scd4x"},
+        {"id":"ppfd","name":"PPFD","type":"light","unit":"µmol","hardwareType":"as7341"},
+        {"id":"vpd","name":"VPD","type":"vpd","unit":"kPa","hardwareType":"calculated","tempSourceId":"t_canopy","humSourceId":"h_canopy","leafTempOffset":2},
+        {"id":"dew","name":"Dew point","type":"dewpoint","unit":"°C","hardwareType":"calculated","tempSourceId":"t_room","humSourceId":"h_room"}
+    ])";
+
+    const char* DEVICES_FIXTURE = R"([
+        {"id":"fan","name":"Exhaust fan","type":"fan","controlMethod":"shelly_gen2","ipAddress":"10.0.0.11","hasEnergyMonitoring":true},
+        {"id":"light","name":"Light","type":"light","controlMethod":"shelly_gen2","ipAddress":"10.0.0.12","hasEnergyMonitoring":true},
+        {"id":"humid","name":"Humidifier","type":"humidifier","controlMethod":"tasmota","ipAddress":"10.0.0.13","hasEnergyMonitoring":true},
+        {"id":"dehum","name":"Dehumidifier","type":"dehumidifier","controlMethod":"tasmota","ipAddress":"10.0.0.14","hasEnergyMonitoring":false},
+        {"id":"heater","name":"Heater","type":"heater","controlMethod":"shelly_gen1","ipAddress":"10.0.0.15","hasEnergyMonitoring":true},
+        {"id":"pump","name":"Pump","type":"pump","controlMethod":"shelly_gen1","ipAddress":"10.0.0.16","hasEnergyMonitoring":false}
+    ])";
+
+    const char* MODES_FIXTURE = R"([
+        {"deviceId":"fan","mode":"auto","triggers":[{"sensorId":"t_canopy","dayThreshold":26,"nightThreshold":22,"deadzone":0.5,"triggerAbove":true},{"sensorId":"h_canopy","dayThreshold":65,"nightThreshold":60,"deadzone":2,"triggerAbove":true}]},
+        {"deviceId":"humid","mode":"auto","triggers":[{"sensorId":"vpd","dayThreshold":1.2,"nightThreshold":1.0,"deadzone":0.1,"triggerAbove":true}]},
+        {"deviceId":"dehum","mode":"auto","triggers":[{"sensorId":"h_room","dayThreshold":60,"nightThreshold":55,"deadzone":2,"triggerAbove":true}]},
+        {"deviceId":"light","mode":"schedule","schedule":{"startTime":"06:00","endTime":"22:00"}},
+        {"deviceId":"pump","mode":"cycle","cycle":{"onDurationSec":60,"offDurationSec":600,"dayOnly":false}}
+    ])";
+
+    void writeFixture(const char* path, const char* content) {
+        File file = LittleFS.open(path, "w");
+        file.write((const uint8_t*)content, strlen(content));
+        file.close();
+    }
+
+    void resetFilesystem() {
+        std::string cmd = std::string("rm -rf ") + NativeShim::fsRoot();
+        if (system(cmd.c_str()) != 0) {
+            Serial.printf("[Bench] Failed to clear %s\n", NativeShim::fsRoot());
+        }
+        LittleFS.begin(true);
+        writeFixture("/sensors.json", SENSORS_FIXTURE);
+        writeFixture("/devices.json", DEVICES_FIXTURE);
+        writeFixture("/device_modes.json", MODES_FIXTURE);
+    }
+
+    void benchHistory() {
+        Bench::section("History");
+
+        Bench::run("History::record (1 sensor)", 100000, [] {
+            History::record("t_canopy", 24.5f);
+        });
+
+        size_t count;
+        const char** ids = SensorConfig::getSensorIds(count);
+        Bench::run("History::record (all sensors)", 10000, [ids, count] {
+            for (size_t i = 0; i < count; i++) {
+                History::record(ids[i], 24.5f);
+            }
+        });
+
+        static uint8_t buffer[History::POINTS_7D * sizeof(History::HistoryPoint)];
+        Bench::run("History::getHistory (7d)", 10000, [] {
+            Bench::doNotOptimize(History::getHistory("t_canopy", History::RANGE_7D, buffer, sizeof(buffer)));
+        });
+    }
+
+    void benchSensors() {
+        Bench::section("Sensors");
+
+        // Wait for the sensor task to publish a complete first round
+        Sensors::Snapshot snapshot;
+        unsigned long deadline = millis() + 2000;
+        while ((!Sensors::readSnapshot(snapshot) || !snapshot.as7341.valid) &&
+               (long)(millis() - deadline) < 0) {
+            delay(10);
+        }
+
+        Bench::run("Sensors::readSnapshot", 100000, [&snapshot] {
+            Bench::doNotOptimize(Sensors::readSnapshot(snapshot));
+        });
+        // A new round every call, so each one is a full topological pass
+        Bench::run("SensorGraph::evaluate (all sensors)", 100000, [&snapshot] {
+            snapshot.round++;
+            Bench::doNotOptimize(SensorGraph::evaluate(snapshot).values[0]);
+        });
+        Bench::run("Sensors::getSensorValue (hardware)", 100000, [] {
+            Bench::doNotOptimize(Sensors::getSensorValue("t_canopy"));
+        });
+        Bench::run("Sensors::getSensorValue (vpd)", 100000, [] {
+            Bench::doNotOptimize(Sensors::getSensorValue("vpd"));
+        });
+        Bench::run("Sensors::getSensorValue (dewpoint)", 100000, [] {
+            Bench::doNotOptimize(Sensors::getSensorValue("dew"));
+        });
+    }
+
+    // Worst-case error of each table kernel against its closed-form reference
+    // over the table range; returns false when a documented bound is exceeded.
+    bool checkPsychrometrics() {
+        using namespace Psychrometrics;
+        struct Kernel {
+            const char* name;
+            float (*fast)(float, float);
+            float (*exact)(float, float);
+            float bound;
+            float worst;
+        };
+        Kernel kernels[] = {
+            {"saturationVaporPressure (kPa)", [](float t, float) { return saturationVaporPressure(t); },
+                [](float t, float) { return Exact::saturationVaporPressure(t); }, 0.01f, 0},
+            {"vaporPressureDeficit (kPa)", [](float t, float rh) { return vaporPressureDeficit(t, rh, 2.0f); },
+                [](float t, float rh) { return Exact::vaporPressureDeficit(t, rh, 2.0f); }, 0.01f, 0},
+            {"dewPoint (°C)", [](float t, float rh) { return dewPoint(t, rh); },
+                [](float t, float rh) { return Exact::dewPoint(t, rh); }, 0.02f, 0},
+            {"absoluteHumidity (g/m³)", [](float t, float rh) { return absoluteHumidity(t, rh); },
+                [](float t, float rh) { return Exact::absoluteHumidity(t, rh); }, 0.06f, 0},
+            {"enthalpy (kJ/kg)", [](float t, float rh) { return enthalpy(t, rh); },
+                [](float t, float rh) { return Exact::enthalpy(t, rh); }, 0.5f, 0},
+        };
+
+        for (float t = TABLE_MIN_C; t < TABLE_MAX_C; t += 0.05f) {
+            for (float rh = 1.0f; rh <= 100.0f; rh += 0.5f) {
+                for (auto& k : kernels) {
+                    k.worst = max(k.worst, fabsf(k.fast(t, rh) - k.exact(t, rh)));
+                }
+            }
+        }
+
+        bool ok = true;
+        for (auto& k : kernels) {
+            bool pass = k.worst <= k.bound;
+            ok = ok && pass;
+            Serial.printf("  %-40s max error %.5f (bound %.2f) %s\n", k.name, k.worst, k.bound, pass ? "ok" : "FAIL");
+        }
+        return ok;
+    }
+
+    bool benchPsychrometrics() {
+        Bench::section("Psychrometrics");
+
+        // Typical tent readings; cycling keeps the inputs opaque to the optimizer
+        static const float temps[] = {18.4f, 21.7f, 24.9f, 27.3f, 30.1f, 25.5f, 22.2f, 19.8f};
+        static const float hums[] = {45.2f, 52.8f, 58.1f, 63.7f, 71.4f, 66.0f, 55.5f, 48.9f};
+        static size_t i = 0;
+
+        Bench::run("vaporPressureDeficit (exact)", 1000000, [] {
+            i = (i + 1) & 7;
+            Bench::doNotOptimize(Psychrometrics::Exact::vaporPressureDeficit(temps[i], hums[i], 2.0f));
+        });
+        Bench::run("vaporPressureDeficit (table)", 1000000, [] {
+            i = (i + 1) & 7;
+            Bench::doNotOptimize(Psychrometrics::vaporPressureDeficit(temps[i], hums[i], 2.0f));
+        });
+        Bench::run("dewPoint (exact)", 1000000, [] {
+            i = (i + 1) & 7;
+            Bench::doNotOptimize(Psychrometrics::Exact::dewPoint(temps[i], hums[i]));
+        });
+        Bench::run("dewPoint (table)", 1000000, [] {
+            i = (i + 1) & 7;
+            Bench::doNotOptimize(Psychrometrics::dewPoint(temps[i], hums[i]));
+        });
+
+        return checkPsychrometrics();
+    }
+
+    void benchMessages() {
+        Bench::section("WebSocket dispatch");
+
+        Bench::run("handleMessage ping", 10000, [] {
+            NativeShim::injectWsMessage(1, R"({"type":"ping"})");
+        });
+        Bench::run("handleMessage get_sensors", 10000, [] {
+            NativeShim::injectWsMessage(1, R"({"type":"get_sensors"})");
+        });
+        Bench::run("handleMessage get_devices", 10000, [] {
+            NativeShim::injectWsMessage(1, R"({"type":"get_devices"})");
+        });
+        Bench::run("handleMessage get_init", 2000, [] {
+            NativeShim::injectWsMessage(1, R"({"type":"get_init"})");
+        });
+        Bench::run("handleMessage get_history 6h", 2000, [] {
+            NativeShim::injectWsMessage(1, R"({"type":"get_history","data":{"sensorId":"t_canopy","range":"6h"}})");
+        });
+
+        NativeShim::resetWsStats();
+        NativeShim::injectWsMessage(1, R"({"type":"get_init"})");
+        NativeShim::WsStats ws = NativeShim::wsStats();
+        Serial.printf("  get_init: %zu frames, %zu bytes\n", ws.frames, ws.bytes);
+
+        // An edit reaches clients as a delta of the one device, not the list
+        NativeShim::injectWsMessage(1, R"({"type":"get_devices"})");
+        size_t fullBytes = NativeShim::wsStats().lastFrameBytes;
+        JsonDocument delta;
+        Devices::takeChanges(delta.to<JsonObject>());
+        NativeShim::setSerialEnabled(false);
+        NativeShim::injectWsMessage(1, R"({"type":"update_device","data":{"id":"pump","name":"Pump"}})");
+        NativeShim::setSerialEnabled(true);
+        delta.clear();
+        delta["type"] = "devices_delta";
+        Devices::takeChanges(delta["data"].to<JsonObject>());
+        Serial.printf("  update_device: %zu byte delta, %zu byte full list\n", measureJson(delta), fullBytes);
+
+        // A broadcast queues one shared buffer however many clients wait on it
+        NativeShim::setWsClients(SocketBudget::WS_CLIENTS);
+        WebSocketServer::loop();
+        WsFrame::Stats before = WsFrame::getStats();
+        JsonDocument devices;
+        devices["type"] = "devices";
+        Devices::getDevicesJson(devices["data"].to<JsonVariant>());
+        WebSocketServer::broadcast(devices);
+        WsFrame::Stats after = WsFrame::getStats();
+        Serial.printf("  devices to %zu clients: %zu frame, %zu bytes queued\n", SocketBudget::WS_CLIENTS,
+            after.live - before.live, after.liveBytes - before.liveBytes);
+
+        // A client that can't send keeps only the newest state per key, but
+        // every event
+        WebSocketServer::loop();
+        for (int i = 0; i < 100; i++) {
+            WebSocketServer::broadcast(devices, "devices");
+            if (i % 25 == 0) WebSocketServer::broadcast(devices);
+        }
+        Serial.printf("  100 state + 4 event broadcasts behind a stalled client: %zu frames queued\n",
+            WebSocketServer::getDeferredCount() / SocketBudget::WS_CLIENTS);
+        WebSocketServer::loop();
+        NativeShim::setWsClients(1);
+    }
+
+    // Runs loop() back to back on the real clock, so sensor conversions finish
+    // in real time and a driver that blocks shows up as a long iteration.
+    void benchLoopLatency() {
+        NativeShim::setSerialEnabled(false);
+        unsigned long worstUs = 0;
+        size_t iterations = 0;
+        unsigned long end = millis() + 3000;
+        while ((long)(millis() - end) < 0) {
+            unsigned long start = micros();
+            loop();
+            worstUs = max(worstUs, micros() - start);
+            iterations++;
+        }
+        NativeShim::setSerialEnabled(true);
+        Serial.printf("  loop() worst iteration over 3 s: %.2f ms (%zu iterations)\n",
+            worstUs / 1000.0, iterations);
+    }
+
+    const char* SWEEP_PATHS[] = {"/cm?cmnd=Status%200", "/relay/0", "/rpc/Switch.GetStatus?id=0"};
+
+    // Queries every plug once, keeping the engine's slots full
+    unsigned long sweep(const MockPlug::Plug* plugs, size_t count, size_t& answered) {
+        size_t next = 0;
+        size_t done = 0;
+        answered = 0;
+        auto onResponse = [&](const HttpEngine::Response& response) {
+            done++;
+            if (response.status == HttpEngine::Status::OK && response.httpCode == 200) answered++;
+        };
+
+        unsigned long start = millis();
+        while (done < count) {
+            while (next < count && HttpEngine::hasFreeSlot()) {
+                HttpEngine::Request request = {};
+                snprintf(request.host, sizeof(request.host), "127.0.0.1:%u", plugs[next].port);
+                strlcpy(request.path, SWEEP_PATHS[next % 3], sizeof(request.path));
+                request.connectTimeoutMs = 1000;
+                request.timeoutMs = 1000;
+                request.tag = next;
+                HttpEngine::start(request);
+                next++;
+            }
+            HttpEngine::poll(20, onResponse);
+        }
+        return millis() - start;
+    }
+
+    // Each path once on each unit, keeping the engine's slots full
+    unsigned long sweepUnits(const MockPlug::Plug* plugs, size_t count, const char* const* paths,
+                             size_t pathCount, size_t& bytes) {
+        size_t total = count * pathCount;
+        size_t next = 0;
+        size_t done = 0;
+        bytes = 0;
+        auto onResponse = [&](const HttpEngine::Response& response) {
+            done++;
+            bytes += response.bodyLength;
+        };
+
+        unsigned long start = millis();
+        while (done < total) {
+            while (next < total && HttpEngine::hasFreeSlot()) {
+                HttpEngine::Request request = {};
+                snprintf(request.host, sizeof(request.host), "127.0.0.1:%u", plugs[next / pathCount].port);
+                strlcpy(request.path, paths[next % pathCount], sizeof(request.path));
+                request.connectTimeoutMs = 1000;
+                request.timeoutMs = 1000;
+                request.tag = next;
+                HttpEngine::start(request);
+                next++;
+            }
+            HttpEngine::poll(20, onResponse);
+        }
+        return millis() - start;
+    }
+
+    // Back-to-back requests to one plug; mean wall time per request in ms
+    double requestLatency(const MockPlug::Plug& plug, size_t count) {
+        unsigned long start = micros();
+        for (size_t i = 0; i < count; i++) {
+            HttpEngine::Request request = {};
+            snprintf(request.host, sizeof(request.host), "127.0.0.1:%u", plug.port);
+            strlcpy(request.path, SWEEP_PATHS[2], sizeof(request.path));
+            request.connectTimeoutMs = 1000;
+            request.timeoutMs = 1000;
+            HttpEngine::start(request);
+            while (HttpEngine::inFlight() > 0) {
+                HttpEngine::poll(20, nullptr);
+            }
+        }
+        return (micros() - start) / 1000.0 / count;
+    }
+
+    // Parsing a Tasmota Status 0 reply as it arrives off the socket, in
+    // 512-byte pieces: buffered into a String and deserialized (the previous
+    // HTTPClient path) against the streaming scanner.
+    void benchReplyParsing() {
+        static const char* body = MockPlug::replyBody("/cm?cmnd=Status%200");
+        static const size_t length = strlen(body);
+        static float watts;
+
+        Bench::run("Status 0 reply, String + JsonDocument", 10000, [] {
+            String payload;
+            for (size_t i = 0; i < length; i += 512) {
+                payload.concat(body + i, min((size_t)512, length - i));
+            }
+            JsonDocument doc;
+            if (!deserializeJson(doc, payload)) {
+                watts = doc["StatusSNS"]["ENERGY"]["Power"] | NAN;
+            }
+            Bench::doNotOptimize(watts);
+        });
+
+        static const char* fields[] = {"StatusSTS.POWER", "StatusSNS.ENERGY.Power"};
+        static JsonScan::Scanner scanner;
+        Bench::run("Status 0 reply, JsonScan", 10000, [] {
+            JsonScan::begin(scanner, fields, 2);
+            for (size_t i = 0; i < length; i += 512) {
+                JsonScan::feed(scanner, body + i, min((size_t)512, length - i));
+            }
+            watts = JsonScan::number(JsonScan::find(scanner, fields[1]));
+            Bench::doNotOptimize(watts);
+        });
+        Serial.printf("  Status 0 reply: %zu bytes, scanner state %zu bytes\n", length, sizeof(scanner));
+    }
+
+    void benchDeviceIo() {
+        Bench::section("Device I/O");
+        benchReplyParsing();
+
+        // 20 plugs at 20-150 ms plus a 15 ms handshake; three silent ones
+        // cost a full query timeout
+        static MockPlug::Plug plugs[20];
+        for (size_t i = 0; i < 20; i++) {
+            plugs[i].latencyMs = 20 + (i * 37) % 131;
+            plugs[i].silent = (i == 5 || i == 12 || i == 17);
+            plugs[i].handshakeMs = 15;
+        }
+        if (!MockPlug::start(plugs, 20)) return;
+
+        size_t answered;
+        HttpEngine::setKeepAlive(false);
+        HttpEngine::setMaxInFlight(1);
+        unsigned long serialMs = sweep(plugs, 20, answered);
+        Serial.printf("  sweep 20 plugs, 1 in flight:             %5lu ms (%zu answered)\n",
+            serialMs, answered);
+
+        HttpEngine::setMaxInFlight(HttpEngine::MAX_IN_FLIGHT);
+        unsigned long concurrentMs = sweep(plugs, 20, answered);
+        Serial.printf("  sweep 20 plugs, %zu in flight:             %5lu ms (%zu answered)\n",
+            HttpEngine::MAX_IN_FLIGHT, concurrentMs, answered);
+
+        double freshMs = requestLatency(plugs[0], 50);
+        Serial.printf("  request, new connection each:            %8.1f ms\n", freshMs);
+
+        HttpEngine::setKeepAlive(true);
+        HttpEngine::Stats before = HttpEngine::getStats();
+        double pooledMs = requestLatency(plugs[0], 50);
+        HttpEngine::Stats after = HttpEngine::getStats();
+        Serial.printf("  request, keep-alive:                     %8.1f ms (%u connects / 50)\n",
+            pooledMs, after.connects - before.connects);
+
+        sweep(plugs, 20, answered);
+        before = HttpEngine::getStats();
+        unsigned long pooledSweepMs = sweep(plugs, 20, answered);
+        after = HttpEngine::getStats();
+        Serial.printf("  sweep 20 plugs, %zu in flight, keep-alive: %5lu ms (%u reused, %u evicted)\n",
+            HttpEngine::MAX_IN_FLIGHT, pooledSweepMs, after.reused - before.reused,
+            after.evicted - before.evicted);
+
+        // Five four-channel Shelly Pro units: a Switch.GetStatus per channel
+        // against one Shelly.GetStatus per unit
+        static const char* perChannel[] = {"/rpc/Switch.GetStatus?id=0", "/rpc/Switch.GetStatus?id=1",
+            "/rpc/Switch.GetStatus?id=2", "/rpc/Switch.GetStatus?id=3"};
+        static const char* batched[] = {"/rpc/Shelly.GetStatus"};
+        size_t bytes;
+        size_t servedBefore = MockPlug::served();
+        unsigned long perChannelMs = sweepUnits(plugs, 5, perChannel, 4, bytes);
+        Serial.printf("  5 units x 4 channels, per channel:       %5lu ms (%zu requests, %zu B)\n",
+            perChannelMs, MockPlug::served() - servedBefore, bytes);
+        servedBefore = MockPlug::served();
+        unsigned long batchedMs = sweepUnits(plugs, 5, batched, 1, bytes);
+        Serial.printf("  5 units x 4 channels, batched:           %5lu ms (%zu requests, %zu B)\n",
+            batchedMs, MockPlug::served() - servedBefore, bytes);
+    }
+
+    void benchTick() {
+        Bench::section("Main loop");
+
+        // Each iteration jumps past BROADCAST_INTERVAL, so loop() runs the full
+        // tick: acquisition, history, sensor broadcast and automation.
+        Bench::run("loop() 5 s tick", 2000, [] {
+            NativeShim::advanceMillis(5000);
+            loop();
+        });
+
+        NativeShim::resetWsStats();
+        NativeShim::advanceMillis(5000);
+        loop();
+        NativeShim::WsStats ws = NativeShim::wsStats();
+        Serial.printf("  tick: %zu frames, %zu bytes\n", ws.frames, ws.bytes);
+
+        Bench::run("loop() idle", 100000, [] {
+            loop();
+        });
+
+        // Only the auto configs triggered by the reading are evaluated
+        static Registry::Readings readings;
+        static Registry::Handle canopyTemp = Registry::find("t_canopy");
+        Bench::run("DeviceModes, one reading", 100000, [] {
+            readings.set(canopyTemp, 24.0f);
+            DeviceModes::onSensorReading(canopyTemp, readings);
+        });
+
+        // Between deadlines a pass only looks at the earliest timer
+        Bench::run("DeviceModes::loop, nothing due", 100000, [] {
+            DeviceModes::loop(readings);
+        });
+
+        benchLoopLatency();
+    }
+}
+
+namespace Bench {
+
+void section(const char* title) {
+    Serial.printf("\n== %s ==\n", title);
+    Serial.printf("  %-40s %10s %12s %10s %12s %10s\n",
+        "case", "iters", "ns/op", "allocs/op", "bytes/op", "peak B");
+}
+
+void report(const char* name, size_t iterations, double totalNs, const NativeShim::HeapStats& heap) {
+    Serial.printf("  %-40s %10zu %12.1f %10.2f %12.1f %10zu\n",
+        name, iterations, totalNs / iterations,
+        (double)heap.allocCount / iterations,
+        (double)heap.allocBytes / iterations,
+        heap.peakLiveBytes);
+}
+
+}
+
+int main() {
+    resetFilesystem();
+
+    NativeShim::setSerialEnabled(false);
+    setup();
+    NativeShim::setSerialEnabled(true);
+
+    // Skip DeviceModes' startup grace period.
+    NativeShim::advanceMillis(20000);
+
+    Serial.printf("EspGrow native benchmarks (%zu sensors, %zu devices)\n",
+        SensorConfig::getSensorCount(), Devices::getDeviceCount());
+
+    benchSensors();
+    bool psychrometricsOk = benchPsychrometrics();
+    benchHistory();
+    benchMessages();
+    benchTick();
+
+    Serial.printf("\nFree heap (nominal %zu): %u, min %u\n",
+        NativeShim::HEAP_SIZE, ESP.getFreeHeap(), ESP.getMinFreeHeap());
+
+    // After the heap figures: the mock plug server allocates on the host heap
+    benchDeviceIo();
+    return psychrometricsOk ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#include "mock_plug.h"
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace MockPlug {
+
+namespace {
+    // Trimmed from a Tasmota 13 plug; the real reply is ~2 KB with Wi-Fi,
+    // firmware and memory sections we do not read.
+    const char* TASMOTA_STATUS = R"json({"Status":{"Module":0,"DeviceName":"Tasmota","FriendlyName":["Tasmota"],"Topic":"tasmota_8A2F1C","ButtonTopic":"0","Power":1,"PowerOnState":3,"LedState":1,"LedMask":"FFFF","SaveData":1,"SaveState":1,"SwitchTopic":"0","SwitchMode":[0,0,0,0,0,0,0,0],"ButtonRetain":0,"SwitchRetain":0,"SensorRetain":0,"PowerRetain":0,"InfoRetain":0,"StateRetain":0},"StatusPRM":{"Baudrate":115200,"SerialConfig":"8N1","GroupTopic":"tasmotas","OtaUrl":"http://ota.tasmota.com/tasmota/release/tasmota.bin.gz","RestartReason":"Software/System restart","Uptime":"3T02:11:45","StartupUTC":"2024-05-02T08:12:03","Sleep":50,"CfgHolder":4617,"BootCount":41,"BCResetTime":"2023-11-12T10:01:55","SaveCount":318,"SaveAddress":"F5000"},"StatusFWR":{"Version":"13.4.0(tasmota)","BuildDateTime":"2024-02-13T14:28:49","Boot":31,"Core":"2_7_6","SDK":"2.2.2-dev(38a443e)","CpuFrequency":80,"Hardware":"ESP8266EX","CR":"364/699"},"StatusLOG":{"SerialLog":0,"WebLog":2,"MqttLog":0,"SysLog":0,"LogHost":"","LogPort":514,"SSId":["growroom",""],"TelePeriod":300,"Resolution":"558180C0","SetOption":["00008009","2805C80001000600003C5A0A192800000000","00000080","00006000","00004000","00000000"]},"StatusMEM":{"ProgramSize":629,"Free":372,"Heap":25,"ProgramFlashSize":1024,"FlashSize":1024,"FlashChipId":"144051","FlashFrequency":40,"FlashMode":"DOUT","Features":["0809","8FDAC787","04368001","000000CF","010013C0","C000F981","00004004","00001000","04000020"],"Drivers":"1,2,3,4,5,6,7,8,9,10,12,16,18,19,20,21,22,24,26,27,29,30,35,37,45,62","Sensors":"1,2,3,4,5,6"},"StatusNET":{"Hostname":"tasmota-8A2F1C-3868","IPAddress":"192.168.1.52","Gateway":"192.168.1.1","Subnetmask":"255.255.255.0","DNSServer1":"192.168.1.1","DNSServer2":"0.0.0.0","Mac":"48:3F:DA:8A:2F:1C","Webserver":2,"HTTP_API":1,"WifiConfig":4,"WifiPower":17.0},"StatusMQT":{"MqttHost":"","MqttPort":1883,"MqttClientMask":"DVES_%06X","MqttClient":"DVES_8A2F1C","MqttUser":"DVES_USER","MqttCount":0,"MAX_PACKET_SIZE":1200,"KEEPALIVE":30,"SOCKET_TIMEOUT":4},"StatusTIM":{"UTC":"2024-05-05T10:23:48","Local":"2024-05-05T12:23:48","StartDST":"2024-03-31T02:00:00","EndDST":"2024-10-27T03:00:00","Timezone":"+01:00","Sunrise":"05:52","Sunset":"20:41"},"StatusSNS":{"Time":"2024-05-05T12:23:48","ENERGY":{"TotalStartTime":"2023-11-12T10:02:11","Total":84.213,"Yesterday":1.024,"Today":0.512,"Power":42,"ApparentPower":48,"ReactivePower":22,"Factor":0.88,"Voltage":231,"Current":0.207}},"StatusSTS":{"Time":"2024-05-05T12:23:48","Uptime":"3T02:11:45","UptimeSec":267105,"Heap":25,"SleepMode":"Dynamic","Sleep":50,"LoadAvg":19,"MqttCount":0,"POWER":"ON","Wifi":{"AP":1,"SSId":"growroom","BSSId":"A0:B5:49:12:7E:30","Channel":6,"Mode":"11n","RSSI":72,"Signal":-64,"LinkCount":1,"Downtime":"0T00:00:03"}}})json";
+
+    const char* SHELLY_GEN1_RELAY = R"({"ison":true,"has_timer":false,"timer_started":0,"timer_duration":0,"timer_remaining":0,"overpower":false,"source":"http","power":42.0})";
+    const char* SHELLY_GEN2_STATUS = R"({"id":0,"source":"HTTP_in","output":true,"apower":42.0,"voltage":231.2,"current":0.207,"aenergy":{"total":84213.4,"by_minute":[701.2,699.8,700.4],"minute_ts":1714904628},"temperature":{"tC":41.2,"tF":106.2}})";
+
+    // Four-channel units: a Shelly 4Pro's /status and a Pro 4PM's
+    // Shelly.GetStatus, trimmed of the sections we do not read
+    const char* SHELLY_GEN1_DEVICE_STATUS = R"({"wifi_sta":{"connected":true,"ssid":"growroom","ip":"192.168.1.61","rssi":-61},"cloud":{"enabled":false,"connected":false},"time":"12:23","unixtime":1714904628,"has_update":false,"mac":"A4CF12F45D31","relays":[{"ison":true,"has_timer":false,"overpower":false,"source":"http"},{"ison":false,"has_timer":false,"overpower":false,"source":"http"},{"ison":true,"has_timer":false,"overpower":false,"source":"input"},{"ison":false,"has_timer":false,"overpower":false,"source":"http"}],"meters":[{"power":42.0,"is_valid":true,"total":84213},{"power":0.0,"is_valid":true,"total":1021},{"power":612.5,"is_valid":true,"total":530112},{"power":0.0,"is_valid":true,"total":0}],"temperature":41.2,"overtemperature":false,"uptime":267105})";
+    const char* SHELLY_GEN2_DEVICE_STATUS = R"({"ble":{},"cloud":{"connected":false},"eth":{"ip":null},"input:0":{"id":0,"state":false},"input:1":{"id":1,"state":false},"input:2":{"id":2,"state":false},"input:3":{"id":3,"state":false},"mqtt":{"connected":false},"switch:0":{"id":0,"source":"HTTP_in","output":true,"apower":42.0,"voltage":231.2,"current":0.207,"pf":0.88,"aenergy":{"total":84213.4,"by_minute":[701.2,699.8,700.4],"minute_ts":1714904628},"temperature":{"tC":41.2,"tF":106.2}},"switch:1":{"id":1,"source":"init","output":false,"apower":0.0,"voltage":231.2,"current":0.0,"pf":0.0,"aenergy":{"total":1021.0,"by_minute":[0.0,0.0,0.0],"minute_ts":1714904628},"temperature":{"tC":41.2,"tF":106.2}},"switch:2":{"id":2,"source":"WS_in","output":true,"apower":612.5,"voltage":231.0,"current":2.651,"pf":1.0,"aenergy":{"total":530112.9,"by_minute":[10208.1,10211.4,10209.9],"minute_ts":1714904628},"temperature":{"tC":41.2,"tF":106.2}},"switch:3":{"id":3,"source":"init","output":false,"apower":0.0,"voltage":231.2,"current":0.0,"pf":0.0,"aenergy":{"total":0.0,"by_minute":[0.0,0.0,0.0],"minute_ts":1714904628},"temperature":{"tC":41.2,"tF":106.2}},"sys":{"mac":"A8032ABE54DC","restart_required":false,"time":"12:23","unixtime":1714904628,"uptime":267105,"ram_size":246588,"ram_free":141708,"fs_size":524288,"fs_free":180224},"wifi":{"sta_ip":"192.168.1.62","status":"got ip","ssid":"growroom","rssi":-58},"ws":{"connected":false}})";
+
+    struct Connection {
+        int fd;
+        size_t plug;
+        std::string request;
+        unsigned long answerAt;     // 0 until a request is complete
+        size_t answered;
+    };
+
+    std::vector<Plug> plugList;
+    std::vector<int> listeners;
+    std::atomic<size_t> servedCount{0};
+
+    // Host clock rather than millis(), which benchmarks move forward
+    unsigned long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* bodyFor(const std::string& request) {
+        if (request.find("Status%200") != std::string::npos) return TASMOTA_STATUS;
+        // A single-relay Tasmota answers POWER whichever index was sent
+        if (request.find("cmnd=Power") != std::string::npos) {
+            return request.find("%20On") != std::string::npos ? R"({"POWER":"ON"})" : R"({"POWER":"OFF"})";
+        }
+        if (request.find("/relay/") != std::string::npos) return SHELLY_GEN1_RELAY;
+        if (request.find("/status") != std::string::npos) return SHELLY_GEN1_DEVICE_STATUS;
+        if (request.find("Shelly.GetStatus") != std::string::npos) return SHELLY_GEN2_DEVICE_STATUS;
+        if (request.find("Switch.GetStatus") != std::string::npos) return SHELLY_GEN2_STATUS;
+        if (request.find("Switch.Set") != std::string::npos) return R"({"was_on":false})";
+        return "{}";
+    }
+
+    // Returns false when the connection should close after this answer
+    bool answer(Connection& conn) {
+        size_t end = conn.request.find("\r\n\r\n");
+        std::string head = conn.request.substr(0, end);
+        conn.request.erase(0, end + 4);
+        bool keepAlive = head.find("Connection: keep-alive") != std::string::npos;
+
+        const char* body = bodyFor(head);
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+            std::to_string(strlen(body)) + "\r\nConnection: " + (keepAlive ? "keep-alive" : "close") +
+            "\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(conn.fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += n;
+        }
+        conn.answered++;
+        servedCount++;
+        return keepAlive;
+    }
+
+    void serve() {
+        std::vector<Connection> connections;
+        for (;;) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            int maxFd = -1;
+            for (int fd : listeners) {
+                FD_SET(fd, &readSet);
+                maxFd = max(maxFd, fd);
+            }
+            for (auto& conn : connections) {
+                FD_SET(conn.fd, &readSet);
+                maxFd = max(maxFd, conn.fd);
+            }
+            timeval tv = {0, 1000};
+            select(maxFd + 1, &readSet, nullptr, nullptr, &tv);
+
+            unsigned long now = nowMs();
+            for (size_t i = 0; i < listeners.size(); i++) {
+                if (!FD_ISSET(listeners[i], &readSet)) continue;
+                int fd = accept(listeners[i], nullptr, nullptr);
+                if (fd >= 0) connections.push_back({fd, i, std::string(), 0, 0});
+            }
+
+            for (auto it = connections.begin(); it != connections.end();) {
+                Connection& conn = *it;
+                bool closed = false;
+                if (FD_ISSET(conn.fd, &readSet)) {
+                    char buf[512];
+                    ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+                    if (n <= 0) closed = true;
+                    else conn.request.append(buf, n);
+                }
+                const Plug& plug = plugList[conn.plug];
+                if (!closed && !conn.answerAt && conn.request.find("\r\n\r\n") != std::string::npos) {
+                    conn.answerAt = now + plug.latencyMs + (conn.answered == 0 ? plug.handshakeMs : 0);
+                }
+                if (!closed && conn.answerAt && !plug.silent && (long)(now - conn.answerAt) >= 0) {
+                    closed = !answer(conn);
+                    conn.answerAt = 0;
+                }
+                if (closed) {
+                    close(conn.fd);
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+}
+
+bool start(Plug* plugs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+            getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+            Serial.printf("[MockPlug] Failed to bind plug %zu\n", i);
+            return false;
+        }
+        plugs[i].port = ntohs(addr.sin_port);
+        listeners.push_back(fd);
+        plugList.push_back(plugs[i]);
+    }
+    std::thread(serve).detach();
+    return true;
+}
+
+size_t served() {
+    return servedCount;
+}
+
+const char* replyBody(const char* request) {
+    return bodyFor(request);
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Loopback stand-ins for Shelly/Tasmota plugs. Each plug listens on its own
+// 127.0.0.1 port and answers after a fixed latency, with the JSON the real
+// firmware returns for the path. A silent plug accepts connections and never
+// answers, like a plug that dropped off the network. Loopback connects are
+// free, so the first request on each connection is answered `handshakeMs`
+// later to stand in for the TCP handshake over Wi-Fi. Connections asking for
+// keep-alive stay open.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace MockPlug {
+
+struct Plug {
+    uint32_t latencyMs;
+    bool silent;
+    uint32_t handshakeMs;
+    uint16_t port;          // assigned by start()
+};
+
+// Binds every plug and serves them from one background thread.
+bool start(Plug* plugs, size_t count);
+
+// Requests answered since start
+size_t served();
+
+// The JSON body a plug sends for a request line or path
+const char* replyBody(const char* request);
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Only the type name is needed by headers compiled in env:native; the web
+// server itself is replaced by native/stubs/websocket_server_stub.cpp.
+
+#include <Arduino.h>
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
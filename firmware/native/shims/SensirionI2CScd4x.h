@@ -0,0 +1,27 @@
+#pragma once
+
+// Synthetic SCD4x: data is ready every call, CO2 drifts with millis().
+// Each command includes the 1 ms execution time of the real part.
+
+#include <Wire.h>
+
+class SensirionI2CScd4x {
+public:
+    void begin(TwoWire&) {}
+    uint16_t stopPeriodicMeasurement() { return 0; }
+    uint16_t startPeriodicMeasurement() { return 0; }
+    uint16_t reinit() { return 0; }
+    uint16_t getSerialNumber(uint16_t& s0, uint16_t& s1, uint16_t& s2) {
+        s0 = 0x0001; s1 = 0x0002; s2 = 0x0003;
+        return 0;
+    }
+    uint16_t getDataReadyFlag(bool& ready) { delay(1); ready = true; return 0; }
+    uint16_t readMeasurement(uint16_t& co2, float& temp, float& hum) {
+        delay(1);
+        float t = (float)(millis() % 900000UL) / 900000.0f;
+        co2 = (uint16_t)(800 + 400 * t);
+        temp = 24.8f;
+        hum = 58.0f;
+        return 0;
+    }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+// Synthetic SHT3x: returns a slowly drifting reading derived from millis().
+// The blocking call takes the 15.5 ms conversion time of the real part.
+
+#include <Wire.h>
+
+enum Repeatability {
+    REPEATABILITY_LOW,
+    REPEATABILITY_MEDIUM,
+    REPEATABILITY_HIGH
+};
+
+class SensirionI2cSht3x {
+public:
+    void begin(TwoWire&, uint8_t) {}
+    int16_t readStatusRegister(uint16_t& status) { status = 0; return 0; }
+    int16_t measureSingleShot(Repeatability, bool, float& temp, float& hum) {
+        delay(16);
+        float t = (float)(millis() % 600000UL) / 600000.0f;
+        temp = 24.0f + 2.0f * t;
+        hum = 55.0f + 10.0f * t;
+        return 0;
+    }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Synthetic SHT4x: returns a slowly drifting reading derived from millis().
+// The blocking call takes the 8.3 ms conversion time of the real part.
+
+#include <Wire.h>
+
+class SensirionI2cSht4x {
+public:
+    void begin(TwoWire&, uint8_t) {}
+    int16_t softReset() { return 0; }
+    int16_t serialNumber(uint32_t& serial) { serial = 0x12345678; return 0; }
+    int16_t measureHighPrecision(float& temp, float& hum) {
+        delay(9);
+        float t = (float)(millis() % 300000UL) / 300000.0f;
+        temp = 23.5f + 1.5f * t;
+        hum = 60.0f - 8.0f * t;
+        return 0;
+    }
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <Arduino.h>
+
+class WiFiClass {
+public:
+    int8_t RSSI() { return -55; }
+    bool isConnected() { return true; }
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Emulates the two SHT sensors at the raw I2C level: SHT3x at 0x44
+// (single shot, no clock stretching) and SHT4x at 0x45. A read before the
+// conversion time has elapsed is NACKed like on hardware.
+class TwoWire {
+public:
+    bool begin() { return true; }
+    bool begin(int sda, int scl) { (void)sda; (void)scl; return true; }
+    void setClock(uint32_t) {}
+
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t* data, size_t len) {
+        size_t n = 0;
+        while (n < len && write(data[n])) n++;
+        return n;
+    }
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available();
+    int read();
+
+private:
+    uint8_t txAddress_ = 0;
+    uint8_t txBuffer_[4] = {0};
+    size_t txLength_ = 0;
+    uint8_t rxBuffer_[8] = {0};
+    size_t rxLength_ = 0;
+    size_t rxIndex_ = 0;
+};
+
+extern TwoWire Wire;
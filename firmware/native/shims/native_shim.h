@@ -0,0 +1,52 @@
+#pragma once
+
+// Controls for the host shims that have no Arduino counterpart.
+// Used by the benchmark harness to drive time and inspect the heap.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace NativeShim {
+
+// millis()/micros() run off the host monotonic clock plus this offset, so a
+// benchmark can jump past loop() intervals without sleeping.
+void advanceMillis(unsigned long ms);
+
+// Silence Serial while timing hot paths; logging would dominate the numbers.
+void setSerialEnabled(bool enabled);
+
+// LittleFS is backed by this host directory (default: $ESPGROW_FS_ROOT or
+// ".native_fs" in the working directory).
+const char* fsRoot();
+
+struct HeapStats {
+    size_t allocCount;      // malloc/new calls since last reset
+    size_t allocBytes;      // bytes requested since last reset
+    size_t liveBytes;       // bytes currently allocated
+    size_t peakLiveBytes;   // high-water mark of liveBytes since last reset
+};
+
+HeapStats heapStats();
+void resetHeapStats();
+
+// WebSocketServer stub: messages are delivered to the onMessage() callback
+// synchronously, outgoing frames are counted and held in each client's
+// outbox until the next WebSocketServer::loop().
+void injectWsMessage(uint32_t clientId, const char* message);
+
+struct WsStats {
+    size_t frames;
+    size_t bytes;
+    size_t lastFrameBytes;
+    size_t dropped;         // outboxes that overflowed and were reset
+};
+
+WsStats wsStats();
+void resetWsStats();
+// Connected clients, 1 by default; broadcasts queue the frame for each
+void setWsClients(size_t count);
+
+// Nominal heap size used to derive ESP.getFreeHeap() on the host.
+constexpr size_t HEAP_SIZE = 320 * 1024;
+
+}
@@ -0,0 +1,149 @@
+#include <Arduino.h>
+#include <native_shim.h>
+#include <atomic>
+#include <chrono>
+#include <malloc.h>
+#include <new>
+#include <thread>
+
+HostSerial Serial;
+EspClass ESP;
+
+namespace {
+    const auto startTime = std::chrono::steady_clock::now();
+    // Read from the sensor task thread as well
+    std::atomic<unsigned long> millisOffset{0};
+    std::atomic<bool> serialEnabled{true};
+
+    NativeShim::HeapStats stats = {};
+
+    void trackAlloc(void* p) {
+        if (!p) return;
+        size_t size = malloc_usable_size(p);
+        stats.allocCount++;
+        stats.allocBytes += size;
+        stats.liveBytes += size;
+        if (stats.liveBytes > stats.peakLiveBytes) stats.peakLiveBytes = stats.liveBytes;
+    }
+
+    void trackFree(void* p) {
+        if (!p) return;
+        size_t size = malloc_usable_size(p);
+        stats.liveBytes = stats.liveBytes > size ? stats.liveBytes - size : 0;
+    }
+}
+
+// Heap accounting: the native env links with --wrap for the C allocator, and
+// operator new/delete are routed through the wrapped calls below.
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t n, size_t size);
+    void* __real_realloc(void* p, size_t size);
+    void __real_free(void* p);
+
+    void* __wrap_malloc(size_t size) {
+        void* p = __real_malloc(size);
+        trackAlloc(p);
+        return p;
+    }
+
+    void* __wrap_calloc(size_t n, size_t size) {
+        void* p = __real_calloc(n, size);
+        trackAlloc(p);
+        return p;
+    }
+
+    void* __wrap_realloc(void* p, size_t size) {
+        trackFree(p);
+        void* q = __real_realloc(p, size);
+        trackAlloc(q ? q : p);
+        return q;
+    }
+
+    void __wrap_free(void* p) {
+        trackFree(p);
+        __real_free(p);
+    }
+}
+
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+unsigned long millis() {
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() + millisOffset;
+}
+
+unsigned long micros() {
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + millisOffset * 1000UL;
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+size_t HostSerial::write(uint8_t c) {
+    if (!serialEnabled) return 1;
+    return fwrite(&c, 1, 1, stderr);
+}
+
+size_t HostSerial::write(const uint8_t* buffer, size_t size) {
+    if (!serialEnabled) return size;
+    return fwrite(buffer, 1, size, stderr);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    size_t live = stats.liveBytes;
+    return live >= NativeShim::HEAP_SIZE ? 0 : (uint32_t)(NativeShim::HEAP_SIZE - live);
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    size_t peak = stats.peakLiveBytes;
+    return peak >= NativeShim::HEAP_SIZE ? 0 : (uint32_t)(NativeShim::HEAP_SIZE - peak);
+}
+
+void EspClass::restart() {
+    Serial.println("[Native] ESP.restart() called, exiting");
+    exit(0);
+}
+
+namespace NativeShim {
+
+void advanceMillis(unsigned long ms) {
+    millisOffset += ms;
+}
+
+void setSerialEnabled(bool enabled) {
+    serialEnabled = enabled;
+}
+
+const char* fsRoot() {
+    static const char* root = getenv("ESPGROW_FS_ROOT") ? getenv("ESPGROW_FS_ROOT") : ".native_fs";
+    return root;
+}
+
+HeapStats heapStats() {
+    return stats;
+}
+
+void resetHeapStats() {
+    size_t live = stats.liveBytes;
+    stats = {};
+    stats.liveBytes = live;
+    stats.peakLiveBytes = live;
+}
+
+}
@@ -0,0 +1,74 @@
+#include "device_controller.h"
+#include <deque>
+#include <map>
+
+// Host stand-in for the HTTP worker: every target is a reachable plug that
+// remembers its last commanded state; results are delivered on the next loop().
+
+namespace DeviceController {
+
+namespace {
+    ResultCallback resultCallback = nullptr;
+    std::deque<AsyncResult> results;
+    std::deque<AsyncResult> pending;
+    std::map<String, bool> plugStates[MAX_CHANNELS];
+
+    static constexpr size_t QUEUE_SIZE = 8;
+
+    bool enqueue(const String& method, const String& target, bool isControl, bool on,
+                 uint8_t firstChannel, uint8_t channelCount, uint32_t sequence = 0) {
+        if (pending.size() >= QUEUE_SIZE) return false;
+        AsyncResult ar = {};
+        strlcpy(ar.method, method.c_str(), sizeof(ar.method));
+        strlcpy(ar.target, target.c_str(), sizeof(ar.target));
+        ar.firstChannel = firstChannel;
+        ar.channelCount = channelCount;
+        for (uint8_t i = 0; i < channelCount; i++) {
+            bool& state = plugStates[firstChannel + i][target];
+            if (isControl) state = on;
+            ar.results[i].reachable = true;
+            ar.results[i].isOn = state;
+            ar.results[i].watts = state ? 42.0f : 0.0f;
+        }
+        ar.wasControl = isControl;
+        ar.requestedState = on;
+        ar.sequence = sequence;
+        pending.push_back(ar);
+        return true;
+    }
+}
+
+void init() {}
+
+void loop() {
+    results.swap(pending);
+    while (!results.empty()) {
+        AsyncResult ar = results.front();
+        results.pop_front();
+        if (resultCallback) resultCallback(ar);
+    }
+}
+
+void onResult(ResultCallback cb) {
+    resultCallback = cb;
+}
+
+bool controlAsync(const String& method, const String& target, bool on, uint8_t channel, uint32_t sequence) {
+    if (channel >= MAX_CHANNELS) return false;
+    return enqueue(method, target, true, on, channel, 1, sequence);
+}
+
+bool queryAsync(const String& method, const String& target, uint8_t channelCount) {
+    if (channelCount == 0 || channelCount > MAX_CHANNELS) return false;
+    return enqueue(method, target, false, false, 0, channelCount);
+}
+
+bool busy() {
+    return !pending.empty();
+}
+
+uint32_t getDroppedResults() {
+    return 0;
+}
+
+}
@@ -0,0 +1,157 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct NativeTask {
+    std::thread thread;
+};
+
+struct NativeQueue {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+namespace {
+    std::recursive_mutex criticalMutex;
+
+    template <typename Pred>
+    bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                 TickType_t ticks, Pred pred) {
+        // Zero-wait polls return at once, as on FreeRTOS, rather than through a timed wait
+        if (ticks == 0) return pred();
+        if (ticks == portMAX_DELAY) {
+            cv.wait(lock, pred);
+            return true;
+        }
+        return cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+    }
+
+    BaseType_t send(QueueHandle_t q, const void* item, TickType_t ticks, bool front) {
+        if (!q) return pdFALSE;
+        std::unique_lock<std::mutex> lock(q->mutex);
+        if (!waitFor(q->notFull, lock, ticks, [q] { return q->items.size() < q->length; })) {
+            return pdFALSE;
+        }
+        const uint8_t* bytes = static_cast<const uint8_t*>(item);
+        std::vector<uint8_t> copy(bytes, bytes + q->itemSize);
+        if (front) q->items.push_front(std::move(copy));
+        else q->items.push_back(std::move(copy));
+        q->notEmpty.notify_one();
+        return pdTRUE;
+    }
+}
+
+void vPortEnterCritical(portMUX_TYPE*) {
+    criticalMutex.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE*) {
+    criticalMutex.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t,
+                                   void* param, UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    NativeTask* task = new NativeTask;
+    task->thread = std::thread(fn, param);
+    task->thread.detach();
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* param, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, param, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t) {
+    // Detached threads cannot be cancelled; tasks in this tree never return.
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue* q = new NativeQueue;
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return send(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return send(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    if (!queue) return pdFALSE;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.clear();
+    }
+    return send(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    if (!queue) return pdFALSE;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->notFull.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    if (!queue) return pdFALSE;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    if (!queue) return 0;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    if (!queue) return 0;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)(queue->length - queue->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    if (!queue) return pdFALSE;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->notFull.notify_all();
+    return pdPASS;
+}
@@ -0,0 +1,188 @@
+#include <LittleFS.h>
+#include <native_shim.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+fs::FS LittleFS;
+
+namespace fs {
+
+struct FileImpl {
+    FILE* fp = nullptr;
+    DIR* dir = nullptr;
+    std::string path;
+    std::string name;
+
+    ~FileImpl() {
+        if (fp) fclose(fp);
+        if (dir) closedir(dir);
+    }
+};
+
+namespace {
+    std::string hostPath(const char* path) {
+        std::string p = NativeShim::fsRoot();
+        if (!path || path[0] != '/') p += '/';
+        if (path) p += path;
+        return p;
+    }
+
+    std::string baseName(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    size_t dirUsage(const std::string& dirPath) {
+        DIR* dir = opendir(dirPath.c_str());
+        if (!dir) return 0;
+        size_t total = 0;
+        while (dirent* entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            std::string child = dirPath + "/" + entry->d_name;
+            struct stat st;
+            if (stat(child.c_str(), &st) != 0) continue;
+            total += S_ISDIR(st.st_mode) ? dirUsage(child) : (size_t)st.st_size;
+        }
+        closedir(dir);
+        return total;
+    }
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!impl_ || !impl_->fp) return 0;
+    return fwrite(buffer, 1, size, impl_->fp);
+}
+
+int File::available() {
+    if (!impl_ || !impl_->fp) return 0;
+    return (int)(size() - position());
+}
+
+int File::read() {
+    if (!impl_ || !impl_->fp) return -1;
+    int c = fgetc(impl_->fp);
+    return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+    if (!impl_ || !impl_->fp) return -1;
+    int c = fgetc(impl_->fp);
+    if (c == EOF) return -1;
+    ungetc(c, impl_->fp);
+    return c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!impl_ || !impl_->fp) return 0;
+    return fread(buffer, 1, size, impl_->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl_ || !impl_->fp) return false;
+    int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return fseek(impl_->fp, (long)pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!impl_ || !impl_->fp) return 0;
+    long pos = ftell(impl_->fp);
+    return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const {
+    if (!impl_ || !impl_->fp) return 0;
+    fflush(impl_->fp);
+    struct stat st;
+    if (fstat(fileno(impl_->fp), &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+void File::flush() {
+    if (impl_ && impl_->fp) fflush(impl_->fp);
+}
+
+void File::close() {
+    impl_.reset();
+}
+
+const char* File::name() const {
+    return impl_ ? impl_->name.c_str() : "";
+}
+
+const char* File::path() const {
+    return impl_ ? impl_->path.c_str() : "";
+}
+
+bool File::isDirectory() const {
+    return impl_ && impl_->dir;
+}
+
+File File::openNextFile() {
+    if (!impl_ || !impl_->dir) return File();
+    while (dirent* entry = readdir(impl_->dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        std::string child = impl_->path;
+        if (child.empty() || child.back() != '/') child += '/';
+        child += entry->d_name;
+        return LittleFS.open(child.c_str(), "r");
+    }
+    return File();
+}
+
+bool FS::begin(bool formatOnFail) {
+    (void)formatOnFail;
+    ::mkdir(NativeShim::fsRoot(), 0755);
+    return true;
+}
+
+File FS::open(const char* path, const char* mode) {
+    std::string host = hostPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path ? path : "/";
+    impl->name = baseName(impl->path);
+
+    struct stat st;
+    if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        impl->dir = opendir(host.c_str());
+        return impl->dir ? File(impl) : File();
+    }
+
+    // LittleFS "w"/"a" imply binary; "r+" is used for in-place header updates.
+    std::string m = mode;
+    if (m.find('b') == std::string::npos) m += 'b';
+    impl->fp = fopen(host.c_str(), m.c_str());
+    return impl->fp ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+size_t FS::usedBytes() {
+    return dirUsage(NativeShim::fsRoot());
+}
+
+}
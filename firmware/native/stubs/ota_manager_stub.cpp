@@ -0,0 +1,25 @@
+#include "ota_manager.h"
+
+namespace OtaManager {
+
+void begin(AsyncWebServer*, StatusCallback) {}
+
+bool validateRollback() {
+    return false;
+}
+
+void refreshGitHubCache() {}
+
+Status getStatus() {
+    return Status::Idle;
+}
+
+ReleaseInfo getCachedRelease() {
+    return ReleaseInfo{};
+}
+
+String getChipModel() {
+    return "native";
+}
+
+}
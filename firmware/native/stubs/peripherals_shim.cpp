@@ -0,0 +1,111 @@
+#include <Wire.h>
+#include <WiFi.h>
+#include <ESPmDNS.h>
+
+TwoWire Wire;
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+namespace {
+    struct ShtDevice {
+        uint8_t address;
+        uint8_t command[2];
+        size_t commandLength;
+        unsigned long conversionMs;
+        bool converting;
+        unsigned long readyAt;
+    };
+
+    // SHT3x: 0x2400 high repeatability, 15.5 ms. SHT4x: 0xFD high precision, 8.3 ms.
+    ShtDevice devices[] = {
+        {0x44, {0x24, 0x00}, 2, 16, false, 0},
+        {0x45, {0xFD, 0x00}, 1, 9, false, 0},
+    };
+
+    ShtDevice* findDevice(uint8_t address) {
+        for (auto& dev : devices) {
+            if (dev.address == address) return &dev;
+        }
+        return nullptr;
+    }
+
+    uint8_t crc(uint8_t msb, uint8_t lsb) {
+        uint8_t c = 0xFF;
+        uint8_t data[2] = {msb, lsb};
+        for (uint8_t byte : data) {
+            c ^= byte;
+            for (int b = 0; b < 8; b++) {
+                c = (c & 0x80) ? (uint8_t)((c << 1) ^ 0x31) : (uint8_t)(c << 1);
+            }
+        }
+        return c;
+    }
+
+    void putWord(uint8_t* out, uint16_t word) {
+        out[0] = (uint8_t)(word >> 8);
+        out[1] = (uint8_t)word;
+        out[2] = crc(out[0], out[1]);
+    }
+
+    // Same slow drift the library shims used for the blocking calls
+    void synthesize(uint8_t address, float& temp, float& hum) {
+        if (address == 0x44) {
+            float t = (float)(millis() % 600000UL) / 600000.0f;
+            temp = 24.0f + 2.0f * t;
+            hum = 55.0f + 10.0f * t;
+        } else {
+            float t = (float)(millis() % 300000UL) / 300000.0f;
+            temp = 23.5f + 1.5f * t;
+            hum = 60.0f - 8.0f * t;
+        }
+    }
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress_ = address;
+    txLength_ = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txLength_ >= sizeof(txBuffer_)) return 0;
+    txBuffer_[txLength_++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+    ShtDevice* dev = findDevice(txAddress_);
+    if (!dev) return 2;  // address NACK
+    if (txLength_ == dev->commandLength && memcmp(txBuffer_, dev->command, txLength_) == 0) {
+        dev->converting = true;
+        dev->readyAt = millis() + dev->conversionMs;
+    }
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+    rxLength_ = 0;
+    rxIndex_ = 0;
+    ShtDevice* dev = findDevice(address);
+    if (!dev || !dev->converting || (long)(millis() - dev->readyAt) < 0 || quantity != 6) return 0;
+    dev->converting = false;
+
+    float temp, hum;
+    synthesize(address, temp, hum);
+    uint16_t rawTemp = (uint16_t)((temp + 45.0f) * 65535.0f / 175.0f);
+    uint16_t rawHum = address == 0x44
+        ? (uint16_t)(hum * 65535.0f / 100.0f)
+        : (uint16_t)((hum + 6.0f) * 65535.0f / 125.0f);
+    putWord(rxBuffer_, rawTemp);
+    putWord(rxBuffer_ + 3, rawHum);
+    rxLength_ = 6;
+    return 6;
+}
+
+int TwoWire::available() {
+    return (int)(rxLength_ - rxIndex_);
+}
+
+int TwoWire::read() {
+    if (rxIndex_ >= rxLength_) return -1;
+    return rxBuffer_[rxIndex_++];
+}
@@ -0,0 +1,95 @@
+#include "websocket_server.h"
+#include "ws_outbox.h"
+#include <native_shim.h>
+#include <vector>
+
+// Host stand-in for the AsyncWebSocket transport: always-connected clients
+// that never have room to send, so every frame waits in the client's outbox
+// until the next loop(). A client whose outbox overflows is "reconnected"
+// with an empty one.
+
+namespace WebSocketServer {
+
+namespace {
+    MessageCallback messageCallback;
+    NativeShim::WsStats stats = {};
+    std::vector<WsOutbox> clients(1);
+
+    void enqueue(WsOutbox& outbox, const WsFrame::Ref& frame, const char* key) {
+        if (outbox.push(frame, key)) return;
+        outbox.clear();
+        stats.dropped++;
+    }
+
+    void count(const WsFrame::Ref& frame) {
+        stats.frames++;
+        stats.bytes += frame->size();
+        stats.lastFrameBytes = frame->size();
+    }
+}
+
+AsyncWebServer* getServer(uint16_t) {
+    return nullptr;
+}
+
+void init() {}
+
+void loop() {
+    for (auto& outbox : clients) outbox.clear();
+}
+
+void broadcast(const JsonDocument& doc, const char* key) {
+    WsFrame::Ref frame = WsFrame::serialize(doc);
+    count(frame);
+    for (auto& outbox : clients) enqueue(outbox, frame, key);
+}
+
+void sendTo(uint32_t clientId, const JsonDocument& doc, const char* key) {
+    WsFrame::Ref frame = WsFrame::serialize(doc);
+    count(frame);
+    enqueue(clients[clientId % clients.size()], frame, key);
+}
+
+void onMessage(MessageCallback callback) {
+    messageCallback = callback;
+}
+
+void onRestore(RestoreCallback) {}
+
+bool hasClients() {
+    return true;
+}
+
+size_t getClientCount() {
+    return clients.size();
+}
+
+size_t getDeferredCount() {
+    size_t queued = 0;
+    for (auto& outbox : clients) queued += outbox.count;
+    return queued;
+}
+
+}
+
+namespace NativeShim {
+
+void injectWsMessage(uint32_t clientId, const char* message) {
+    if (WebSocketServer::messageCallback) {
+        WebSocketServer::messageCallback(clientId, String(message));
+    }
+}
+
+WsStats wsStats() {
+    return WebSocketServer::stats;
+}
+
+void resetWsStats() {
+    WebSocketServer::stats = {};
+}
+
+void setWsClients(size_t count) {
+    WebSocketServer::clients = std::vector<WsOutbox>(count ? count : 1);
+}
+
+}
@@ -0,0 +1,26 @@
+#include "wifi_manager.h"
+
+namespace WiFiManager {
+
+void init() {}
+void loop() {}
+
+bool isConnected() {
+    return true;
+}
+
+bool isTimeSynced() {
+    return true;
+}
+
+uint32_t getTimeSyncCount() {
+    return 1;
+}
+
+String getIP() {
+    return "127.0.0.1";
+}
+
+void startProvisioning() {}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "registry.h"
+
+// Entities changed since the last delta broadcast, by Registry handle, and a
+// version that moves on every change so "anything new?" is one compare.
+// Removed entities keep only their id, since the handle may be reused before
+// the delta goes out. More removals than fit between two broadcasts, or a
+// change without a handle, fall back to resending the full list.
+struct ChangeSet {
+    static constexpr uint8_t MAX_REMOVED = 8;
+    // One bit per handle
+    static constexpr size_t DIRTY_WORDS = (Registry::MAX_HANDLES + 63) / 64;
+
+    uint32_t version = 0;
+    uint64_t dirty[DIRTY_WORDS] = {};
+    char removed[MAX_REMOVED][24];
+    uint8_t removedCount = 0;
+    bool full = false;
+
+    void mark(Registry::Handle handle) {
+        if (handle < Registry::MAX_HANDLES) dirty[handle / 64] |= 1ULL << (handle % 64);
+        else full = true;
+        version++;
+    }
+
+    void markRemoved(Registry::Handle handle, const char* id) {
+        if (handle < Registry::MAX_HANDLES) dirty[handle / 64] &= ~(1ULL << (handle % 64));
+        if (removedCount < MAX_REMOVED) strlcpy(removed[removedCount++], id, sizeof(removed[0]));
+        else full = true;
+        version++;
+    }
+
+    void markAll() {
+        full = true;
+        version++;
+    }
+
+    void clear() {
+        memset(dirty, 0, sizeof(dirty));
+        removedCount = 0;
+        full = false;
+    }
+
+    // Fills {"upsert": [...], "remove": [...]}; `write(array, handle)` adds
+    // the entry for a changed handle, or nothing when it no longer resolves.
+    // False when only a full list can describe the changes.
+    template <typename Write>
+    bool writeDelta(JsonObject data, Write write) const {
+        if (full) return false;
+        JsonArray upsert = data["upsert"].to<JsonArray>();
+        for (size_t word = 0; word < DIRTY_WORDS; word++) {
+            for (uint64_t bits = dirty[word]; bits; bits &= bits - 1) {
+                write(upsert, (Registry::Handle)(word * 64 + __builtin_ctzll(bits)));
+            }
+        }
+        JsonArray remove = data["remove"].to<JsonArray>();
+        for (uint8_t i = 0; i < removedCount; i++) remove.add(removed[i]);
+        return true;
+    }
+};
@@ -142,8 +142,8 @@ const PhaseTargets& getTargetsForPhase(const char* phase) {
     return phases[idx >= 0 ? idx : 1];
 }
 
-void getConfigJson(String& out) {
-    JsonDocument doc;
+void getConfigJson(JsonVariant out) {
+    JsonObject doc = out.to<JsonObject>();
     doc["activePhase"] = activePhase;
     if (strlen(phaseStartDate) > 0) {
         doc["phaseStartDate"] = phaseStartDate;
@@ -172,8 +172,6 @@ void getConfigJson(String& out) {
 
         p["dli"] = t.dli;
     }
-
-    serializeJson(doc, out);
 }
 
 bool setPhase(const char* phase, const char* startDate) {
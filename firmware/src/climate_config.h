@@ -23,7 +23,7 @@ const char* getActivePhase();
 const PhaseTargets& getTargets();
 const PhaseTargets& getTargetsForPhase(const char* phase);
 
-void getConfigJson(String& out);
+void getConfigJson(JsonVariant out);
 
 bool setPhase(const char* phase, const char* phaseStartDate = nullptr);
 bool setTargets(const char* phase, JsonObject& targets);
@@ -2,8 +2,8 @@
 // Do not edit manually. Re-run `npm run gen:contract` from /web.
 // Source of truth: web/src/lib/contract/ws.ts
 //
-// Server->Client tags: 16
-// Client->Server tags: 31
+// Server->Client tags: 21
+// Client->Server tags: 32
 #pragma once
 
 #include <stddef.h>
@@ -16,40 +16,50 @@ enum class ServerMessage : uint8_t {
     Pong = 0,
     Sensors = 1,
     SensorConfig = 2,
-    Devices = 3,
-    DeviceModes = 4,
-    ClimateConfig = 5,
-    Events = 6,
-    Event = 7,
-    Energy = 8,
-    Dli = 9,
-    History = 10,
-    PpfdCalibration = 11,
-    SystemInfo = 12,
-    ClearHistory = 13,
-    Restart = 14,
-    OtaStatus = 15,
+    SensorConfigDelta = 3,
+    Devices = 4,
+    DevicesDelta = 5,
+    DeviceModes = 6,
+    DeviceModesDelta = 7,
+    ClimateConfig = 8,
+    Events = 9,
+    Event = 10,
+    Energy = 11,
+    EnergyDelta = 12,
+    Dli = 13,
+    History = 14,
+    PpfdCalibration = 15,
+    SystemInfo = 16,
+    ClearHistory = 17,
+    AddDevice = 18,
+    Restart = 19,
+    OtaStatus = 20,
 };
 
 constexpr const char* kServerMessageNames[] = {
     "pong",
     "sensors",
     "sensor_config",
+    "sensor_config_delta",
     "devices",
+    "devices_delta",
     "device_modes",
+    "device_modes_delta",
     "climate_config",
     "events",
     "event",
     "energy",
+    "energy_delta",
     "dli",
     "history",
     "ppfd_calibration",
     "system_info",
     "clear_history",
+    "add_device",
     "restart",
     "ota_status",
 };
-constexpr size_t kServerMessageNamesCount = 16;
+constexpr size_t kServerMessageNamesCount = 21;
 
 inline bool tryParseServerMessage(const char* tag, ServerMessage& out) {
     if (!tag) return false;
@@ -98,6 +108,7 @@ enum class ClientMessage : uint8_t {
     SetClimatePhase = 28,
     SetClimateTargets = 29,
     ResetClimateTargets = 30,
+    SetTimezone = 31,
 };
 
 constexpr const char* kClientMessageNames[] = {
@@ -132,8 +143,9 @@ constexpr const char* kClientMessageNames[] = {
     "set_climate_phase",
     "set_climate_targets",
     "reset_climate_targets",
+    "set_timezone",
 };
-constexpr size_t kClientMessageNamesCount = 31;
+constexpr size_t kClientMessageNamesCount = 32;
 
 inline bool tryParseClientMessage(const char* tag, ClientMessage& out) {
     if (!tag) return false;
@@ -1,26 +1,21 @@
 #include "device_controller.h"
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
-#include <WiFi.h>
+#include "http_engine.h"
+#include "json_scan.h"
+#include <atomic>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
 
 namespace DeviceController {
 
-static constexpr int CONTROL_TIMEOUT_MS = 2000;
-static constexpr int QUERY_TIMEOUT_MS = 1000;
-static constexpr int CONNECT_TIMEOUT_MS = 1000;
-
-static constexpr int CONTROL_MAX_ATTEMPTS = 3;
-static constexpr int CONTROL_BACKOFF_MS[CONTROL_MAX_ATTEMPTS - 1] = {200, 500};
-
 static constexpr size_t CONTROL_QUEUE_SIZE = 8;
-static constexpr size_t QUERY_QUEUE_SIZE = 8;
-static constexpr size_t RESULT_QUEUE_SIZE = 8;
-static constexpr size_t WORKER_STACK_SIZE = 4096;
+static constexpr size_t QUERY_QUEUE_SIZE = 24;   // PollScheduler refills it as it drains
+static constexpr size_t RESULT_QUEUE_SIZE = 16;
+static constexpr size_t WORKER_STACK_SIZE = 3072;
 static constexpr UBaseType_t WORKER_PRIORITY = 1;
 static constexpr BaseType_t WORKER_CORE = 0;
+static constexpr uint32_t POLL_WAIT_MS = 20;
+static constexpr uint32_t IDLE_WAIT_MS = 20;
 
 namespace {
 
@@ -29,6 +24,82 @@ namespace {
         char target[40];
         bool isControl;
         bool on;
+        uint8_t channel;        // control: the relay to switch
+        uint8_t channelCount;   // query: channels 0 .. channelCount - 1
+        uint32_t sequence;      // control: echoed in the result
+    };
+
+    // Per-channel reply fields of the batch query, as JsonScan paths
+    constexpr const char* TASMOTA_STATE[MAX_CHANNELS] = {
+        "StatusSTS.POWER1", "StatusSTS.POWER2", "StatusSTS.POWER3",
+        "StatusSTS.POWER4", "StatusSTS.POWER5", "StatusSTS.POWER6"};
+    constexpr const char* TASMOTA_WATTS[MAX_CHANNELS] = {
+        "StatusSNS.ENERGY.Power[0]", "StatusSNS.ENERGY.Power[1]", "StatusSNS.ENERGY.Power[2]",
+        "StatusSNS.ENERGY.Power[3]", "StatusSNS.ENERGY.Power[4]", "StatusSNS.ENERGY.Power[5]"};
+    constexpr const char* TASMOTA_SET[MAX_CHANNELS] = {
+        "POWER1", "POWER2", "POWER3", "POWER4", "POWER5", "POWER6"};
+    constexpr const char* GEN1_STATE[MAX_CHANNELS] = {
+        "relays[0].ison", "relays[1].ison", "relays[2].ison",
+        "relays[3].ison", "relays[4].ison", "relays[5].ison"};
+    constexpr const char* GEN1_WATTS[MAX_CHANNELS] = {
+        "meters[0].power", "meters[1].power", "meters[2].power",
+        "meters[3].power", "meters[4].power", "meters[5].power"};
+    constexpr const char* GEN2_STATE[MAX_CHANNELS] = {
+        "switch:0.output", "switch:1.output", "switch:2.output",
+        "switch:3.output", "switch:4.output", "switch:5.output"};
+    constexpr const char* GEN2_WATTS[MAX_CHANNELS] = {
+        "switch:0.apower", "switch:1.apower", "switch:2.apower",
+        "switch:3.apower", "switch:4.apower", "switch:5.apower"};
+
+    // A single-channel unit is asked with `queryPath` and answers with the
+    // unindexed fields; a multi-channel one gets `batchPath` and answers
+    // with the per-channel ones. Single-relay Tasmota answers POWER where
+    // a strip answers POWER1, so both are looked for on channel 0. Shelly
+    // Gen2's Switch.Set reply does not echo the relay, so a successful set
+    // is taken as applied.
+    struct Protocol {
+        const char* name;
+        const char* controlFormat;  // channel, then onWord or offWord
+        uint8_t channelBase;        // Tasmota counts relays from 1
+        const char* onWord;
+        const char* offWord;
+        const char* queryPath;
+        const char* batchPath;
+        const char* setState;       // unindexed control reply field
+        const char* const* setStates;
+        const char* queryState;
+        const char* queryWatts;
+        const char* const* batchState;
+        const char* const* batchWatts;
+    };
+
+    static constexpr Protocol PROTOCOLS[] = {
+        {"tasmota", "/cm?cmnd=Power%u%%20%s", 1, "On", "Off",
+            "/cm?cmnd=Status%200", "/cm?cmnd=Status%200",
+            "POWER", TASMOTA_SET, "StatusSTS.POWER", "StatusSNS.ENERGY.Power", TASMOTA_STATE, TASMOTA_WATTS},
+        {"shelly_gen1", "/relay/%u?turn=%s", 0, "on", "off",
+            "/relay/0", "/status",
+            "ison", nullptr, "ison", "power", GEN1_STATE, GEN1_WATTS},
+        {"shelly_gen2", "/rpc/Switch.Set?id=%u&on=%s", 0, "true", "false",
+            "/rpc/Switch.GetStatus?id=0", "/rpc/Shelly.GetStatus",
+            nullptr, nullptr, "output", "apower", GEN2_STATE, GEN2_WATTS},
+    };
+
+    const Protocol* findProtocol(const char* method) {
+        for (const auto& p : PROTOCOLS) {
+            if (strcmp(method, p.name) == 0) return &p;
+        }
+        return nullptr;
+    }
+
+    // A job holds its entry from admission until its result is sent.
+    // Failed controls are not retried here; DeviceReconciler owns that.
+    struct ActiveJob {
+        Job job;
+        const Protocol* protocol;
+        bool used;
+        bool running;               // request is in the engine
+        JsonScan::Scanner reply;    // fed straight from the socket
     };
 
     QueueHandle_t controlQueue = nullptr;
@@ -37,184 +108,168 @@ namespace {
     TaskHandle_t workerTask = nullptr;
     ResultCallback resultCallback = nullptr;
 
-    struct HttpResult {
-        bool ok = false;
-        JsonDocument doc;
-    };
+    ActiveJob activeJobs[HttpEngine::MAX_IN_FLIGHT];
+    std::atomic<uint8_t> activeCount{0};
 
-    HttpResult httpGet(const String& url, int timeoutMs) {
-        HttpResult result;
-        HTTPClient http;
-        http.begin(url);
-        http.setConnectTimeout(CONNECT_TIMEOUT_MS);
-        http.setTimeout(timeoutMs);
-        
-        int httpCode = http.GET();
-        if (httpCode == 200) {
-            String payload = http.getString();
-            http.end();
-            if (!deserializeJson(result.doc, payload)) {
-                result.ok = true;
-            }
-        } else {
-            http.end();
-        }
-        return result;
+    // Every channel of the job, unreachable until filled in
+    AsyncResult resultFor(const Job& job) {
+        AsyncResult ar = {};
+        strlcpy(ar.method, job.method, sizeof(ar.method));
+        strlcpy(ar.target, job.target, sizeof(ar.target));
+        ar.firstChannel = job.isControl ? job.channel : 0;
+        ar.channelCount = job.isControl ? 1 : job.channelCount;
+        ar.wasControl = job.isControl;
+        ar.requestedState = job.on;
+        ar.sequence = job.sequence;
+        return ar;
     }
 
-    QueryResult setTasmota(const String& ip, bool on) {
-        QueryResult result;
-        String url = "http://" + ip + "/cm?cmnd=Power%20" + (on ? "On" : "Off");
-        auto resp = httpGet(url, CONTROL_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            const char* power = resp.doc["POWER"];
-            if (power) result.isOn = (strcmp(power, "ON") == 0);
-        }
-        return result;
-    }
+    std::atomic<uint32_t> droppedResults{0};
 
-    QueryResult setShellyGen1(const String& ip, bool on) {
-        QueryResult result;
-        String url = "http://" + ip + "/relay/0?turn=" + (on ? "on" : "off");
-        auto resp = httpGet(url, CONTROL_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            result.isOn = resp.doc["ison"] | false;
-        }
-        return result;
+    void sendResult(const AsyncResult& ar) {
+        if (xQueueSend(resultQueue, &ar, pdMS_TO_TICKS(100)) == pdTRUE) return;
+        droppedResults++;
+        Serial.printf("[DeviceController] Result queue full, dropped result for %s\n", ar.target);
     }
 
-    QueryResult setShellyGen2(const String& ip, bool on) {
-        QueryResult result;
-        String url = "http://" + ip + "/rpc/Switch.Set?id=0&on=" + (on ? "true" : "false");
-        auto resp = httpGet(url, CONTROL_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            result.isOn = on;
-        }
-        return result;
+    void scanReply(void* context, const char* data, size_t length) {
+        JsonScan::feed(*static_cast<JsonScan::Scanner*>(context), data, length);
     }
 
-    QueryResult queryTasmota(const String& ip) {
-        QueryResult result;
-        auto resp = httpGet("http://" + ip + "/cm?cmnd=Status%200", QUERY_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            const char* power = resp.doc["StatusSTS"]["POWER"];
-            if (power) result.isOn = (strcmp(power, "ON") == 0);
-            float watts = resp.doc["StatusSNS"]["ENERGY"]["Power"] | NAN;
-            if (!isnan(watts)) result.watts = watts;
-        }
-        return result;
+    // "ON" from Tasmota, true from Shelly
+    bool isOn(const JsonScan::Field* field) {
+        if (!field) return false;
+        if (field->kind == JsonScan::Kind::STRING) return strcmp(field->value, "ON") == 0;
+        return field->kind == JsonScan::Kind::BOOLEAN && strcmp(field->value, "true") == 0;
     }
 
-    QueryResult queryShellyGen1(const String& ip) {
-        QueryResult result;
-        auto resp = httpGet("http://" + ip + "/relay/0", QUERY_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            result.isOn = resp.doc["ison"] | false;
-            float watts = resp.doc["power"] | NAN;
-            if (!isnan(watts)) result.watts = watts;
-        }
-        return result;
+    // The channel's own field, else the unindexed one
+    const JsonScan::Field* channelField(const JsonScan::Scanner& reply, const char* indexed, const char* plain) {
+        const JsonScan::Field* field = indexed ? JsonScan::find(reply, indexed) : nullptr;
+        if (!field && plain) field = JsonScan::find(reply, plain);
+        return field;
     }
 
-    QueryResult queryShellyGen2(const String& ip) {
-        QueryResult result;
-        auto resp = httpGet("http://" + ip + "/rpc/Switch.GetStatus?id=0", QUERY_TIMEOUT_MS);
-        if (resp.ok) {
-            result.reachable = true;
-            result.isOn = resp.doc["output"] | false;
-            float watts = resp.doc["apower"] | NAN;
-            if (!isnan(watts)) result.watts = watts;
+    void startRequest(uint8_t index) {
+        ActiveJob& active = activeJobs[index];
+        const Job& job = active.job;
+        const Protocol* p = active.protocol;
+
+        HttpEngine::Request request = {};
+        const char* fields[JsonScan::MAX_FIELDS];
+        size_t fieldCount = 0;
+        if (job.isControl) {
+            if (p->setStates) fields[fieldCount++] = p->setStates[job.channel];
+            if (p->setState && (!p->setStates || job.channel == 0)) fields[fieldCount++] = p->setState;
+            snprintf(request.path, sizeof(request.path), p->controlFormat,
+                job.channel + p->channelBase, job.on ? p->onWord : p->offWord);
+        } else {
+            fields[fieldCount++] = p->queryState;
+            fields[fieldCount++] = p->queryWatts;
+            for (uint8_t ch = 0; ch < job.channelCount; ch++) {
+                fields[fieldCount++] = p->batchState[ch];
+                fields[fieldCount++] = p->batchWatts[ch];
+            }
+            strlcpy(request.path, job.channelCount > 1 ? p->batchPath : p->queryPath, sizeof(request.path));
         }
-        return result;
+        JsonScan::begin(active.reply, fields, fieldCount);
+
+        strlcpy(request.host, job.target, sizeof(request.host));
+        request.connectTimeoutMs = CONNECT_TIMEOUT_MS;
+        request.timeoutMs = job.isControl ? CONTROL_TIMEOUT_MS : QUERY_TIMEOUT_MS;
+        request.tag = index;
+        request.sink = scanReply;
+        request.sinkContext = &active.reply;
+        active.running = HttpEngine::start(request);
     }
 
-    struct Protocol {
-        const char* name;
-        QueryResult (*set)(const String&, bool);
-        QueryResult (*query)(const String&);
-    };
+    void finish(uint8_t index, const AsyncResult& ar) {
+        sendResult(ar);
+        activeJobs[index].used = false;
+        activeCount--;
+    }
 
-    static constexpr Protocol PROTOCOLS[] = {
-        {"tasmota",     setTasmota,     queryTasmota},
-        {"shelly_gen1", setShellyGen1,  queryShellyGen1},
-        {"shelly_gen2", setShellyGen2,  queryShellyGen2},
-    };
+    void onResponse(const HttpEngine::Response& response) {
+        uint8_t index = response.tag;
+        ActiveJob& active = activeJobs[index];
+        const Protocol* p = active.protocol;
+        active.running = false;
 
-    const Protocol* findProtocol(const String& method) {
-        for (const auto& p : PROTOCOLS) {
-            if (method == p.name) return &p;
+        AsyncResult ar = resultFor(active.job);
+        bool reachable = response.status == HttpEngine::Status::OK && response.httpCode == 200 &&
+            JsonScan::complete(active.reply);
+        for (uint8_t i = 0; reachable && i < ar.channelCount; i++) {
+            QueryResult& qr = ar.results[i];
+            uint8_t ch = ar.firstChannel + i;
+            qr.reachable = true;
+            if (!active.job.isControl) {
+                qr.isOn = isOn(channelField(active.reply, p->batchState[ch], ch == 0 ? p->queryState : nullptr));
+                qr.watts = JsonScan::number(
+                    channelField(active.reply, p->batchWatts[ch], ch == 0 ? p->queryWatts : nullptr));
+            } else if (p->setState || p->setStates) {
+                qr.isOn = isOn(channelField(active.reply, p->setStates ? p->setStates[ch] : nullptr, p->setState));
+            } else {
+                qr.isOn = active.job.on;
+            }
         }
-        return nullptr;
-    }
 
-    QueryResult doControl(const String& method, const String& target, bool on) {
-        const Protocol* p = findProtocol(method);
-        if (!p) {
-            Serial.printf("[DeviceCtrl] Unknown method: %s\n", method.c_str());
-            return QueryResult{};
-        }
-        QueryResult result;
-        for (int attempt = 0; attempt < CONTROL_MAX_ATTEMPTS; ++attempt) {
-            result = p->set(target, on);
-            if (result.reachable) {
-                Serial.printf("[DeviceCtrl] %s %s -> %s\n",
-                    p->name, target.c_str(), result.isOn ? "ON" : "OFF");
-                return result;
-            }
-            if (attempt < CONTROL_MAX_ATTEMPTS - 1) {
-                int delayMs = CONTROL_BACKOFF_MS[attempt];
-                Serial.printf("[DeviceCtrl] Retry %d/%d in %dms (%s %s)\n",
-                    attempt + 2, CONTROL_MAX_ATTEMPTS, delayMs,
-                    p->name, target.c_str());
-                vTaskDelay(pdMS_TO_TICKS(delayMs));
+        if (active.job.isControl) {
+            if (reachable) {
+                Serial.printf("[DeviceCtrl] %s %s #%u -> %s\n",
+                    p->name, active.job.target, active.job.channel, ar.results[0].isOn ? "ON" : "OFF");
+            } else {
+                Serial.printf("[DeviceCtrl] %s %s #%u failed\n", p->name, active.job.target, active.job.channel);
             }
+        } else if (!reachable) {
+            Serial.printf("[DeviceCtrl] %s query %s failed\n", p->name, active.job.target);
         }
-        Serial.printf("[DeviceCtrl] %s %s failed\n", p->name, target.c_str());
-        return result;
+        finish(index, ar);
     }
 
-    QueryResult doQuery(const String& method, const String& target) {
-        const Protocol* p = findProtocol(method);
+    // Takes the next job from `queue` while fewer than `limit` are active
+    bool admit(QueueHandle_t queue, size_t limit) {
+        if (activeCount >= limit || !HttpEngine::hasFreeSlot()) return false;
+
+        Job job;
+        if (xQueueReceive(queue, &job, 0) != pdTRUE) return false;
+
+        const Protocol* p = findProtocol(job.method);
         if (!p) {
-            Serial.printf("[DeviceCtrl] Unknown query method: %s\n", method.c_str());
-            return QueryResult{};
+            Serial.printf("[DeviceCtrl] Unknown method: %s\n", job.method);
+            sendResult(resultFor(job));
+            return true;
         }
-        QueryResult result = p->query(target);
-        if (!result.reachable) {
-            Serial.printf("[DeviceCtrl] %s query %s failed\n", p->name, target.c_str());
+
+        for (uint8_t i = 0; i < HttpEngine::MAX_IN_FLIGHT; i++) {
+            if (activeJobs[i].used) continue;
+            ActiveJob& active = activeJobs[i];
+            active.job = job;
+            active.protocol = p;
+            active.used = true;
+            active.running = false;
+            activeCount++;
+            startRequest(i);
+            return true;
         }
-        return result;
+        return false;
     }
 
     void workerTaskFn(void* param) {
-        Job job;
         for (;;) {
-            if (xQueueReceive(controlQueue, &job, 0) != pdTRUE) {
-                if (xQueueReceive(queryQueue, &job, pdMS_TO_TICKS(100)) != pdTRUE) {
-                    continue;
-                }
+            // Jobs the engine had no slot for
+            for (uint8_t i = 0; i < HttpEngine::MAX_IN_FLIGHT; i++) {
+                if (activeJobs[i].used && !activeJobs[i].running) startRequest(i);
             }
 
-                QueryResult qr;
-                if (job.isControl) {
-                    qr = doControl(String(job.method), String(job.target), job.on);
-                } else {
-                    qr = doQuery(String(job.method), String(job.target));
-                }
-
-                AsyncResult ar = {};
-                strlcpy(ar.method, job.method, sizeof(ar.method));
-                strlcpy(ar.target, job.target, sizeof(ar.target));
-                ar.result = qr;
-                ar.wasControl = job.isControl;
-                ar.requestedState = job.on;
-
-                xQueueSend(resultQueue, &ar, pdMS_TO_TICKS(100));
+            // Queries leave one entry free, so a control never waits behind a sweep
+            while (admit(controlQueue, HttpEngine::MAX_IN_FLIGHT)) {}
+            while (admit(queryQueue, HttpEngine::MAX_IN_FLIGHT - 1)) {}
+
+            if (activeCount == 0) {
+                vTaskDelay(pdMS_TO_TICKS(IDLE_WAIT_MS));
+                continue;
+            }
+            HttpEngine::poll(POLL_WAIT_MS, onResponse);
         }
     }
 }
@@ -250,29 +305,37 @@ void onResult(ResultCallback cb) {
     resultCallback = cb;
 }
 
-bool controlAsync(const String& method, const String& target, bool on) {
-    if (!controlQueue) return false;
+bool controlAsync(const String& method, const String& target, bool on, uint8_t channel, uint32_t sequence) {
+    if (!controlQueue || channel >= MAX_CHANNELS) return false;
     Job job = {};
     strlcpy(job.method, method.c_str(), sizeof(job.method));
     strlcpy(job.target, target.c_str(), sizeof(job.target));
     job.isControl = true;
     job.on = on;
+    job.channel = channel;
+    job.sequence = sequence;
     return xQueueSend(controlQueue, &job, 0) == pdTRUE;
 }
 
-bool queryAsync(const String& method, const String& target) {
-    if (!queryQueue) return false;
+bool queryAsync(const String& method, const String& target, uint8_t channelCount) {
+    if (!queryQueue || channelCount == 0 || channelCount > MAX_CHANNELS) return false;
     Job job = {};
     strlcpy(job.method, method.c_str(), sizeof(job.method));
     strlcpy(job.target, target.c_str(), sizeof(job.target));
     job.isControl = false;
     job.on = false;
+    job.channelCount = channelCount;
     return xQueueSend(queryQueue, &job, 0) == pdTRUE;
 }
 
 bool busy() {
     if (!controlQueue || !queryQueue) return false;
-    return uxQueueMessagesWaiting(controlQueue) > 0 || uxQueueMessagesWaiting(queryQueue) > 0;
+    return uxQueueMessagesWaiting(controlQueue) > 0 || uxQueueMessagesWaiting(queryQueue) > 0 ||
+        activeCount > 0;
+}
+
+uint32_t getDroppedResults() {
+    return droppedResults;
 }
 
 }
@@ -5,18 +5,30 @@
 
 namespace DeviceController {
 
+    // Relays on one physical unit: Shelly Pro 4PM, Tasmota power strips
+    constexpr uint8_t MAX_CHANNELS = 6;
+
+    constexpr uint32_t CONNECT_TIMEOUT_MS = 1000;
+    constexpr uint32_t CONTROL_TIMEOUT_MS = 2000;
+    constexpr uint32_t QUERY_TIMEOUT_MS = 1000;
+
     struct QueryResult {
         bool reachable = false;
         bool isOn = false;
         float watts = NAN;
     };
 
+    // A query reports every channel it asked for; a control reports the
+    // one channel it switched.
     struct AsyncResult {
         char method[16];
         char target[40];
-        QueryResult result;
+        uint8_t firstChannel;
+        uint8_t channelCount;
+        QueryResult results[MAX_CHANNELS];  // results[i] is channel firstChannel + i
         bool wasControl;      // true = control, false = query
         bool requestedState;  // the `on` param from controlAsync()
+        uint32_t sequence;    // the `sequence` param from controlAsync()
     };
 
     using ResultCallback = std::function<void(const AsyncResult& result)>;
@@ -26,8 +38,16 @@ namespace DeviceController {
 
     void onResult(ResultCallback cb);
 
-    bool controlAsync(const String& method, const String& target, bool on);
-    bool queryAsync(const String& method, const String& target);
+    // `sequence` is echoed in the result, so a caller can tell which of its
+    // attempts a late result answers
+    bool controlAsync(const String& method, const String& target, bool on, uint8_t channel = 0,
+                      uint32_t sequence = 0);
+
+    // One request for channels 0 .. channelCount - 1 of the unit
+    bool queryAsync(const String& method, const String& target, uint8_t channelCount = 1);
 
     bool busy();
+
+    // Results lost because the main loop did not drain the result queue
+    uint32_t getDroppedResults();
 }
@@ -1,11 +1,15 @@
 #include "device_modes.h"
 #include "storage.h"
-#include "device_controller.h"
+#include "device_reconciler.h"
 #include "devices.h"
 #include "sensor_config.h"
 #include "websocket_server.h"
 #include "event_log.h"
 #include "time_utils.h"
+#include "rule_engine.h"
+#include "timer_heap.h"
+#include "change_set.h"
+#include <LittleFS.h>
 #include <vector>
 #include <cmath>
 
@@ -13,55 +17,101 @@ namespace DeviceModes {
 
 namespace {
     const char* MODES_PATH = "/device_modes.json";
-    const unsigned long EVAL_INTERVAL = 2000;
+    const char* SNAPSHOT_PATH = "/device_modes.bin";
     const unsigned long MIN_CYCLE_SEC = 5;
 
     // Day/night detection — light-sensor first with hardcoded fallback schedule.
     // Industry-standard hysteresis to prevent flapping at threshold.
     constexpr float LIGHT_THRESHOLD = 10.0f;
     constexpr float LIGHT_DEADZONE = 5.0f;
-    constexpr const char* DAY_START = "06:00";
-    constexpr const char* NIGHT_START = "22:00";
+    constexpr int DAY_START = 6 * 60;       // local minutes
+    constexpr int NIGHT_START = 22 * 60;
 
     std::vector<DeviceModeConfig> configs;
     bool currentDaytime = true;
     bool firstEvalDone = false;
-
-    unsigned long lastEvaluation = 0;
     const unsigned long STARTUP_GRACE_MS = 15000;
 
-    struct CycleState {
-        bool isOn = false;
-        unsigned long lastToggleMs = 0;
-    };
-    std::map<String, CycleState> cycleStates;
-
-    struct AutoState {
-        bool triggered = false;
-        bool pending = false;
+    // Next evaluation per config, by device handle, plus the clock's next
+    // day/night edge. Readings, device states and day/night flips wake
+    // configs early; with nothing due, loop() does no work.
+    constexpr uint16_t DAY_NIGHT_TIMER = Registry::MAX_HANDLES;
+    TimerHeap<Registry::MAX_HANDLES + 1> timers;
+    uint32_t clockRevision = 0;
+
+    // Handles cached from configs and SensorConfig; refreshed when either changes
+    uint32_t resolvedGeneration = 0;
+    uint32_t resolvedSensorRevision = 0;
+    Registry::Handle lightSensor = Registry::INVALID_HANDLE;
+
+    // Auto configs by trigger sensor: configs[sensorRules[i]] for i in
+    // [sensorRuleStart[s], sensorRuleStart[s + 1]). Rebuilt when configs or
+    // handles change.
+    uint16_t sensorRuleStart[Registry::MAX_HANDLES + 1] = {};
+    std::vector<uint16_t> sensorRules;
+    bool indexDirty = true;
+    ChangeSet changes;       // by device handle
+
+    // Evaluation state per device handle, reset when the device's config changes
+    struct Runtime {
+        unsigned long anchorMs = 0;     // cycle phase origin
+        bool anchored = false;          // anchorMs is set; fixed on first evaluation
+        bool seen = false;              // lastValue holds a result
+        bool lastValue = false;
+        bool triggered = false;         // auto: last confirmed state
+        bool pending = false;           // auto: a switch to pendingState is under way
         bool pendingState = false;
-        char reportSensorName[32] = "";
+        uint16_t sensorsMet = 0;        // per-leaf hysteresis, see RuleEngine::Context
+        int8_t reportNode = -1;         // auto: sensor node behind the pending switch
         float reportValue = NAN;
         float reportThreshold = NAN;
     };
-    std::map<String, AutoState> autoStates;
+    Runtime runtimes[Registry::MAX_HANDLES];
+
+    // Binary snapshot of the runtime that outlives a restart: cycle phases,
+    // as wall-clock anchors, and confirmed auto states. Written at most once
+    // per SNAPSHOT_INTERVAL_MS and only with a synced clock.
+    constexpr uint32_t SNAPSHOT_MAGIC = 0x53444D47;     // "GMDS"
+    constexpr uint8_t SNAPSHOT_VERSION = 1;
+    constexpr unsigned long SNAPSHOT_INTERVAL_MS = 60000;
+    constexpr uint8_t SNAPSHOT_ANCHORED = 0x01;
+    constexpr uint8_t SNAPSHOT_TRIGGERED = 0x02;
+
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t count;
+        uint16_t recordSize;
+    };
+
+    struct SnapshotRecord {
+        char deviceId[24];
+        uint8_t mode;
+        uint8_t flags;
+        uint16_t sensorsMet;
+        uint8_t reserved[4];
+        int64_t anchorEpochMs;
+    };
 
-    std::map<String, unsigned long> lastControlAttempt;
-    const unsigned long OFFLINE_RETRY_INTERVAL = 30000;
+    bool snapshotDirty = false;
+    unsigned long lastSnapshotAt = 0;
 
     enum ApplyResult {
         APPLY_QUEUED,
         APPLY_ALREADY_STATE,
-        APPLY_THROTTLED,
-        APPLY_QUEUE_FULL,
         APPLY_NO_DEVICE,
     };
 
-    DeviceModeConfig* findConfig(const char* deviceId) {
+    void resetRuntime(Registry::Handle handle) {
+        if (handle >= Registry::MAX_HANDLES) return;
+        runtimes[handle] = Runtime{};
+        snapshotDirty = true;
+    }
+
+    DeviceModeConfig* findConfig(Registry::Handle device) {
+        if (device == Registry::INVALID_HANDLE) return nullptr;
         for (auto& cfg : configs) {
-            if (strcmp(cfg.deviceId, deviceId) == 0) {
-                return &cfg;
-            }
+            if (cfg.device == device) return &cfg;
         }
         return nullptr;
     }
@@ -78,9 +128,20 @@ namespace {
         return "";
     }
 
-    const char* getSensorLabel(const char* sensorId) {
-        SensorConfig::Sensor* sensor = SensorConfig::getSensor(sensorId);
-        return sensor ? sensor->name : sensorId;
+    Registry::Handle findFirstSensorByType(const char* sensorType) {
+        size_t count = SensorConfig::getSensorCount();
+        for (size_t i = 0; i < count; i++) {
+            SensorConfig::Sensor* sensor = SensorConfig::getSensorByIndex(i);
+            if (strcmp(sensor->type, sensorType) == 0) return sensor->handle;
+        }
+        return Registry::INVALID_HANDLE;
+    }
+
+    const char* getSensorLabel(Registry::Handle handle) {
+        SensorConfig::Sensor* sensor = SensorConfig::getSensor(handle);
+        if (sensor) return sensor->name;
+        const char* id = Registry::getId(handle);
+        return id ? id : "";
     }
 
     void syncTriggerSensorType(AutoTrigger& trigger) {
@@ -102,16 +163,141 @@ namespace {
         syncTriggerSensorType(trigger);
     }
 
-    void pushAutoEvent(const DeviceModeConfig& cfg, const AutoState& state, bool on) {
-        Devices::Device* device = Devices::getDevice(cfg.deviceId);
+    void writeTrigger(JsonObject t, const AutoTrigger& trigger) {
+        t["sensorId"] = trigger.sensorId;
+        if (trigger.sensorType[0] != '\0') t["sensorType"] = trigger.sensorType;
+        t["dayThreshold"] = trigger.dayThreshold;
+        t["nightThreshold"] = trigger.nightThreshold;
+        t["deadzone"] = trigger.deadzone;
+        t["triggerAbove"] = trigger.triggerAbove;
+    }
+
+    // The mode's settings as a RuleEngine expression; false when there is nothing to run
+    bool buildExpression(const DeviceModeConfig& cfg, JsonDocument& expr) {
+        switch (cfg.mode) {
+            case MODE_AUTO: {
+                if (cfg.rule.length() > 0) return !deserializeJson(expr, cfg.rule);
+                if (cfg.triggerCount == 0) return false;
+                JsonArray any = expr["or"].to<JsonArray>();
+                for (uint8_t i = 0; i < cfg.triggerCount; i++) {
+                    writeTrigger(any.add<JsonObject>(), cfg.triggers[i]);
+                }
+                return true;
+            }
+            case MODE_CYCLE: {
+                JsonObject cycle = cfg.cycle.dayOnly
+                    ? expr["and"].to<JsonArray>().add<JsonObject>()
+                    : expr.to<JsonObject>();
+                cycle["onDurationSec"] = cfg.cycle.onDurationSec;
+                cycle["offDurationSec"] = cfg.cycle.offDurationSec;
+                if (cfg.cycle.dayOnly) expr["and"].add<JsonObject>()["daytime"] = true;
+                return true;
+            }
+            case MODE_SCHEDULE:
+                expr["startTime"] = cfg.schedule.startTime;
+                expr["endTime"] = cfg.schedule.endTime;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void compileProgram(DeviceModeConfig& cfg) {
+        cfg.program = RuleEngine::Program{};
+        JsonDocument expr;
+        if (!buildExpression(cfg, expr)) return;
+        if (!RuleEngine::compile(expr, cfg.program)) {
+            Serial.printf("[DeviceModes] Rule for %s does not compile\n", cfg.deviceId);
+        }
+    }
+
+    void resolveHandles(DeviceModeConfig& cfg) {
+        cfg.device = Registry::find(cfg.deviceId);
+        for (uint8_t i = 0; i < cfg.triggerCount; i++) {
+            resolveLegacyTrigger(cfg.triggers[i]);
+        }
+        compileProgram(cfg);
+    }
+
+    // Ids only change on config edits, so handle lookups happen here rather than per evaluation
+    void refreshHandles() {
+        uint32_t generation = Registry::getGeneration();
+        uint32_t sensorRevision = SensorConfig::getRevision();
+        if (generation == resolvedGeneration && sensorRevision == resolvedSensorRevision) return;
+        resolvedGeneration = generation;
+        resolvedSensorRevision = sensorRevision;
+
+        for (auto& cfg : configs) {
+            resolveHandles(cfg);
+        }
+        lightSensor = findFirstSensorByType("light");
+        indexDirty = true;
+    }
+
+    // Each auto config is listed once under every sensor its rule reads
+    template <typename Visit>
+    void forEachRuleSensor(const DeviceModeConfig& cfg, Visit visit) {
+        if (cfg.mode != MODE_AUTO || cfg.device == Registry::INVALID_HANDLE) return;
+        const RuleEngine::Program& program = cfg.program;
+        for (uint8_t i = 0; i < program.count; i++) {
+            Registry::Handle sensor = program.nodes[i].handle;
+            if (program.nodes[i].op != RuleEngine::Op::SENSOR || sensor >= Registry::MAX_HANDLES) continue;
+            bool repeated = false;
+            for (uint8_t j = 0; j < i; j++) {
+                repeated = repeated || (program.nodes[j].op == RuleEngine::Op::SENSOR && program.nodes[j].handle == sensor);
+            }
+            if (!repeated) visit(sensor);
+        }
+    }
+
+    void wakeAll(unsigned long now) {
+        for (const auto& cfg : configs) {
+            if (cfg.device != Registry::INVALID_HANDLE) timers.schedule(cfg.device, now);
+        }
+    }
+
+    // Every deadline from scratch, e.g. after a config edit or a clock change
+    void rescheduleAll() {
+        unsigned long now = millis();
+        timers.clear();
+        wakeAll(now);
+        timers.schedule(DAY_NIGHT_TIMER, now);
+    }
+
+    void rebuildIndex() {
+        indexDirty = false;
+        memset(sensorRuleStart, 0, sizeof(sensorRuleStart));
+        for (const auto& cfg : configs) {
+            forEachRuleSensor(cfg, [](Registry::Handle sensor) { sensorRuleStart[sensor + 1]++; });
+        }
+        for (size_t s = 0; s < Registry::MAX_HANDLES; s++) {
+            sensorRuleStart[s + 1] += sensorRuleStart[s];
+        }
+
+        sensorRules.resize(sensorRuleStart[Registry::MAX_HANDLES]);
+        uint16_t next[Registry::MAX_HANDLES];
+        memcpy(next, sensorRuleStart, sizeof(next));
+        for (size_t c = 0; c < configs.size(); c++) {
+            forEachRuleSensor(configs[c], [&](Registry::Handle sensor) { sensorRules[next[sensor]++] = c; });
+        }
+        rescheduleAll();
+    }
+
+    void refreshIndex() {
+        refreshHandles();
+        if (indexDirty) rebuildIndex();
+    }
+
+    void pushAutoEvent(const DeviceModeConfig& cfg, const Runtime& state, bool on) {
+        Devices::Device* device = Devices::getDevice(cfg.device);
         const char* name = device ? device->name : cfg.deviceId;
         char title[48];
         snprintf(title, sizeof(title), "%s (auto)", name);
         char desc[128];
-        if (state.reportSensorName[0] != '\0' && !std::isnan(state.reportValue) && !std::isnan(state.reportThreshold)) {
+        if (state.reportNode >= 0 && !std::isnan(state.reportValue) && !std::isnan(state.reportThreshold)) {
             snprintf(desc, sizeof(desc), "%s — %s at %.1f (threshold %.1f)",
                 on ? "Turned on" : "Turned off",
-                state.reportSensorName,
+                getSensorLabel(cfg.program.nodes[state.reportNode].handle),
                 state.reportValue,
                 state.reportThreshold);
         } else {
@@ -121,198 +307,262 @@ namespace {
     }
 
     ApplyResult applyDeviceState(const DeviceModeConfig& cfg, bool on, bool force = false) {
-        Devices::Device* device = Devices::getDevice(cfg.deviceId);
-        if (!device) return APPLY_NO_DEVICE;
-
-        if (!force && device->isOn == on && device->isOnline) return APPLY_ALREADY_STATE;
-
-        // Throttle control attempts for offline devices to avoid flooding the job queue
-        if (!device->isOnline) {
-            String key(cfg.deviceId);
-            unsigned long now = millis();
-            unsigned long& last = lastControlAttempt[key];
-            if (now - last < OFFLINE_RETRY_INTERVAL && last != 0) return APPLY_THROTTLED;
-            last = now;
-        }
+        if (!Devices::getDevice(cfg.device)) return APPLY_NO_DEVICE;
+        // Repeats collapse in the reconciler, which also paces retries for offline devices
+        return DeviceReconciler::setDesired(cfg.device, on, force) ? APPLY_QUEUED : APPLY_ALREADY_STATE;
+    }
 
-        if (DeviceController::controlAsync(device->controlMethod, device->ipAddress, on)) {
-            Serial.printf("[DeviceModes] Queued %s -> %s\n", cfg.deviceId, on ? "ON" : "OFF");
-            return APPLY_QUEUED;
-        } else {
-            Serial.printf("[DeviceModes] Queue full, skipping %s\n", cfg.deviceId);
-            return APPLY_QUEUE_FULL;
+    bool readsDevice(const RuleEngine::Program& program, Registry::Handle device) {
+        for (uint8_t i = 0; i < program.count; i++) {
+            if (program.nodes[i].op == RuleEngine::Op::DEVICE_ON && program.nodes[i].handle == device) return true;
         }
+        return false;
     }
 
-    float getSensorValue(const char* sensorId, const std::map<String, float>& readings) {
-        auto it = readings.find(String(sensorId));
-        if (it == readings.end()) return NAN;
-        return it->second;
-    }
-
-    void updateDayNight(const std::map<String, float>& readings) {
-        float light = NAN;
-        for (const auto& pair : readings) {
-            SensorConfig::Sensor* cfg = SensorConfig::getSensor(pair.first.c_str());
-            if (cfg && strcmp(cfg->type, "light") == 0) {
-                light = pair.second;
-                break;
-            }
-        }
+    // Without a light reading the clock decides, and the timer waits for its next edge
+    void updateDayNight(const Registry::Readings& readings) {
+        bool wasDaytime = currentDaytime;
+        float light = readings.get(lightSensor);
 
         if (std::isnan(light)) {
-            currentDaytime = TimeUtils::isTimeInRange(DAY_START, NIGHT_START);
-            return;
-        }
-
-        if (currentDaytime) {
-            if (light < LIGHT_THRESHOLD - LIGHT_DEADZONE) {
+            currentDaytime = TimeUtils::isMinuteInRange(TimeUtils::currentMinutes(), DAY_START, NIGHT_START);
+            int32_t seconds = TimeUtils::secondsUntilMinute(currentDaytime ? NIGHT_START : DAY_START);
+            if (seconds >= 0) timers.schedule(DAY_NIGHT_TIMER, millis() + seconds * 1000UL);
+            else timers.cancel(DAY_NIGHT_TIMER);
+        } else {
+            timers.cancel(DAY_NIGHT_TIMER);
+            if (currentDaytime && light < LIGHT_THRESHOLD - LIGHT_DEADZONE) {
                 currentDaytime = false;
                 Serial.println("[DeviceModes] Day -> Night (light sensor)");
-            }
-        } else {
-            if (light > LIGHT_THRESHOLD + LIGHT_DEADZONE) {
+            } else if (!currentDaytime && light > LIGHT_THRESHOLD + LIGHT_DEADZONE) {
                 currentDaytime = true;
                 Serial.println("[DeviceModes] Night -> Day (light sensor)");
             }
         }
+
+        // Thresholds and day-only cycles follow the switch
+        if (currentDaytime != wasDaytime) wakeAll(millis());
+    }
+
+    RuleEngine::Context contextFor(const Registry::Readings& readings, Runtime& state) {
+        if (!state.anchored) {
+            state.anchored = true;
+            state.anchorMs = millis();
+            snapshotDirty = true;
+        }
+        return {&readings, currentDaytime, TimeUtils::currentMinutes(), millis(), state.anchorMs, state.sensorsMet};
+    }
+
+    RuleEngine::Result evaluate(const DeviceModeConfig& cfg, const Registry::Readings& readings, Runtime& state) {
+        RuleEngine::Result result = RuleEngine::evaluate(cfg.program, contextFor(readings, state));
+        if (result.sensorsMet != state.sensorsMet) {
+            state.sensorsMet = result.sensorsMet;
+            snapshotDirty = true;
+        }
+        return result;
     }
 
-    void evaluateAuto(DeviceModeConfig& cfg, const std::map<String, float>& readings) {
-        if (cfg.triggerCount == 0) return;
+    void evaluateAuto(DeviceModeConfig& cfg, const Registry::Readings& readings) {
+        if (cfg.program.count == 0 || cfg.device == Registry::INVALID_HANDLE) return;
 
-        String key(cfg.deviceId);
-        AutoState& state = autoStates[key];
+        Runtime& state = runtimes[cfg.device];
         bool wasTriggered = state.triggered;
-        bool anyTriggerMet = false;
-        const char* reportSensorId = nullptr;
-        float reportValue = NAN;
-        float reportThreshold = NAN;
+        RuleEngine::Result result = evaluate(cfg, readings, state);
+        bool met = result.value;
 
-        for (uint8_t i = 0; i < cfg.triggerCount; i++) {
-            AutoTrigger& trigger = cfg.triggers[i];
-            resolveLegacyTrigger(trigger);
-            float value = getSensorValue(trigger.sensorId, readings);
-            if (std::isnan(value)) continue;
+        // Nothing new: already heading there, or no change
+        if (state.pending ? state.pendingState == met : met == wasTriggered) return;
 
-            float threshold = currentDaytime ? trigger.dayThreshold : trigger.nightThreshold;
+        ApplyResult applied = applyDeviceState(cfg, met, true);
+        if (met == wasTriggered) {
+            // Flapped back before the switch was confirmed
+            state.pending = false;
+        } else if (applied == APPLY_QUEUED) {
+            state.pending = true;
+            state.pendingState = met;
+            state.reportNode = result.report;
+            state.reportValue = result.reportValue;
+            state.reportThreshold = result.reportThreshold;
+        } else if (applied == APPLY_ALREADY_STATE) {
+            state.triggered = met;
+            snapshotDirty = true;
+        }
+    }
 
-            if (!reportSensorId) {
-                reportSensorId = trigger.sensorId;
-                reportValue = value;
-                reportThreshold = threshold;
-            }
+    // Cycle and schedule follow their program. A cycle only switches on a
+    // phase change, so a manual toggle holds until the next one; a schedule
+    // is reasserted whenever it runs, which includes the device reporting
+    // another state.
+    void evaluateTimed(DeviceModeConfig& cfg, const Registry::Readings& readings) {
+        if (cfg.program.count == 0 || cfg.device == Registry::INVALID_HANDLE) return;
+
+        Runtime& state = runtimes[cfg.device];
+        bool on = evaluate(cfg, readings, state).value;
+        bool changed = !state.seen || on != state.lastValue;
+        if (changed && state.seen) {
+            Serial.printf("[DeviceModes] %s %s -> %s\n", modeToString(cfg.mode), cfg.deviceId, on ? "ON" : "OFF");
+        }
+        state.seen = true;
+        state.lastValue = on;
 
-            // Hysteresis: tighten or loosen the threshold by deadzone based on current state.
-            // For triggerAbove: ON when value > threshold + dz, stay ON until value < threshold - dz.
-            // For triggerBelow: ON when value < threshold - dz, stay ON until value > threshold + dz.
-            float effectiveThreshold = wasTriggered
-                ? (trigger.triggerAbove ? threshold - trigger.deadzone : threshold + trigger.deadzone)
-                : (trigger.triggerAbove ? threshold + trigger.deadzone : threshold - trigger.deadzone);
-            bool met = trigger.triggerAbove ? (value > effectiveThreshold) : (value < effectiveThreshold);
-
-            if (met) {
-                anyTriggerMet = true;
-                reportSensorId = trigger.sensorId;
-                reportValue = value;
-                reportThreshold = threshold;
-            }
+        if (changed || cfg.mode == MODE_SCHEDULE) applyDeviceState(cfg, on);
+    }
+
+    void runConfig(DeviceModeConfig& cfg, const Registry::Readings& readings) {
+        switch (cfg.mode) {
+            case MODE_OFF:
+                applyDeviceState(cfg, false);
+                break;
+            case MODE_ON:
+                applyDeviceState(cfg, true);
+                break;
+            case MODE_AUTO:
+                evaluateAuto(cfg, readings);
+                break;
+            case MODE_CYCLE:
+            case MODE_SCHEDULE:
+                evaluateTimed(cfg, readings);
+                break;
         }
 
-        if (state.pending) return;
-        if (anyTriggerMet == wasTriggered) return;
+        Runtime& state = runtimes[cfg.device];
+        uint32_t waitMs = RuleEngine::msUntilChange(cfg.program, contextFor(readings, state));
+        if (waitMs == RuleEngine::NO_DEADLINE) timers.cancel(cfg.device);
+        else timers.schedule(cfg.device, millis() + waitMs);
+    }
 
-        ApplyResult result = applyDeviceState(cfg, anyTriggerMet, true);
-        if (result == APPLY_QUEUED) {
-            state.pending = true;
-            state.pendingState = anyTriggerMet;
-            if (reportSensorId) {
-                strlcpy(state.reportSensorName, getSensorLabel(reportSensorId), sizeof(state.reportSensorName));
-            } else {
-                state.reportSensorName[0] = '\0';
-            }
-            state.reportValue = reportValue;
-            state.reportThreshold = reportThreshold;
-        } else if (result == APPLY_ALREADY_STATE) {
-            state.triggered = anyTriggerMet;
+    uint32_t cyclePeriodMs(const RuleEngine::Program& program) {
+        for (uint8_t i = 0; i < program.count; i++) {
+            const RuleEngine::Node& node = program.nodes[i];
+            if (node.op == RuleEngine::Op::CYCLE) return (node.cycle.onSec + node.cycle.offSec) * 1000;
         }
+        return 0;
     }
 
-    void evaluateCycle(DeviceModeConfig& cfg) {
-        String key(cfg.deviceId);
-        CycleState& state = cycleStates[key];
+    void saveSnapshot() {
+        int64_t nowEpochMs = TimeUtils::epochMs();
+        if (nowEpochMs < 0) return;     // anchors need the wall clock
 
-        if (cfg.cycle.dayOnly && !currentDaytime) {
-            if (state.isOn) {
-                applyDeviceState(cfg, false);
-                state.isOn = false;
+        std::vector<SnapshotRecord> records;
+        records.reserve(configs.size());
+        unsigned long now = millis();
+        for (const auto& cfg : configs) {
+            if (cfg.device == Registry::INVALID_HANDLE) continue;
+            const Runtime& state = runtimes[cfg.device];
+            SnapshotRecord record = {};
+            strlcpy(record.deviceId, cfg.deviceId, sizeof(record.deviceId));
+            record.mode = cfg.mode;
+            if (state.anchored) {
+                record.flags |= SNAPSHOT_ANCHORED;
+                record.anchorEpochMs = nowEpochMs - (int64_t)(now - state.anchorMs);
             }
-            return;
+            if (state.triggered) record.flags |= SNAPSHOT_TRIGGERED;
+            record.sensorsMet = state.sensorsMet;
+            records.push_back(record);
         }
 
-        if (state.lastToggleMs == 0) {
-            state.lastToggleMs = millis();
-            state.isOn = true;
-            applyDeviceState(cfg, true);
+        SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, (uint8_t)records.size(), sizeof(SnapshotRecord)};
+        File file = LittleFS.open(SNAPSHOT_PATH, "w");
+        if (!file) {
+            Serial.println("[DeviceModes] Failed to write state snapshot");
             return;
         }
+        file.write((const uint8_t*)&header, sizeof(header));
+        file.write((const uint8_t*)records.data(), records.size() * sizeof(SnapshotRecord));
+        file.close();
+        snapshotDirty = false;
+        lastSnapshotAt = now;
+    }
 
-        unsigned long elapsed = (millis() - state.lastToggleMs) / 1000;
-        unsigned long currentPhaseDuration = state.isOn
-            ? cfg.cycle.onDurationSec : cfg.cycle.offDurationSec;
+    // Cycles resume their phase across the downtime when the clock is
+    // already synced, else start over; auto configs keep their confirmed
+    // state, so hysteresis holds through a restart
+    void restoreSnapshot() {
+        File file = LittleFS.open(SNAPSHOT_PATH, "r");
+        if (!file) return;
+
+        SnapshotHeader header;
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+            header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+            header.recordSize != sizeof(SnapshotRecord)) {
+            file.close();
+            return;
+        }
 
-        if (elapsed >= currentPhaseDuration) {
-            state.isOn = !state.isOn;
-            state.lastToggleMs = millis();
-            applyDeviceState(cfg, state.isOn);
-            Serial.printf("[DeviceModes] CYCLE %s -> %s\n",
-                cfg.deviceId, state.isOn ? "ON" : "OFF");
+        int64_t nowEpochMs = TimeUtils::epochMs();
+        unsigned long now = millis();
+        uint8_t restored = 0;
+        SnapshotRecord record;
+        for (uint8_t i = 0; i < header.count; i++) {
+            if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) break;
+            record.deviceId[sizeof(record.deviceId) - 1] = '\0';
+            DeviceModeConfig* cfg = findConfig(Registry::find(record.deviceId));
+            if (!cfg || cfg->mode != record.mode) continue;
+
+            Runtime& state = runtimes[cfg->device];
+            state.triggered = record.flags & SNAPSHOT_TRIGGERED;
+            state.sensorsMet = record.sensorsMet;
+            uint32_t periodMs = cyclePeriodMs(cfg->program);
+            if ((record.flags & SNAPSHOT_ANCHORED) && periodMs > 0 && nowEpochMs >= record.anchorEpochMs) {
+                // Past what millis() spans only the phase is kept
+                int64_t elapsed = nowEpochMs - record.anchorEpochMs;
+                if (elapsed >= INT32_MAX) elapsed %= periodMs;
+                state.anchored = true;
+                state.anchorMs = now - (unsigned long)elapsed;
+            }
+            restored++;
         }
+        file.close();
+        Serial.printf("[DeviceModes] Restored state for %u configs\n", restored);
     }
 
-    void evaluateSchedule(DeviceModeConfig& cfg) {
-        bool inRange = TimeUtils::isTimeInRange(cfg.schedule.startTime, cfg.schedule.endTime);
-        applyDeviceState(cfg, inRange);
+    bool startupGraceOver() {
+        if (firstEvalDone) return true;
+        if (millis() < STARTUP_GRACE_MS) return false;
+        firstEvalDone = true;
+        restoreSnapshot();
+        return true;
     }
 
-    void serializeConfigs(JsonDocument& doc) {
-        JsonArray arr = doc.to<JsonArray>();
-        for (const auto& cfg : configs) {
-            JsonObject obj = arr.add<JsonObject>();
-            obj["deviceId"] = cfg.deviceId;
-            obj["mode"] = modeToString(cfg.mode);
+    void writeConfig(JsonObject obj, const DeviceModeConfig& cfg) {
+        obj["deviceId"] = cfg.deviceId;
+        obj["mode"] = modeToString(cfg.mode);
 
-            if (cfg.mode == MODE_AUTO && cfg.triggerCount > 0) {
-                JsonArray triggers = obj["triggers"].to<JsonArray>();
-                for (uint8_t i = 0; i < cfg.triggerCount; i++) {
-                    JsonObject t = triggers.add<JsonObject>();
-                    t["sensorId"] = cfg.triggers[i].sensorId;
-                    if (cfg.triggers[i].sensorType[0] != '\0') t["sensorType"] = cfg.triggers[i].sensorType;
-                    t["dayThreshold"] = cfg.triggers[i].dayThreshold;
-                    t["nightThreshold"] = cfg.triggers[i].nightThreshold;
-                    t["deadzone"] = cfg.triggers[i].deadzone;
-                    t["triggerAbove"] = cfg.triggers[i].triggerAbove;
-                }
+        if (cfg.mode == MODE_AUTO && cfg.triggerCount > 0) {
+            JsonArray triggers = obj["triggers"].to<JsonArray>();
+            for (uint8_t i = 0; i < cfg.triggerCount; i++) {
+                writeTrigger(triggers.add<JsonObject>(), cfg.triggers[i]);
             }
+        }
 
-            if (cfg.mode == MODE_CYCLE) {
-                JsonObject cycle = obj["cycle"].to<JsonObject>();
-                cycle["onDurationSec"] = cfg.cycle.onDurationSec;
-                cycle["offDurationSec"] = cfg.cycle.offDurationSec;
-                cycle["dayOnly"] = cfg.cycle.dayOnly;
-            }
+        if (cfg.mode == MODE_AUTO && cfg.rule.length() > 0) {
+            JsonDocument rule;
+            if (!deserializeJson(rule, cfg.rule)) obj["rule"] = rule;
+        }
 
-            if (cfg.mode == MODE_SCHEDULE) {
-                JsonObject sched = obj["schedule"].to<JsonObject>();
-                sched["startTime"] = cfg.schedule.startTime;
-                sched["endTime"] = cfg.schedule.endTime;
-            }
+        if (cfg.mode == MODE_CYCLE) {
+            JsonObject cycle = obj["cycle"].to<JsonObject>();
+            cycle["onDurationSec"] = cfg.cycle.onDurationSec;
+            cycle["offDurationSec"] = cfg.cycle.offDurationSec;
+            cycle["dayOnly"] = cfg.cycle.dayOnly;
+        }
+
+        if (cfg.mode == MODE_SCHEDULE) {
+            JsonObject sched = obj["schedule"].to<JsonObject>();
+            sched["startTime"] = cfg.schedule.startTime;
+            sched["endTime"] = cfg.schedule.endTime;
+        }
+    }
+
+    void serializeConfigs(JsonArray arr) {
+        for (const auto& cfg : configs) {
+            writeConfig(arr.add<JsonObject>(), cfg);
         }
     }
 
     void saveModes() {
         JsonDocument doc;
-        serializeConfigs(doc);
+        serializeConfigs(doc.to<JsonArray>());
         Storage::writeJson(MODES_PATH, doc);
         Serial.printf("[DeviceModes] Saved %d mode configs\n", configs.size());
     }
@@ -338,6 +588,10 @@ namespace {
             }
         }
 
+        if (obj["rule"].is<JsonObject>()) {
+            serializeJson(obj["rule"], cfg.rule);
+        }
+
         if (obj["cycle"].is<JsonObject>()) {
             JsonObject cycle = obj["cycle"].as<JsonObject>();
             cfg.cycle.onDurationSec = max((unsigned long)MIN_CYCLE_SEC, (unsigned long)(cycle["onDurationSec"] | 300));
@@ -352,6 +606,32 @@ namespace {
         }
     }
 
+    // "HH:MM" moved by `minutes`, wrapping around midnight
+    void shiftTime(char* hhmm, size_t size, int minutes) {
+        int shifted = ((TimeUtils::parseTimeToMinutes(hhmm) + minutes) % 1440 + 1440) % 1440;
+        snprintf(hhmm, size, "%02d:%02d", shifted / 60, shifted % 60);
+    }
+
+    // Every window leaf in a rule expression, however deeply nested
+    void shiftWindows(JsonVariant node, int minutes) {
+        if (node.is<JsonArray>()) {
+            for (JsonVariant child : node.as<JsonArray>()) shiftWindows(child, minutes);
+            return;
+        }
+        if (!node.is<JsonObject>()) return;
+        for (JsonPair member : node.as<JsonObject>()) {
+            bool bound = strcmp(member.key().c_str(), "startTime") == 0 || strcmp(member.key().c_str(), "endTime") == 0;
+            if (bound && member.value().is<const char*>()) {
+                char hhmm[6];
+                strlcpy(hhmm, member.value().as<const char*>(), sizeof(hhmm));
+                shiftTime(hhmm, sizeof(hhmm), minutes);
+                member.value().set(hhmm);
+            } else {
+                shiftWindows(member.value(), minutes);
+            }
+        }
+    }
+
     void loadModes() {
         configs.clear();
         JsonDocument doc;
@@ -364,8 +644,10 @@ namespace {
         for (JsonObject obj : arr) {
             DeviceModeConfig cfg = {};
             parseConfig(obj, cfg);
+            resolveHandles(cfg);
             configs.push_back(cfg);
         }
+        indexDirty = true;
 
         Serial.printf("[DeviceModes] Loaded %d mode configs\n", configs.size());
     }
@@ -376,47 +658,64 @@ void init() {
     Serial.println("[DeviceModes] Initialized");
 }
 
-void loop(const std::map<String, float>& sensorReadings) {
-    if (millis() - lastEvaluation < EVAL_INTERVAL) return;
-    lastEvaluation = millis();
+void loop(const Registry::Readings& sensorReadings) {
+    refreshIndex();
 
-    updateDayNight(sensorReadings);
+    // Wall-clock deadlines moved with an NTP sync or a new zone
+    uint32_t revision = TimeUtils::getClockRevision();
+    if (revision != clockRevision) {
+        clockRevision = revision;
+        rescheduleAll();
+    }
 
-    if (!firstEvalDone && millis() < STARTUP_GRACE_MS) return;
-    firstEvalDone = true;
+    if (!startupGraceOver()) return;
 
-    for (auto& cfg : configs) {
-        switch (cfg.mode) {
-            case MODE_OFF:
-                applyDeviceState(cfg, false);
-                break;
-            case MODE_ON:
-                applyDeviceState(cfg, true);
-                break;
-            case MODE_AUTO:
-                evaluateAuto(cfg, sensorReadings);
-                break;
-            case MODE_CYCLE:
-                evaluateCycle(cfg);
-                break;
-            case MODE_SCHEDULE:
-                evaluateSchedule(cfg);
-                break;
-        }
+    // Day/night first, so the configs a flip wakes run once, on the new state
+    unsigned long now = millis();
+    if (timers.due(DAY_NIGHT_TIMER, now)) updateDayNight(sensorReadings);
+
+    uint16_t key;
+    while (timers.popDue(now, key)) {
+        DeviceModeConfig* cfg = findConfig(key);
+        if (cfg) runConfig(*cfg, sensorReadings);
+    }
+
+    if (snapshotDirty && millis() - lastSnapshotAt >= SNAPSHOT_INTERVAL_MS) saveSnapshot();
+}
+
+void onSensorReading(Registry::Handle sensor, const Registry::Readings& sensorReadings) {
+    if (sensor >= Registry::MAX_HANDLES) return;
+    refreshIndex();
+    if (sensor == lightSensor) updateDayNight(sensorReadings);
+    if (!startupGraceOver()) return;
+    for (uint16_t i = sensorRuleStart[sensor]; i < sensorRuleStart[sensor + 1]; i++) {
+        evaluateAuto(configs[sensorRules[i]], sensorReadings);
+    }
+}
+
+void onDeviceState(Registry::Handle device) {
+    if (device >= Registry::MAX_HANDLES) return;
+    unsigned long now = millis();
+    for (const auto& cfg : configs) {
+        if (cfg.device == Registry::INVALID_HANDLE) continue;
+        // A cycle's manual toggle holds, and an auto rule waits for its readings
+        bool reassert = cfg.device == device && cfg.mode != MODE_CYCLE && cfg.mode != MODE_AUTO;
+        if (reassert || readsDevice(cfg.program, device)) timers.schedule(cfg.device, now);
     }
 }
 
 void onDeviceControlResult(const char* deviceId, bool success, bool requestedState, bool actualState) {
-    DeviceModeConfig* cfg = findConfig(deviceId);
+    DeviceModeConfig* cfg = findConfig(Registry::find(deviceId));
     if (!cfg || cfg->mode != MODE_AUTO) return;
 
-    AutoState& state = autoStates[String(deviceId)];
+    Runtime& state = runtimes[cfg->device];
     if (!state.pending || state.pendingState != requestedState) return;
-
-    state.pending = false;
+    // Failures stay pending; the reconciler keeps retrying
     if (!success || actualState != requestedState) return;
 
+    state.pending = false;
     state.triggered = requestedState;
+    snapshotDirty = true;
     pushAutoEvent(*cfg, state, requestedState);
 }
 
@@ -429,21 +728,23 @@ bool setMode(JsonDocument& doc) {
 
     DeviceModeConfig cfg = {};
     parseConfig(doc.as<JsonObject>(), cfg);
+    resolveHandles(cfg);
+    if (cfg.mode == MODE_AUTO && cfg.rule.length() > 0 && cfg.program.count == 0) return false;
 
-    for (auto& existing : configs) {
-        if (strcmp(existing.deviceId, deviceId) == 0) {
-            existing = cfg;
-            autoStates.erase(String(deviceId));
-            cycleStates.erase(String(deviceId));
-            saveModes();
-            Serial.printf("[DeviceModes] Updated mode for %s: %s\n", deviceId, modeToString(cfg.mode));
-            return true;
-        }
+    DeviceModeConfig* existing = nullptr;
+    for (auto& other : configs) {
+        if (strcmp(other.deviceId, deviceId) == 0) existing = &other;
     }
+    if (existing) *existing = cfg;
+    else configs.push_back(cfg);
 
-    configs.push_back(cfg);
+    // An intent left by the old mode, or by a manual toggle, must not replay
+    indexDirty = true;
+    DeviceReconciler::clear(cfg.device);
+    resetRuntime(cfg.device);
     saveModes();
-    Serial.printf("[DeviceModes] Set mode for %s: %s\n", deviceId, modeToString(cfg.mode));
+    changes.mark(cfg.device);
+    Serial.printf("[DeviceModes] %s mode for %s: %s\n", existing ? "Updated" : "Set", deviceId, modeToString(cfg.mode));
     return true;
 }
 
@@ -451,9 +752,11 @@ bool removeMode(const char* deviceId) {
     for (auto it = configs.begin(); it != configs.end(); ++it) {
         if (strcmp(it->deviceId, deviceId) == 0) {
             Serial.printf("[DeviceModes] Removed mode for %s\n", deviceId);
-            autoStates.erase(String(deviceId));
-            cycleStates.erase(String(deviceId));
+            resetRuntime(it->device);
+            DeviceReconciler::clear(it->device);
+            changes.markRemoved(it->device, it->deviceId);
             configs.erase(it);
+            indexDirty = true;
             saveModes();
             return true;
         }
@@ -461,10 +764,48 @@ bool removeMode(const char* deviceId) {
     return false;
 }
 
-void getModesJson(String& out) {
-    JsonDocument doc;
-    serializeConfigs(doc);
-    serializeJson(doc, out);
+void shiftClockTimes(int minutes) {
+    if (minutes == 0) return;
+    for (auto& cfg : configs) {
+        bool shifted = false;
+        if (cfg.mode == MODE_SCHEDULE) {
+            shiftTime(cfg.schedule.startTime, sizeof(cfg.schedule.startTime), minutes);
+            shiftTime(cfg.schedule.endTime, sizeof(cfg.schedule.endTime), minutes);
+            shifted = true;
+        }
+        if (cfg.mode == MODE_AUTO && cfg.rule.length() > 0) {
+            JsonDocument rule;
+            if (!deserializeJson(rule, cfg.rule)) {
+                shiftWindows(rule.as<JsonVariant>(), minutes);
+                cfg.rule = "";
+                serializeJson(rule, cfg.rule);
+                shifted = true;
+            }
+        }
+        if (!shifted) continue;
+        compileProgram(cfg);
+        changes.mark(cfg.device);
+    }
+    indexDirty = true;
+    saveModes();
+    Serial.printf("[DeviceModes] Moved schedule times by %d min into the new zone\n", minutes);
+}
+
+void getModesJson(JsonVariant out) {
+    serializeConfigs(out.to<JsonArray>());
+}
+
+uint32_t getVersion() {
+    return changes.version;
+}
+
+bool takeChanges(JsonObject data) {
+    bool written = changes.writeDelta(data, [](JsonArray upsert, Registry::Handle device) {
+        const DeviceModeConfig* cfg = findConfig(device);
+        if (cfg) writeConfig(upsert.add<JsonObject>(), *cfg);
+    });
+    changes.clear();
+    return written;
 }
 
 const char* getDeviceMode(const char* deviceId) {
@@ -2,7 +2,8 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <map>
+#include "registry.h"
+#include "rule_engine.h"
 
 namespace DeviceModes {
 
@@ -43,16 +44,41 @@ struct DeviceModeConfig {
     uint8_t triggerCount;
     CycleConfig cycle;
     ScheduleConfig schedule;
+    String rule;                    // auto: RuleEngine expression replacing the triggers
+    RuleEngine::Program program;    // compiled from rule, triggers, cycle or schedule
+    Registry::Handle device;
 };
 
 void init();
-void loop(const std::map<String, float>& sensorReadings);
+
+// Runs the configs whose deadline has passed: cycle phases, schedule edges
+// and clock rules, each at the moment it changes. Call every main-loop pass;
+// a pass with nothing due costs a comparison.
+void loop(const Registry::Readings& sensorReadings);
+
+// Re-evaluates the auto configs with a trigger on `sensor`, right away
+void onSensorReading(Registry::Handle sensor, const Registry::Readings& sensorReadings);
+
+// A device reported another relay or online state: its on, off or schedule
+// mode is reasserted, and rules that read it run again
+void onDeviceState(Registry::Handle device);
 void onDeviceControlResult(const char* deviceId, bool success, bool requestedState, bool actualState);
 
 bool setMode(JsonDocument& doc);
 bool removeMode(const char* deviceId);
 
-void getModesJson(String& out);
+// Moves every schedule and rule time window by `minutes`. Times saved before
+// the device had a zone are UTC; shifted by the zone's offset, they keep the
+// wall-clock meaning they had in the browser that entered them.
+void shiftClockTimes(int minutes);
+
+void getModesJson(JsonVariant out);
+
+// Configs set or removed since the last takeChanges(), which writes
+// {"upsert", "remove"} and is false when the full list must be sent
+uint32_t getVersion();
+bool takeChanges(JsonObject data);
+
 const char* getDeviceMode(const char* deviceId);
 
 bool isDaytime();
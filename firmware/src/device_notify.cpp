@@ -0,0 +1,49 @@
+#include "device_notify.h"
+#include <freertos/FreeRTOS.h>
+
+namespace DeviceNotify {
+
+namespace {
+    Notification queue[QUEUE_SIZE];
+    volatile size_t queueHead = 0;
+    volatile size_t queueTail = 0;
+    portMUX_TYPE queueMux = portMUX_INITIALIZER_UNLOCKED;
+    Callback notifyCallback;
+}
+
+int8_t parseState(const char* value) {
+    if (!value) return -1;
+    if (strcmp(value, "1") == 0 || strcasecmp(value, "on") == 0 || strcasecmp(value, "true") == 0) return 1;
+    if (strcmp(value, "0") == 0 || strcasecmp(value, "off") == 0 || strcasecmp(value, "false") == 0) return 0;
+    return -1;
+}
+
+bool submit(const Notification& notification) {
+    portENTER_CRITICAL(&queueMux);
+    size_t next = (queueHead + 1) % QUEUE_SIZE;
+    if (next == queueTail) {
+        portEXIT_CRITICAL(&queueMux);
+        return false;
+    }
+    queue[queueHead] = notification;
+    queueHead = next;
+    portEXIT_CRITICAL(&queueMux);
+    return true;
+}
+
+void loop() {
+    while (queueTail != queueHead) {
+        portENTER_CRITICAL(&queueMux);
+        Notification notification = queue[queueTail];
+        queueTail = (queueTail + 1) % QUEUE_SIZE;
+        portEXIT_CRITICAL(&queueMux);
+
+        if (notifyCallback) notifyCallback(notification);
+    }
+}
+
+void onNotify(Callback cb) {
+    notifyCallback = cb;
+}
+
+}
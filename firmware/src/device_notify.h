@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+// State pushed by the plugs themselves: Shelly action URLs and webhooks or a
+// Tasmota rule call GET /api/device/notify when a relay flips or the power
+// crosses a threshold. The web server task submits reports; loop() hands
+// them to the main task.
+//
+//   /api/device/notify?on=1                  matched by the caller's IP
+//   /api/device/notify?channel=2&on=0        one relay of a multi-channel unit
+//   /api/device/notify?id=heater&power=812   matched by device id
+namespace DeviceNotify {
+
+constexpr size_t QUEUE_SIZE = 16;
+
+struct Notification {
+    char source[40];        // caller's IP address
+    char deviceId[24];      // "id" parameter; empty to match by source
+    uint8_t channel;        // "channel" parameter, for a source with several
+    int8_t on;              // -1 when not reported
+    float watts;            // NaN when not reported
+};
+
+using Callback = std::function<void(const Notification& notification)>;
+
+// "1"/"on"/"true" -> 1, "0"/"off"/"false" -> 0, anything else -1
+int8_t parseState(const char* value);
+
+// Queues a report; safe to call from the web server task. False when the
+// queue is full.
+bool submit(const Notification& notification);
+
+// Delivers queued reports to the callback on the calling task
+void loop();
+void onNotify(Callback cb);
+
+}
@@ -0,0 +1,115 @@
+#include "device_reconciler.h"
+#include "device_controller.h"
+#include "devices.h"
+
+namespace DeviceReconciler {
+
+namespace {
+    // Per attempt after a failure; the last step repeats while a device stays unreachable
+    constexpr unsigned long RETRY_BACKOFF_MS[] = {200, 500, 1000, 2000, 5000, 10000, 30000};
+    constexpr size_t RETRY_STEPS = sizeof(RETRY_BACKOFF_MS) / sizeof(RETRY_BACKOFF_MS[0]);
+
+    // Well past the controller's own timeouts: the result was dropped or
+    // never matched back to the device, so the attempt counts as failed. A
+    // control still waiting in the controller queue may answer after this;
+    // its sequence no longer matches the intent's, so it is ignored.
+    constexpr unsigned long STALE_CONTROL_MS =
+        DeviceController::CONNECT_TIMEOUT_MS + DeviceController::CONTROL_TIMEOUT_MS + 5000;
+
+    struct Intent {
+        bool active = false;
+        bool desired = false;
+        bool confirmed = false;     // a result reported `desired`
+        bool inFlight = false;
+        uint8_t failures = 0;
+        uint32_t sequence = 0;      // of the attempt in flight
+        unsigned long sentAt = 0;
+        unsigned long retryAt = 0;
+    };
+
+    Intent intents[Registry::MAX_HANDLES];
+    uint32_t lastSequence = 0;
+
+    void backOff(Intent& intent, Registry::Handle device, bool requestedState, const char* reason) {
+        unsigned long backoff = RETRY_BACKOFF_MS[min((size_t)intent.failures, RETRY_STEPS - 1)];
+        if (intent.failures < 255) intent.failures++;
+        intent.retryAt = millis() + backoff;
+        Devices::Device* d = Devices::getDevice(device);
+        Serial.printf("[Reconciler] %s -> %s %s, retry in %lums\n",
+            d ? d->id : "?", requestedState ? "ON" : "OFF", reason, backoff);
+    }
+}
+
+bool setDesired(Registry::Handle device, bool on, bool force) {
+    if (device >= Registry::MAX_HANDLES) return false;
+    Devices::Device* d = Devices::getDevice(device);
+    if (!d) return false;
+
+    Intent& intent = intents[device];
+    bool changed = !intent.active || intent.desired != on;
+    intent.active = true;
+    intent.desired = on;
+
+    if (changed || force) {
+        intent.confirmed = !force && !intent.inFlight && d->isOnline && d->isOn == on;
+        intent.failures = 0;
+        intent.retryAt = 0;
+    } else if (intent.confirmed && d->isOnline && d->isOn != on) {
+        // Switched outside our control since it was confirmed
+        intent.confirmed = false;
+    }
+    return !intent.confirmed;
+}
+
+void clear(Registry::Handle device) {
+    if (device < Registry::MAX_HANDLES) intents[device] = Intent{};
+}
+
+void loop() {
+    unsigned long now = millis();
+    for (size_t i = 0; i < Registry::MAX_HANDLES; i++) {
+        Intent& intent = intents[i];
+        if (!intent.active || intent.confirmed) continue;
+        if (intent.inFlight) {
+            if (now - intent.sentAt < STALE_CONTROL_MS) continue;
+            intent.inFlight = false;
+            backOff(intent, (Registry::Handle)i, intent.desired, "got no result");
+            continue;
+        }
+        if ((long)(now - intent.retryAt) < 0) continue;
+
+        Devices::Device* device = Devices::getDevice((Registry::Handle)i);
+        if (!device) {
+            intent = Intent{};
+            continue;
+        }
+        // A full control queue just delays the attempt; the intent stays
+        uint32_t sequence = lastSequence + 1;
+        if (sequence == 0) sequence = 1;    // 0 is an unsequenced control
+        if (!DeviceController::controlAsync(device->controlMethod, device->ipAddress, intent.desired,
+                device->channel, sequence)) return;
+        lastSequence = sequence;
+        intent.sequence = sequence;
+        intent.inFlight = true;
+        intent.sentAt = now;
+        Serial.printf("[Reconciler] %s -> %s\n", device->id, intent.desired ? "ON" : "OFF");
+    }
+}
+
+void onControlResult(Registry::Handle device, uint32_t sequence, bool success, bool requestedState, bool actualState) {
+    if (device >= Registry::MAX_HANDLES) return;
+    Intent& intent = intents[device];
+    if (!intent.active || !intent.inFlight || sequence != intent.sequence) return;
+    intent.inFlight = false;
+
+    if (success && actualState == requestedState) {
+        intent.failures = 0;
+        // Otherwise superseded while in flight; the newer intent goes out next loop()
+        if (intent.desired == requestedState) intent.confirmed = true;
+        return;
+    }
+
+    backOff(intent, device, requestedState, "failed");
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include "registry.h"
+
+// Desired relay state per device. Callers record what a device should be;
+// loop() sends at most one control per device at a time and repeats it with
+// per-device backoff until a result confirms that state. A new intent
+// replaces the old one instead of queueing behind it, so a burst of clicks
+// or a flapping trigger costs one request per device in flight.
+namespace DeviceReconciler {
+
+// Returns false when nothing has to be sent: the intent is unchanged and
+// already confirmed, or (unless `force`) the device reports that state.
+bool setDesired(Registry::Handle device, bool on, bool force = false);
+
+// Drops the intent, e.g. when the device or its mode is removed
+void clear(Registry::Handle device);
+
+void loop();
+// `sequence` is the result's AsyncResult::sequence; a result for an attempt
+// that was already given up on is ignored
+void onControlResult(Registry::Handle device, uint32_t sequence, bool success, bool requestedState, bool actualState);
+
+}
@@ -2,6 +2,10 @@
 #include "storage.h"
 #include "device_modes.h"
 #include "history.h"
+#include "device_controller.h"
+#include "energy_tracker.h"
+#include "change_set.h"
+#include <algorithm>
 #include <vector>
 
 namespace Devices {
@@ -9,7 +13,73 @@ namespace Devices {
 namespace {
     const char* DEVICES_PATH = "/devices.json";
     std::vector<Device> devices;
+    int16_t indexByHandle[Registry::MAX_HANDLES];
+    ChangeSet changes;
+
+    bool sameUnit(const Device& a, const Device& b) {
+        return a.targetHash == b.targetHash && strcmp(a.ipAddress, b.ipAddress) == 0 &&
+            strcmp(a.controlMethod, b.controlMethod) == 0;
+    }
+
+    void groupUnits() {
+        for (auto& device : devices) {
+            const Device* first = &device;
+            uint8_t channels = device.channel + 1;
+            for (const auto& other : devices) {
+                if (!sameUnit(device, other)) continue;
+                if (other.channel < first->channel || (other.channel == first->channel && &other < first)) {
+                    first = &other;
+                }
+                channels = max(channels, (uint8_t)(other.channel + 1));
+            }
+            device.unitHandle = first->handle;
+            device.unitChannels = first == &device ? channels : 0;
+        }
+    }
+
+    uint8_t channelFrom(JsonVariantConst value) {
+        uint8_t channel = value | 0;
+        return channel < DeviceController::MAX_CHANNELS ? channel : 0;
+    }
+
+    void rebuildIndex() {
+        memset(indexByHandle, -1, sizeof(indexByHandle));
+        for (size_t i = 0; i < devices.size(); i++) {
+            Device& device = devices[i];
+            device.handle = Registry::intern(device.id);
+            device.targetHash = Registry::hash(device.ipAddress);
+            if (device.handle != Registry::INVALID_HANDLE && indexByHandle[device.handle] < 0) {
+                indexByHandle[device.handle] = (int16_t)i;
+            }
+        }
+        groupUnits();
+    }
     
+    // Ids a reload dropped (e.g. a restore) give back their handles and
+    // history; the caller clears its own per-handle state first
+    void releaseDropped(const std::vector<Device>& previous, void (*onDropped)(Registry::Handle)) {
+        for (const auto& old : previous) {
+            if (old.handle == Registry::INVALID_HANDLE) continue;
+            bool kept = false;
+            for (const auto& device : devices) {
+                if (strcmp(device.id, old.id) == 0) kept = true;
+            }
+            if (kept) continue;
+            if (onDropped) onDropped(old.handle);
+            History::removeSensor(old.id);
+            Registry::release(old.handle);
+        }
+    }
+
+    // A device without a handle would be listed but never polled or controlled
+    void dropUnhandled() {
+        devices.erase(std::remove_if(devices.begin(), devices.end(), [](const Device& device) {
+            if (Registry::intern(device.id) != Registry::INVALID_HANDLE) return false;
+            Serial.printf("[Devices] No handle for %s, skipped\n", device.id);
+            return true;
+        }), devices.end());
+    }
+
     void saveDevices() {
         JsonDocument doc;
         JsonArray arr = doc.to<JsonArray>();
@@ -22,17 +92,20 @@ namespace {
             obj["controlMethod"] = device.controlMethod;
             obj["ipAddress"] = device.ipAddress;
             obj["hasEnergyMonitoring"] = device.hasEnergyMonitoring;
+            obj["channel"] = device.channel;
         }
         
         Storage::writeJson(DEVICES_PATH, doc);
         Serial.printf("[Devices] Saved %d devices\n", devices.size());
     }
     
-    void loadDevices() {
-        devices.clear(); // Clear existing data before reloading
+    void loadDevices(void (*onDropped)(Registry::Handle)) {
+        std::vector<Device> previous;
+        previous.swap(devices);
         JsonDocument doc;
         if (!Storage::readJson(DEVICES_PATH, doc)) {
             Serial.println("[Devices] No devices file found");
+            releaseDropped(previous, onDropped);
             return;
         }
         
@@ -46,16 +119,33 @@ namespace {
             strlcpy(device.ipAddress, obj["ipAddress"] | "", sizeof(device.ipAddress));
             strlcpy(device.controlMode, "manual", sizeof(device.controlMode));
             device.hasEnergyMonitoring = obj["hasEnergyMonitoring"] | false;
+            device.channel = channelFrom(obj["channel"]);
             
             devices.push_back(device);
         }
         
+        releaseDropped(previous, onDropped);
+        dropUnhandled();
+        rebuildIndex();
         Serial.printf("[Devices] Loaded %d devices\n", devices.size());
     }
+
+    void writeDeviceJson(JsonObject obj, const Device& device) {
+        obj["id"] = device.id;
+        obj["name"] = device.name;
+        obj["type"] = device.type;
+        obj["controlMethod"] = device.controlMethod;
+        obj["ipAddress"] = device.ipAddress;
+        obj["controlMode"] = device.controlMode;
+        obj["isOn"] = device.isOn;
+        obj["isOnline"] = device.isOnline;
+        obj["hasEnergyMonitoring"] = device.hasEnergyMonitoring;
+        obj["channel"] = device.channel;
+    }
 }
 
-void init() {
-    loadDevices();
+void init(void (*onDropped)(Registry::Handle)) {
+    loadDevices(onDropped);
     Serial.println("[Devices] Initialized");
 }
 
@@ -68,9 +158,18 @@ bool addDevice(JsonDocument& doc) {
     strlcpy(device.ipAddress, doc["ipAddress"] | "", sizeof(device.ipAddress));
     strlcpy(device.controlMode, "manual", sizeof(device.controlMode));
     device.hasEnergyMonitoring = doc["hasEnergyMonitoring"] | false;
+    device.channel = channelFrom(doc["channel"]);
+
+    if (Registry::intern(device.id) == Registry::INVALID_HANDLE) {
+        Serial.printf("[Devices] No handle for %s, not added\n", device.id);
+        return false;
+    }
     
     devices.push_back(device);
+    rebuildIndex();
     saveDevices();
+    changes.mark(devices.back().handle);
+    EnergyTracker::onDeviceChanged(devices.back().handle);
     
     Serial.printf("[Devices] Added device: %s\n", device.name);
     return true;
@@ -84,8 +183,12 @@ bool updateDevice(const char* deviceId, JsonDocument& doc) {
             if (doc["controlMethod"].is<const char*>()) strlcpy(device.controlMethod, doc["controlMethod"], sizeof(device.controlMethod));
             if (doc["ipAddress"].is<const char*>()) strlcpy(device.ipAddress, doc["ipAddress"], sizeof(device.ipAddress));
             if (doc["hasEnergyMonitoring"].is<bool>()) device.hasEnergyMonitoring = doc["hasEnergyMonitoring"];
+            if (doc["channel"].is<int>()) device.channel = channelFrom(doc["channel"]);
             
+            rebuildIndex();
             saveDevices();
+            changes.mark(device.handle);
+            EnergyTracker::onDeviceChanged(device.handle);
             Serial.printf("[Devices] Updated device: %s\n", device.name);
             return true;
         }
@@ -97,7 +200,12 @@ bool removeDevice(const char* deviceId) {
     for (auto it = devices.begin(); it != devices.end(); ++it) {
         if (strcmp(it->id, deviceId) == 0) {
             Serial.printf("[Devices] Removed device: %s\n", it->name);
+            History::removeSensor(deviceId);
+            changes.markRemoved(it->handle, it->id);
+            EnergyTracker::onDeviceRemoved(it->handle, it->id);
+            Registry::release(it->handle);
             devices.erase(it);
+            rebuildIndex();
             saveDevices();
             return true;
         }
@@ -105,33 +213,33 @@ bool removeDevice(const char* deviceId) {
     return false;
 }
 
-void getDevicesJson(String& out) {
-    JsonDocument doc;
-    JsonArray arr = doc.to<JsonArray>();
-    
+void getDevicesJson(JsonVariant out) {
+    JsonArray arr = out.to<JsonArray>();
     for (const auto& device : devices) {
-        JsonObject obj = arr.add<JsonObject>();
-        obj["id"] = device.id;
-        obj["name"] = device.name;
-        obj["type"] = device.type;
-        obj["controlMethod"] = device.controlMethod;
-        obj["ipAddress"] = device.ipAddress;
-        obj["controlMode"] = device.controlMode;
-        obj["isOn"] = device.isOn;
-        obj["isOnline"] = device.isOnline;
-        obj["hasEnergyMonitoring"] = device.hasEnergyMonitoring;
+        writeDeviceJson(arr.add<JsonObject>(), device);
     }
-    
-    serializeJson(doc, out);
+}
+
+uint32_t getVersion() {
+    return changes.version;
+}
+
+bool takeChanges(JsonObject data) {
+    bool written = changes.writeDelta(data, [](JsonArray upsert, Registry::Handle handle) {
+        const Device* device = getDevice(handle);
+        if (device) writeDeviceJson(upsert.add<JsonObject>(), *device);
+    });
+    changes.clear();
+    return written;
 }
 
 Device* getDevice(const char* deviceId) {
-    for (auto& device : devices) {
-        if (strcmp(device.id, deviceId) == 0) {
-            return &device;
-        }
-    }
-    return nullptr;
+    return getDevice(Registry::find(deviceId));
+}
+
+Device* getDevice(Registry::Handle handle) {
+    if (handle >= Registry::MAX_HANDLES || indexByHandle[handle] < 0) return nullptr;
+    return &devices[indexByHandle[handle]];
 }
 
 Device* getDeviceByIndex(size_t index) {
@@ -144,38 +252,36 @@ size_t getDeviceCount() {
 }
 
 bool setDeviceState(const char* deviceId, bool on) {
-    for (auto& device : devices) {
-        if (strcmp(device.id, deviceId) == 0) {
-            device.isOn = on;
-            History::record(deviceId, on ? 1.0f : 0.0f, History::LAST_VALUE);
-            return true;
-        }
-    }
-    return false;
+    Device* device = getDevice(deviceId);
+    if (!device) return false;
+    device->isOn = on;
+    History::record(device->handle, on ? 1.0f : 0.0f, History::LAST_VALUE);
+    return true;
 }
 
 bool setDeviceOnline(const char* deviceId, bool online) {
-    for (auto& device : devices) {
-        if (strcmp(device.id, deviceId) == 0) {
-            device.isOnline = online;
-            return true;
-        }
-    }
-    return false;
+    Device* device = getDevice(deviceId);
+    if (!device) return false;
+    device->isOnline = online;
+    return true;
 }
 
-Device* findDeviceByTarget(const char* method, const char* target) {
+Device* findDeviceByTarget(const char* method, const char* target, uint8_t channel) {
+    uint32_t h = Registry::hash(target);
     for (auto& device : devices) {
-        if (strcmp(device.controlMethod, method) == 0) {
-            if (strcmp(device.ipAddress, target) == 0) return &device;
-        }
+        if (device.targetHash != h || device.channel != channel) continue;
+        if (strcmp(device.ipAddress, target) != 0) continue;
+        if (!method || strcmp(device.controlMethod, method) == 0) return &device;
     }
     return nullptr;
 }
 
 void computeControlModes() {
     for (auto& device : devices) {
-        strlcpy(device.controlMode, DeviceModes::getDeviceMode(device.id), sizeof(device.controlMode));
+        const char* mode = DeviceModes::getDeviceMode(device.id);
+        if (strcmp(device.controlMode, mode) == 0) continue;
+        strlcpy(device.controlMode, mode, sizeof(device.controlMode));
+        changes.mark(device.handle);
     }
 }
 
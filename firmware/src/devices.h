@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "registry.h"
 
 namespace Devices {
 
@@ -15,22 +16,40 @@ struct Device {
     bool isOn = false;
     bool isOnline = false;
     bool hasEnergyMonitoring = false;
+    uint8_t channel = 0;        // relay on a multi-channel unit
+    Registry::Handle handle = Registry::INVALID_HANDLE;
+    uint32_t targetHash = 0;    // Registry::hash(ipAddress), for result lookup
+    // Devices with the same address and method are channels of one unit,
+    // queried in one request by the device with the lowest channel
+    Registry::Handle unitHandle = Registry::INVALID_HANDLE;
+    uint8_t unitChannels = 0;   // channels that device queries; 0 on the others
 };
 
-void init();
+// Also reloads after a restore: `onDropped` sees each handle whose id is
+// gone, before the handle is released for reuse
+void init(void (*onDropped)(Registry::Handle handle) = nullptr);
 
 bool addDevice(JsonDocument& doc);
 bool updateDevice(const char* deviceId, JsonDocument& doc);
 bool removeDevice(const char* deviceId);
 
-void getDevicesJson(String& out);
+void getDevicesJson(JsonVariant out);
+
+// Configuration and control-mode changes since the last takeChanges(); relay
+// and online state travel in "device_status" instead. takeChanges() writes
+// {"upsert", "remove"} and is false when the full list must be sent.
+uint32_t getVersion();
+bool takeChanges(JsonObject data);
+
 Device* getDevice(const char* deviceId);
+Device* getDevice(Registry::Handle handle);
 Device* getDeviceByIndex(size_t index);
 size_t getDeviceCount();
 
 bool setDeviceState(const char* deviceId, bool on);
 bool setDeviceOnline(const char* deviceId, bool online);
-Device* findDeviceByTarget(const char* method, const char* target);
+// nullptr `method` matches any, e.g. for a push identified only by its IP
+Device* findDeviceByTarget(const char* method, const char* target, uint8_t channel = 0);
 void computeControlModes();
 
 }
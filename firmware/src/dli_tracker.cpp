@@ -15,11 +15,26 @@ namespace {
 
     double dliAccumulated = 0.0;
     unsigned long lastAccumulateTime = 0;
+    uint32_t lastRound = 0;
+    unsigned long lastRoundAt = 0;
     unsigned long lastPersistTime = 0;
     bool wasDaytime = false;
     bool dirty = false;
     uint8_t lastDay = 0;
-    String lastBroadcastJson;
+
+    // What the last "dli" message showed; version moves when either changes
+    float shownDli = 0.0f;
+    bool shownIsDay = false;
+    uint32_t version = 0;
+
+    void publish() {
+        float dli = (float)(round(dliAccumulated * 10.0) / 10.0);
+        bool isDay = DeviceModes::isDaytime();
+        if (dli == shownDli && isDay == shownIsDay) return;
+        shownDli = dli;
+        shownIsDay = isDay;
+        version++;
+    }
 
     uint8_t getCurrentDay() {
         time_t now = time(nullptr);
@@ -28,14 +43,23 @@ namespace {
         return t.tm_mday;
     }
 
-    const char* findLightSensorId() {
-        size_t count;
-        const char** ids = SensorConfig::getSensorIds(count);
+    uint32_t lightSensorRevision = 0;
+    Registry::Handle lightSensor = Registry::INVALID_HANDLE;
+
+    Registry::Handle findLightSensor() {
+        if (lightSensorRevision == SensorConfig::getRevision()) return lightSensor;
+        lightSensorRevision = SensorConfig::getRevision();
+        lightSensor = Registry::INVALID_HANDLE;
+
+        size_t count = SensorConfig::getSensorCount();
         for (size_t i = 0; i < count; i++) {
-            SensorConfig::Sensor* s = SensorConfig::getSensor(ids[i]);
-            if (s && strcmp(s->type, "light") == 0) return ids[i];
+            SensorConfig::Sensor* s = SensorConfig::getSensorByIndex(i);
+            if (strcmp(s->type, "light") == 0) {
+                lightSensor = s->handle;
+                break;
+            }
         }
-        return nullptr;
+        return lightSensor;
     }
 
     void saveDli() {
@@ -70,6 +94,7 @@ namespace {
 void init() {
     loadDli();
     wasDaytime = DeviceModes::isDaytime();
+    publish();
     Serial.println("[DLI] Initialized");
 }
 
@@ -77,7 +102,6 @@ void loop() {
     unsigned long now = millis();
 
     if (now - lastAccumulateTime >= ACCUMULATE_INTERVAL) {
-        unsigned long elapsed = lastAccumulateTime > 0 ? (now - lastAccumulateTime) : 0;
         lastAccumulateTime = now;
 
         bool isDay = DeviceModes::isDaytime();
@@ -89,18 +113,27 @@ void loop() {
             dirty = true;
         }
         wasDaytime = isDay;
+        publish();
+
+        // Integrate between acquisition rounds using their own timestamps
+        Sensors::Snapshot snapshot;
+        if (!Sensors::readSnapshot(snapshot) || snapshot.round == lastRound) return;
+        unsigned long elapsed = lastRound > 0 ? (snapshot.takenAt - lastRoundAt) : 0;
+        lastRound = snapshot.round;
+        lastRoundAt = snapshot.takenAt;
 
         if (!isDay || elapsed == 0) return;
 
-        const char* lightId = findLightSensorId();
-        if (!lightId) return;
+        Registry::Handle light = findLightSensor();
+        if (light == Registry::INVALID_HANDLE) return;
 
-        float ppfd = Sensors::getSensorValue(lightId);
+        float ppfd = Sensors::getSensorValue(snapshot, light);
         if (isnan(ppfd) || ppfd < 0) return;
 
         double intervalSec = (double)elapsed / 1000.0;
         dliAccumulated += (ppfd * intervalSec) / 1000000.0;
         dirty = true;
+        publish();
     }
 
     if (now - lastPersistTime >= PERSIST_INTERVAL) {
@@ -112,12 +145,9 @@ void loop() {
     }
 }
 
-void getDliJson(String& out) {
-    JsonDocument doc;
-    doc["dli"] = (float)(round(dliAccumulated * 10.0) / 10.0);
-    doc["isDay"] = DeviceModes::isDaytime();
-
-    serializeJson(doc, out);
+void getDliJson(JsonVariant out) {
+    out["dli"] = shownDli;
+    out["isDay"] = shownIsDay;
 }
 
 void resetDli() {
@@ -125,15 +155,12 @@ void resetDli() {
     dirty = true;
     saveDli();
     dirty = false;
+    publish();
     Serial.println("[DLI] Reset");
 }
 
-bool hasChanged() {
-    String current;
-    getDliJson(current);
-    if (current == lastBroadcastJson) return false;
-    lastBroadcastJson = current;
-    return true;
+uint32_t getVersion() {
+    return version;
 }
 
 }
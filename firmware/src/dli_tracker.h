@@ -1,14 +1,17 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 
 namespace DliTracker {
 
 void init();
 void loop();
 
-void getDliJson(String& out);
+void getDliJson(JsonVariant out);
 void resetDli();
-bool hasChanged();
+
+// Moves when the broadcast value (0.1 mol resolution) or day flag changes
+uint32_t getVersion();
 
 }
@@ -1,6 +1,7 @@
 #include "energy_tracker.h"
 #include "devices.h"
 #include "storage.h"
+#include "change_set.h"
 #include <ArduinoJson.h>
 #include <vector>
 #include <time.h>
@@ -21,7 +22,7 @@ namespace {
 
     std::vector<DeviceEnergy> energies;
     unsigned long lastPersistTime = 0;
-    String lastBroadcastJson;
+    ChangeSet changes;       // by device handle
 
     DeviceEnergy* findEnergy(const char* deviceId) {
         for (auto& e : energies) {
@@ -75,6 +76,15 @@ namespace {
 
         Serial.printf("[Energy] Loaded %d entries\n", energies.size());
     }
+
+    void writeEnergyJson(JsonObject obj, const Devices::Device& device) {
+        DeviceEnergy* entry = findEnergy(device.id);
+        obj["deviceId"] = device.id;
+        obj["deviceName"] = device.name;
+        obj["watts"] = entry ? entry->watts : 0.0f;
+        obj["kWh"] = entry ? (float)entry->kWh : 0.0f;
+        obj["resetTimestamp"] = entry ? entry->resetTimestamp : (uint32_t)time(nullptr);
+    }
 }
 
 void init() {
@@ -96,6 +106,8 @@ void loop() {
 void updateWatts(const char* deviceId, float watts) {
     DeviceEnergy& entry = getOrCreateEnergy(deviceId);
     unsigned long now = millis();
+    float shownWatts = entry.watts;
+    float shownKWh = (float)entry.kWh;
 
     if (entry.lastUpdateTime > 0 && !isnan(entry.watts) && entry.watts > 0) {
         unsigned long elapsed = now - entry.lastUpdateTime;
@@ -104,28 +116,21 @@ void updateWatts(const char* deviceId, float watts) {
 
     entry.watts = isnan(watts) ? 0.0f : watts;
     entry.lastUpdateTime = now;
+    // Compared as broadcast, so sub-float kWh growth is not a change
+    if (entry.watts != shownWatts || (float)entry.kWh != shownKWh) {
+        changes.mark(Registry::find(deviceId));
+    }
 }
 
-void getEnergiesJson(String& out) {
-    JsonDocument doc;
-    JsonArray arr = doc.to<JsonArray>();
+void getEnergiesJson(JsonVariant out) {
+    JsonArray arr = out.to<JsonArray>();
 
     size_t count = Devices::getDeviceCount();
     for (size_t i = 0; i < count; i++) {
         Devices::Device* device = Devices::getDeviceByIndex(i);
         if (!device || !device->hasEnergyMonitoring) continue;
-
-        DeviceEnergy* entry = findEnergy(device->id);
-        
-        JsonObject obj = arr.add<JsonObject>();
-        obj["deviceId"] = device->id;
-        obj["deviceName"] = device->name;
-        obj["watts"] = entry ? entry->watts : 0.0f;
-        obj["kWh"] = entry ? (float)entry->kWh : 0.0f;
-        obj["resetTimestamp"] = entry ? entry->resetTimestamp : (uint32_t)time(nullptr);
+        writeEnergyJson(arr.add<JsonObject>(), *device);
     }
-
-    serializeJson(doc, out);
 }
 
 void resetEnergy(const char* deviceId) {
@@ -133,6 +138,7 @@ void resetEnergy(const char* deviceId) {
     if (entry) {
         entry->kWh = 0.0;
         entry->resetTimestamp = (uint32_t)time(nullptr);
+        changes.mark(Registry::find(deviceId));
         Serial.printf("[Energy] Reset energy for device: %s\n", deviceId);
         saveEnergies();
     }
@@ -143,16 +149,33 @@ void resetAllEnergy() {
         e.kWh = 0.0;
         e.resetTimestamp = (uint32_t)time(nullptr);
     }
+    changes.markAll();
     Serial.println("[Energy] Reset all energy counters");
     saveEnergies();
 }
 
-bool hasChanged() {
-    String current;
-    getEnergiesJson(current);
-    if (current == lastBroadcastJson) return false;
-    lastBroadcastJson = current;
-    return true;
+void onDeviceChanged(Registry::Handle handle) {
+    const Devices::Device* device = Devices::getDevice(handle);
+    if (!device) return;
+    if (device->hasEnergyMonitoring) changes.mark(handle);
+    else changes.markRemoved(handle, device->id);
+}
+
+void onDeviceRemoved(Registry::Handle handle, const char* deviceId) {
+    changes.markRemoved(handle, deviceId);
+}
+
+uint32_t getVersion() {
+    return changes.version;
+}
+
+bool takeChanges(JsonObject data) {
+    bool written = changes.writeDelta(data, [](JsonArray upsert, Registry::Handle handle) {
+        const Devices::Device* device = Devices::getDevice(handle);
+        if (device && device->hasEnergyMonitoring) writeEnergyJson(upsert.add<JsonObject>(), *device);
+    });
+    changes.clear();
+    return written;
 }
 
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "registry.h"
 
 namespace EnergyTracker {
 
@@ -8,9 +10,17 @@ void init();
 void loop();
 
 void updateWatts(const char* deviceId, float watts);
-void getEnergiesJson(String& out);
+void getEnergiesJson(JsonVariant out);
 void resetEnergy(const char* deviceId);
 void resetAllEnergy();
-bool hasChanged();
+
+// Devices keeps the energy list's names and membership in step through these
+void onDeviceChanged(Registry::Handle handle);
+void onDeviceRemoved(Registry::Handle handle, const char* deviceId);
+
+// Entries whose broadcast values changed since the last takeChanges(), which
+// writes {"upsert", "remove"} and is false when the full list must be sent
+uint32_t getVersion();
+bool takeChanges(JsonObject data);
 
 }
@@ -26,13 +26,8 @@ namespace {
     unsigned long lastEval = 0;
     bool dirty = false;
 
-    struct AlertCooldown {
-        char sensorId[24];
-        unsigned long lastAlert;
-    };
-    static constexpr size_t MAX_COOLDOWNS = 16;
-    AlertCooldown cooldowns[MAX_COOLDOWNS];
-    size_t cooldownCount = 0;
+    // Last alert time per sensor handle, 0 = never alerted
+    unsigned long lastAlert[Registry::MAX_HANDLES] = {};
 
     struct AlertMargin {
         const char* sensorType;
@@ -62,28 +57,13 @@ namespace {
         return NAN;
     }
 
-    bool isOnCooldown(const char* sensorId) {
-        unsigned long now = millis();
-        for (size_t i = 0; i < cooldownCount; i++) {
-            if (strcmp(cooldowns[i].sensorId, sensorId) == 0) {
-                return (now - cooldowns[i].lastAlert) < ALERT_COOLDOWN;
-            }
-        }
-        return false;
+    bool isOnCooldown(Registry::Handle sensor) {
+        if (sensor >= Registry::MAX_HANDLES || lastAlert[sensor] == 0) return false;
+        return (millis() - lastAlert[sensor]) < ALERT_COOLDOWN;
     }
 
-    void setCooldown(const char* sensorId) {
-        for (size_t i = 0; i < cooldownCount; i++) {
-            if (strcmp(cooldowns[i].sensorId, sensorId) == 0) {
-                cooldowns[i].lastAlert = millis();
-                return;
-            }
-        }
-        if (cooldownCount < MAX_COOLDOWNS) {
-            strlcpy(cooldowns[cooldownCount].sensorId, sensorId, sizeof(cooldowns[0].sensorId));
-            cooldowns[cooldownCount].lastAlert = millis();
-            cooldownCount++;
-        }
+    void setCooldown(Registry::Handle sensor) {
+        if (sensor < Registry::MAX_HANDLES) lastAlert[sensor] = millis();
     }
 
     void addEvent(const Event& event) {
@@ -104,9 +84,7 @@ namespace {
         data["severity"] = event.severity;
         data["timestamp"] = event.timestamp;
 
-        String out;
-        serializeJson(doc, out);
-        WebSocketServer::broadcast(out);
+        WebSocketServer::broadcast(doc);
     }
 
     void serializeEvents(JsonArray arr) {
@@ -154,13 +132,13 @@ namespace {
         Serial.printf("[EventLog] Loaded %d events\n", eventCount);
     }
 
-    void evaluateAlerts(const std::map<String, float>& sensorReadings) {
+    void evaluateAlerts(const Registry::Readings& sensorReadings) {
         const ClimateConfig::PhaseTargets& targets = ClimateConfig::getTargets();
         bool daytime = DeviceModes::isDaytime();
 
-        for (const auto& pair : sensorReadings) {
-            SensorConfig::Sensor* cfg = SensorConfig::getSensor(pair.first.c_str());
-            if (!cfg) continue;
+        size_t sensorCount = SensorConfig::getSensorCount();
+        for (size_t i = 0; i < sensorCount; i++) {
+            SensorConfig::Sensor* cfg = SensorConfig::getSensorByIndex(i);
 
             float margin = getMargin(cfg->type);
             if (margin == 0.0f) continue;
@@ -168,14 +146,14 @@ namespace {
             float target = getTarget(cfg->type, daytime, targets);
             if (std::isnan(target)) continue;
 
-            float value = pair.second;
+            float value = sensorReadings.get(cfg->handle);
             if (std::isnan(value)) continue;
 
             float min = target - margin * 2;
             float max = target + margin * 2;
 
             if (value >= min && value <= max) continue;
-            if (isOnCooldown(cfg->id)) continue;
+            if (isOnCooldown(cfg->handle)) continue;
 
             const char* severity = (value < target - margin * 3 || value > target + margin * 3)
                 ? "critical" : "warning";
@@ -200,7 +178,7 @@ namespace {
             }
 
             pushEvent("alert", title, desc, severity);
-            setCooldown(cfg->id);
+            setCooldown(cfg->handle);
         }
     }
 }
@@ -227,7 +205,7 @@ void init() {
     Serial.println("[EventLog] Initialized");
 }
 
-void loop(const std::map<String, float>& sensorReadings) {
+void loop(const Registry::Readings& sensorReadings) {
     unsigned long now = millis();
 
     if (now - lastEval >= EVAL_INTERVAL) {
@@ -269,10 +247,8 @@ void flush() {
     }
 }
 
-void getEventsJson(String& out) {
-    JsonDocument doc;
-    serializeEvents(doc.to<JsonArray>());
-    serializeJson(doc, out);
+void getEventsJson(JsonVariant out) {
+    serializeEvents(out.to<JsonArray>());
 }
 
 void clearEvents() {
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <Arduino.h>
-#include <map>
+#include <ArduinoJson.h>
+#include "registry.h"
 
 namespace EventLog {
 
@@ -17,12 +18,12 @@ struct Event {
 static constexpr size_t MAX_EVENTS = 50;
 
 void init();
-void loop(const std::map<String, float>& sensorReadings);
+void loop(const Registry::Readings& sensorReadings);
 
 void pushEvent(const char* type, const char* title, const char* description,
                const char* severity = "info");
 
-void getEventsJson(String& out);
+void getEventsJson(JsonVariant out);
 
 void clearEvents();
 
@@ -1,9 +1,10 @@
 #include "history.h"
 #include "sensor_config.h"
+#include "devices.h"
 #include "wifi_manager.h"
 #include <LittleFS.h>
-#include <map>
-#include <string>
+#include <algorithm>
+#include <vector>
 #include <time.h>
 
 namespace History {
@@ -11,32 +12,79 @@ namespace History {
 namespace {
     constexpr uint32_t MIN_VALID_EPOCH = 1600000000;
 
-    struct CircularBuffer {
-        HistoryPoint* points;
-        size_t capacity;
-        uint32_t head;
-        uint32_t count;
-        uint32_t interval;
-        uint32_t lastWrite;
-    };
-    
+    constexpr int16_t EMPTY_SLOT = INT16_MIN;
+    constexpr size_t TOTAL_POINTS = POINTS_6H + POINTS_24H + POINTS_7D;
+
     struct SensorAccumulator {
         float sum;
         float lastValue;
         uint32_t sampleCount;
-        uint32_t lastSample;
+        uint32_t lastBoundary;
         RecordMode mode;
     };
     
+    // Columnar store: every series in a tier shares one time axis, so a slot's
+    // timestamp is implied by its index and only values are kept per series.
+    // Values are int16 fixed point when the series type has a known scale,
+    // floats otherwise. Empty slots hold EMPTY_SLOT / NaN.
     struct SensorHistory {
-        CircularBuffer buffers[3];
+        void* columns[3];               // int16_t[capacity] or float[capacity]
+        float scale;                    // 0 = float column
         SensorAccumulator accumulators[3];
-        bool initialized;
     };
     
-    std::map<std::string, SensorHistory> histories;
+    SensorHistory* histories[Registry::MAX_HANDLES] = {};
+    size_t seriesCount = 0;
+    uint32_t scaleRevision = 0;     // SensorConfig revision the scales match
     
     const char* HISTORY_DIR = "/history";
+    const char* RANGE_NAMES[] = {"6h", "24h", "7d"};
+
+    // Append-only history log. Each tier has its own sequence of segment files
+    // (/history/<range>-<seq>.log). A segment is a list of framed records:
+    //   [type:1][len:1][payload:len][crc8:1]
+    // 'S' declares a series tag for the rest of the segment (tag:1, id),
+    // 'P' is a batch of points sharing one boundary (ts:4, n x (tag:1, value:4)),
+    // 'D' drops every earlier point of a series (id).
+    // Only new points are appended. A tier's points are written in time order,
+    // so a whole segment can be deleted once it falls out of the tier's window.
+    // Boot replays the segments in order; a torn or corrupt record ends that
+    // segment and appends continue in a fresh one.
+    constexpr uint8_t REC_SERIES = 'S';
+    constexpr uint8_t REC_POINTS = 'P';
+    constexpr uint8_t REC_DROP = 'D';
+    constexpr size_t REC_MAX_PAYLOAD = 255;
+    constexpr size_t POINT_ENTRY_SIZE = 5;
+    constexpr size_t MAX_POINTS_PER_BATCH = (REC_MAX_PAYLOAD - 4) / POINT_ENTRY_SIZE;
+    constexpr size_t MAX_SEGMENT_BYTES = 8192;
+    constexpr size_t MAX_SEGMENT_TAGS = 255;
+    constexpr uint32_t SEGMENTS_PER_WINDOW = 4;
+
+    struct Segment {
+        uint32_t seq;
+        uint32_t firstTs;
+        uint32_t lastTs;
+        size_t bytes;
+    };
+
+    struct PendingPoint {
+        Registry::Handle series;
+        uint32_t timestamp;
+        float value;
+    };
+
+    struct TierLog {
+        std::vector<Segment> segments;
+        std::vector<Registry::Handle> tags;  // series declared in the active segment
+        std::vector<PendingPoint> pending;
+        bool activeWritable;             // false after a torn segment or at boot
+        uint32_t nextSeq;
+    };
+
+    TierLog logs[3];
+
+    // Boundary timestamp of the newest slot in each tier (0 = empty tier)
+    uint32_t tierNewest[3] = {0, 0, 0};
     
     size_t getCapacity(Range range) {
         switch (range) {
@@ -55,103 +103,536 @@ namespace {
             default: return 0;
         }
     }
-    
-    String getFilePath(const char* sensorId, Range range) {
-        const char* suffix[] = {"6h", "24h", "7d"};
-        return String(HISTORY_DIR) + "/" + sensorId + "_" + suffix[range] + ".bin";
+
+    uint32_t getWindow(Range range) {
+        return getCapacity(range) * getInterval(range);
     }
     
-    void saveBuffer(const char* sensorId, Range range, CircularBuffer& buf) {
-        String path = getFilePath(sensorId, range);
-        File file = LittleFS.open(path, "w");
-        if (!file) return;
-        
-        uint8_t header[12];
-        memcpy(header, &buf.head, 4);
-        memcpy(header + 4, &buf.count, 4);
-        memcpy(header + 8, &buf.lastWrite, 4);
-        file.write(header, 12);
-        
-        file.write((uint8_t*)buf.points, buf.capacity * sizeof(HistoryPoint));
-        file.close();
+    String getSegmentPath(Range range, uint32_t seq) {
+        return String(HISTORY_DIR) + "/" + RANGE_NAMES[range] + "-" + String(seq) + ".log";
     }
-    
-    bool loadBuffer(const char* sensorId, Range range, CircularBuffer& buf) {
-        String path = getFilePath(sensorId, range);
-        if (!LittleFS.exists(path)) return false;
-        
-        File file = LittleFS.open(path, "r");
-        if (!file) return false;
-        
-        uint8_t header[12];
-        if (file.read(header, 12) != 12) {
-            file.close();
-            return false;
+
+    // Pre-log format: one ring file per series and tier, rewritten every minute.
+    String getLegacyFilePath(const char* sensorId, Range range) {
+        return String(HISTORY_DIR) + "/" + sensorId + "_" + RANGE_NAMES[range] + ".bin";
+    }
+
+    uint8_t crc8(const uint8_t* data, size_t len, uint8_t crc = 0) {
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    size_t writeRecord(File& file, uint8_t type, const uint8_t* payload, size_t len) {
+        uint8_t header[2] = {type, (uint8_t)len};
+        uint8_t crc = crc8(payload, len, crc8(header, 2));
+        size_t written = file.write(header, 2);
+        written += file.write(payload, len);
+        written += file.write(&crc, 1);
+        return written;
+    }
+
+    bool readRecord(File& file, uint8_t& type, uint8_t* payload, size_t& len) {
+        uint8_t header[2];
+        if (file.read(header, 2) != 2) return false;
+        len = header[1];
+        if (file.read(payload, len) != len) return false;
+        uint8_t crc;
+        if (file.read(&crc, 1) != 1) return false;
+        if (crc != crc8(payload, len, crc8(header, 2))) return false;
+        type = header[0];
+        return true;
+    }
+
+    bool parseSegmentName(const char* name, Range& range, uint32_t& seq) {
+        const char* dash = strchr(name, '-');
+        if (!dash || !strstr(dash, ".log")) return false;
+        for (int i = 0; i < 3; i++) {
+            size_t len = strlen(RANGE_NAMES[i]);
+            if ((size_t)(dash - name) == len && strncmp(name, RANGE_NAMES[i], len) == 0) {
+                range = (Range)i;
+                seq = (uint32_t)strtoul(dash + 1, nullptr, 10);
+                return true;
+            }
         }
+        return false;
+    }
+
+    // Legacy ring file: 12-byte header (head, count, lastWrite) + capacity points.
+    // Returns the number of points, oldest first.
+    size_t loadLegacyPoints(const char* sensorId, Range range, HistoryPoint* points) {
+        String path = getLegacyFilePath(sensorId, range);
+        if (!LittleFS.exists(path)) return 0;
         
-        memcpy(&buf.head, header, 4);
-        memcpy(&buf.count, header + 4, 4);
-        memcpy(&buf.lastWrite, header + 8, 4);
+        File file = LittleFS.open(path, "r");
+        if (!file) return 0;
         
-        size_t expectedSize = buf.capacity * sizeof(HistoryPoint);
-        if (file.read((uint8_t*)buf.points, expectedSize) != expectedSize) {
-            buf.head = 0;
-            buf.count = 0;
-            buf.lastWrite = 0;
+        size_t capacity = getCapacity(range);
+        uint32_t header[3];
+        size_t expectedSize = capacity * sizeof(HistoryPoint);
+        if (file.read((uint8_t*)header, sizeof(header)) != sizeof(header)
+            || file.read((uint8_t*)points, expectedSize) != expectedSize) {
             file.close();
-            return false;
+            return 0;
         }
-        
         file.close();
+
+        uint32_t head = header[0];
+        uint32_t count = header[1];
+        if (head >= capacity || count > capacity) return 0;
+
+        if (count >= capacity) std::rotate(points, points + head, points + capacity);
+        return count;
+    }
+
+    float getScale(Registry::Handle handle) {
+        SensorConfig::Sensor* sensor = SensorConfig::getSensor(handle);
+        if (!sensor) {
+            // Device on/off series
+            return Devices::getDevice(handle) ? 1.0f : 0.0f;
+        }
+        if (strcmp(sensor->type, "temperature") == 0) return 0.01f;
+        if (strcmp(sensor->type, "dewpoint") == 0) return 0.01f;
+        if (strcmp(sensor->type, "humidity") == 0) return 0.1f;
+        if (strcmp(sensor->type, "co2") == 0) return 1.0f;
+        if (strcmp(sensor->type, "light") == 0) return 0.1f;
+        if (strcmp(sensor->type, "vpd") == 0) return 0.001f;
+        if (strcmp(sensor->type, "absolute_humidity") == 0) return 0.01f;
+        if (strcmp(sensor->type, "enthalpy") == 0) return 0.01f;
+        return 0.0f;
+    }
+
+    size_t getSlot(Range range, uint32_t timestamp) {
+        return (timestamp / getInterval(range)) % getCapacity(range);
+    }
+
+    void clearSlot(SensorHistory& sh, Range range, size_t slot) {
+        if (sh.scale > 0) static_cast<int16_t*>(sh.columns[range])[slot] = EMPTY_SLOT;
+        else static_cast<float*>(sh.columns[range])[slot] = NAN;
+    }
+
+    void setSlot(SensorHistory& sh, Range range, size_t slot, float value) {
+        if (sh.scale > 0) {
+            if (isnan(value)) {
+                clearSlot(sh, range, slot);
+                return;
+            }
+            // Saturate instead of wrapping if a value exceeds the type's range
+            float q = roundf(value / sh.scale);
+            q = std::max(std::min(q, (float)INT16_MAX), (float)(EMPTY_SLOT + 1));
+            static_cast<int16_t*>(sh.columns[range])[slot] = (int16_t)q;
+        } else {
+            static_cast<float*>(sh.columns[range])[slot] = value;
+        }
+    }
+
+    bool readSlot(const SensorHistory& sh, Range range, size_t slot, float& value) {
+        if (sh.scale > 0) {
+            int16_t q = static_cast<const int16_t*>(sh.columns[range])[slot];
+            if (q == EMPTY_SLOT) return false;
+            value = q * sh.scale;
+            return true;
+        }
+        value = static_cast<const float*>(sh.columns[range])[slot];
+        return !isnan(value);
+    }
+
+    void clearColumn(SensorHistory& sh, Range range) {
+        for (size_t i = 0; i < getCapacity(range); i++) {
+            clearSlot(sh, range, i);
+        }
+    }
+
+    bool isColumnEmpty(const SensorHistory& sh, Range range) {
+        float value;
+        for (size_t i = 0; i < getCapacity(range); i++) {
+            if (readSlot(sh, range, i, value)) return false;
+        }
         return true;
     }
     
-    void initSensorHistory(const char* sensorId) {
-        if (histories.find(sensorId) != histories.end()) return;
-        
-        SensorHistory& sh = histories[sensorId];
-        
-        sh.buffers[RANGE_6H].points = new HistoryPoint[POINTS_6H];
-        sh.buffers[RANGE_6H].capacity = POINTS_6H;
-        sh.buffers[RANGE_6H].interval = INTERVAL_6H;
-        
-        sh.buffers[RANGE_24H].points = new HistoryPoint[POINTS_24H];
-        sh.buffers[RANGE_24H].capacity = POINTS_24H;
-        sh.buffers[RANGE_24H].interval = INTERVAL_24H;
+    // One allocation holds all three tier columns
+    void allocateColumns(SensorHistory& sh, float scale) {
+        sh.scale = scale;
+        size_t valueSize = scale > 0 ? sizeof(int16_t) : sizeof(float);
+        uint8_t* block = new uint8_t[TOTAL_POINTS * valueSize];
+        sh.columns[RANGE_6H] = block;
+        sh.columns[RANGE_24H] = block + POINTS_6H * valueSize;
+        sh.columns[RANGE_7D] = block + (POINTS_6H + POINTS_24H) * valueSize;
+    }
+
+    // A sensor whose type changed gets its type's scale; kept points are
+    // converted rather than read back through the old one
+    void refreshScales() {
+        scaleRevision = SensorConfig::getRevision();
+        for (size_t h = 0; h < Registry::MAX_HANDLES; h++) {
+            SensorHistory* sh = histories[h];
+            if (!sh || !SensorConfig::getSensor((Registry::Handle)h)) continue;
+            float scale = getScale((Registry::Handle)h);
+            if (scale == sh->scale) continue;
+
+            SensorHistory old = *sh;
+            allocateColumns(*sh, scale);
+            for (int r = 0; r < 3; r++) {
+                for (size_t slot = 0; slot < getCapacity((Range)r); slot++) {
+                    float value;
+                    if (readSlot(old, (Range)r, slot, value)) setSlot(*sh, (Range)r, slot, value);
+                    else clearSlot(*sh, (Range)r, slot);
+                }
+            }
+            delete[] static_cast<uint8_t*>(old.columns[RANGE_6H]);
+            Serial.printf("[History] %s rescaled to %g for its new type\n", Registry::getId((Registry::Handle)h), scale);
+        }
+    }
+
+    SensorHistory* findSeries(Registry::Handle handle) {
+        return handle < Registry::MAX_HANDLES ? histories[handle] : nullptr;
+    }
+
+    SensorHistory* initSensorHistory(Registry::Handle handle) {
+        if (handle >= Registry::MAX_HANDLES) return nullptr;
+        if (histories[handle]) return histories[handle];
         
-        sh.buffers[RANGE_7D].points = new HistoryPoint[POINTS_7D];
-        sh.buffers[RANGE_7D].capacity = POINTS_7D;
-        sh.buffers[RANGE_7D].interval = INTERVAL_7D;
+        histories[handle] = new SensorHistory;
+        seriesCount++;
+        SensorHistory& sh = *histories[handle];
+        allocateColumns(sh, getScale(handle));
         
         for (int i = 0; i < 3; i++) {
-            sh.buffers[i].head = 0;
-            sh.buffers[i].count = 0;
-            sh.buffers[i].lastWrite = 0;
+            clearColumn(sh, (Range)i);
             
             sh.accumulators[i].sum = 0;
             sh.accumulators[i].lastValue = 0;
             sh.accumulators[i].sampleCount = 0;
-            sh.accumulators[i].lastSample = 0;
+            sh.accumulators[i].lastBoundary = 0;
             sh.accumulators[i].mode = AVERAGE;
-            
-            loadBuffer(sensorId, (Range)i, sh.buffers[i]);
         }
         
-        sh.initialized = true;
-        Serial.printf("[History] Initialized sensor: %s\n", sensorId);
+        return &sh;
     }
-    
-    void addPoint(CircularBuffer& buf, uint32_t timestamp, float value) {
-        buf.points[buf.head].timestamp = timestamp;
-        buf.points[buf.head].value = value;
-        
-        buf.head = (buf.head + 1) % (uint32_t)buf.capacity;
-        if (buf.count < (uint32_t)buf.capacity) buf.count++;
-        buf.lastWrite = timestamp;
+
+    void freeSensorHistory(Registry::Handle handle) {
+        SensorHistory* sh = histories[handle];
+        delete[] static_cast<uint8_t*>(sh->columns[RANGE_6H]);
+        delete sh;
+        histories[handle] = nullptr;
+        seriesCount--;
+    }
+
+    // Moves the tier's newest slot forward to `boundary`. The slots passed over
+    // still hold points from one window ago, so they are cleared in every series.
+    void advanceTier(Range range, uint32_t boundary) {
+        uint32_t& newest = tierNewest[range];
+        if (boundary <= newest) return;
+
+        uint32_t interval = getInterval(range);
+        bool wrapped = newest == 0 || (boundary - newest) / interval >= getCapacity(range);
+
+        for (SensorHistory* sh : histories) {
+            if (!sh) continue;
+            if (wrapped) {
+                clearColumn(*sh, range);
+                continue;
+            }
+            for (uint32_t ts = newest + interval; ts <= boundary; ts += interval) {
+                clearSlot(*sh, range, getSlot(range, ts));
+            }
+        }
+        newest = boundary;
+    }
+
+    void addPoint(SensorHistory& sh, Range range, uint32_t timestamp, float value) {
+        uint32_t interval = getInterval(range);
+        uint32_t boundary = (timestamp / interval) * interval;
+        advanceTier(range, boundary);
+
+        // Older than the window: its slot already belongs to a newer boundary
+        if (tierNewest[range] - boundary >= getWindow(range)) return;
+        setSlot(sh, range, getSlot(range, boundary), value);
+        if (boundary > sh.accumulators[range].lastBoundary) {
+            sh.accumulators[range].lastBoundary = boundary;
+        }
+    }
+
+    void copyId(char* out, const uint8_t* src, size_t len) {
+        len = min(len, Registry::MAX_ID_LENGTH - 1);
+        memcpy(out, src, len);
+        out[len] = '\0';
+    }
+
+    void replaySegment(Range range, Segment& seg, std::vector<Registry::Handle>& tags, bool& torn) {
+        torn = false;
+        tags.clear();
+        seg.firstTs = 0;
+        seg.lastTs = 0;
+        seg.bytes = 0;
+
+        File file = LittleFS.open(getSegmentPath(range, seg.seq), "r");
+        if (!file) {
+            torn = true;
+            return;
+        }
+
+        size_t size = file.size();
+        uint8_t payload[REC_MAX_PAYLOAD];
+        uint8_t type;
+        size_t len;
+
+        while (seg.bytes < size) {
+            if (!readRecord(file, type, payload, len)) {
+                torn = true;
+                break;
+            }
+            seg.bytes += len + 3;
+
+            if (type == REC_SERIES && len >= 2) {
+                uint8_t tag = payload[0];
+                char id[Registry::MAX_ID_LENGTH];
+                copyId(id, payload + 1, len - 1);
+                if (tags.size() <= tag) tags.resize(tag + 1, Registry::INVALID_HANDLE);
+                tags[tag] = Registry::intern(id);
+            } else if (type == REC_POINTS && len >= 4) {
+                uint32_t ts;
+                memcpy(&ts, payload, 4);
+                if (seg.firstTs == 0) seg.firstTs = ts;
+                seg.lastTs = ts;
+
+                for (size_t off = 4; off + POINT_ENTRY_SIZE <= len; off += POINT_ENTRY_SIZE) {
+                    uint8_t tag = payload[off];
+                    if (tag >= tags.size()) continue;
+                    SensorHistory* sh = initSensorHistory(tags[tag]);
+                    if (!sh) continue;
+                    float value;
+                    memcpy(&value, payload + off + 1, 4);
+                    addPoint(*sh, range, ts, value);
+                }
+            } else if (type == REC_DROP && len >= 1) {
+                char id[Registry::MAX_ID_LENGTH];
+                copyId(id, payload, len);
+                SensorHistory* sh = findSeries(Registry::find(id));
+                if (sh) clearColumn(*sh, range);
+            }
+        }
+
+        file.close();
+    }
+
+    void loadLogs() {
+        File dir = LittleFS.open(HISTORY_DIR);
+        if (dir && dir.isDirectory()) {
+            File entry = dir.openNextFile();
+            while (entry) {
+                Range range;
+                uint32_t seq;
+                if (parseSegmentName(entry.name(), range, seq)) {
+                    logs[range].segments.push_back({seq, 0, 0, 0});
+                }
+                entry.close();
+                entry = dir.openNextFile();
+            }
+        }
+        dir.close();
+
+        for (int r = 0; r < 3; r++) {
+            TierLog& log = logs[r];
+            std::sort(log.segments.begin(), log.segments.end(),
+                [](const Segment& a, const Segment& b) { return a.seq < b.seq; });
+
+            bool torn = false;
+            for (auto& seg : log.segments) {
+                replaySegment((Range)r, seg, log.tags, torn);
+                if (torn) {
+                    Serial.printf("[History] %s segment %u truncated at %u bytes\n",
+                        RANGE_NAMES[r], seg.seq, (unsigned)seg.bytes);
+                }
+            }
+
+            // Keep appending to the last segment only if it replayed cleanly
+            log.activeWritable = !log.segments.empty() && !torn;
+            log.nextSeq = log.segments.empty() ? 0 : log.segments.back().seq + 1;
+        }
+    }
+
+    void startSegment(TierLog& log) {
+        log.segments.push_back({log.nextSeq++, 0, 0, 0});
+        log.tags.clear();
+        log.activeWritable = true;
+    }
+
+    bool needsNewSegment(Range range, const TierLog& log) {
+        if (!log.activeWritable || log.segments.empty()) return true;
+        const Segment& seg = log.segments.back();
+        if (seg.bytes >= MAX_SEGMENT_BYTES) return true;
+        if (log.tags.size() + seriesCount > MAX_SEGMENT_TAGS) return true;
+        if (seg.firstTs == 0 || log.pending.empty()) return false;
+        uint32_t ts = log.pending.front().timestamp;
+        return ts >= seg.firstTs && ts - seg.firstTs >= getWindow(range) / SEGMENTS_PER_WINDOW;
+    }
+
+    uint8_t declareSeries(TierLog& log, File& file, Segment& seg, Registry::Handle series) {
+        for (size_t i = 0; i < log.tags.size(); i++) {
+            if (log.tags[i] == series) return (uint8_t)i;
+        }
+        uint8_t tag = (uint8_t)log.tags.size();
+        log.tags.push_back(series);
+
+        const char* sensorId = Registry::getId(series);
+        uint8_t payload[REC_MAX_PAYLOAD];
+        size_t idLen = strnlen(sensorId, REC_MAX_PAYLOAD - 1);
+        payload[0] = tag;
+        memcpy(payload + 1, sensorId, idLen);
+        seg.bytes += writeRecord(file, REC_SERIES, payload, idLen + 1);
+        return tag;
+    }
+
+    void expireSegments(Range range) {
+        TierLog& log = logs[range];
+        if (log.segments.empty()) return;
+        uint32_t newest = log.segments.back().lastTs;
+        uint32_t window = getWindow(range);
+
+        while (log.segments.size() > 1 && log.segments.front().lastTs + window < newest) {
+            LittleFS.remove(getSegmentPath(range, log.segments.front().seq));
+            log.segments.erase(log.segments.begin());
+        }
+    }
+
+    void flushTier(Range range) {
+        TierLog& log = logs[range];
+        if (log.pending.empty()) return;
+
+        std::stable_sort(log.pending.begin(), log.pending.end(),
+            [](const PendingPoint& a, const PendingPoint& b) { return a.timestamp < b.timestamp; });
+
+        if (needsNewSegment(range, log)) startSegment(log);
+        Segment& seg = log.segments.back();
+
+        File file = LittleFS.open(getSegmentPath(range, seg.seq), "a");
+        if (!file) {
+            Serial.printf("[History] Failed to open %s log segment\n", RANGE_NAMES[range]);
+            log.activeWritable = false;
+            log.pending.clear();
+            return;
+        }
+
+        size_t expected = 0;
+        size_t bytesBefore = seg.bytes;
+        uint8_t payload[REC_MAX_PAYLOAD];
+        size_t i = 0;
+        while (i < log.pending.size()) {
+            uint32_t ts = log.pending[i].timestamp;
+            size_t len = 4;
+            memcpy(payload, &ts, 4);
+
+            while (i < log.pending.size() && log.pending[i].timestamp == ts
+                   && (len - 4) / POINT_ENTRY_SIZE < MAX_POINTS_PER_BATCH) {
+                size_t declaredBefore = seg.bytes;
+                uint8_t tag = declareSeries(log, file, seg, log.pending[i].series);
+                expected += seg.bytes - declaredBefore;
+                payload[len] = tag;
+                memcpy(payload + len + 1, &log.pending[i].value, 4);
+                len += POINT_ENTRY_SIZE;
+                i++;
+            }
+
+            seg.bytes += writeRecord(file, REC_POINTS, payload, len);
+            expected += len + 3;
+            if (seg.firstTs == 0) seg.firstTs = ts;
+            seg.lastTs = ts;
+        }
+
+        file.close();
+        log.pending.clear();
+
+        // A short write leaves a torn tail; never append after it
+        if (seg.bytes - bytesBefore != expected) {
+            Serial.printf("[History] Short write to %s segment %u\n", RANGE_NAMES[range], seg.seq);
+            log.activeWritable = false;
+        }
+
+        expireSegments(range);
+    }
+
+    void appendDrop(Range range, const char* sensorId) {
+        TierLog& log = logs[range];
+        if (log.segments.empty()) return;
+        if (!log.activeWritable) startSegment(log);
+
+        Segment& seg = log.segments.back();
+        File file = LittleFS.open(getSegmentPath(range, seg.seq), "a");
+        if (!file) return;
+        size_t idLen = strnlen(sensorId, REC_MAX_PAYLOAD);
+        seg.bytes += writeRecord(file, REC_DROP, (const uint8_t*)sensorId, idLen);
+        file.close();
+    }
+
+    // Import the old per-series ring files once, then append their points to the log.
+    void migrateLegacyFiles() {
+        std::vector<String> legacyIds;
+        File dir = LittleFS.open(HISTORY_DIR);
+        if (dir && dir.isDirectory()) {
+            File entry = dir.openNextFile();
+            while (entry) {
+                String name(entry.name());
+                entry.close();
+                int sep = -1;
+                for (int r = 0; r < 3 && sep < 0; r++) {
+                    String suffix = String("_") + RANGE_NAMES[r] + ".bin";
+                    if (name.endsWith(suffix.c_str())) sep = name.length() - suffix.length();
+                }
+                if (sep > 0) {
+                    String id = name.substring(0, sep);
+                    bool seen = false;
+                    for (const auto& existing : legacyIds) {
+                        if (existing == id) seen = true;
+                    }
+                    if (!seen) legacyIds.push_back(id);
+                }
+                entry = dir.openNextFile();
+            }
+        }
+        dir.close();
+
+        if (legacyIds.empty()) return;
+
+        HistoryPoint* points = new HistoryPoint[POINTS_6H];
+        for (const auto& id : legacyIds) {
+            Registry::Handle handle = Registry::intern(id.c_str());
+            SensorHistory* sh = initSensorHistory(handle);
+            if (!sh) continue;
+            for (int r = 0; r < 3; r++) {
+                // A non-empty column means an earlier migration already reached the log
+                if (!isColumnEmpty(*sh, (Range)r)) continue;
+
+                size_t count = loadLegacyPoints(id.c_str(), (Range)r, points);
+                for (size_t i = 0; i < count; i++) {
+                    if (points[i].timestamp < MIN_VALID_EPOCH) continue;
+                    addPoint(*sh, (Range)r, points[i].timestamp, points[i].value);
+                    logs[r].pending.push_back({handle, points[i].timestamp, points[i].value});
+                }
+            }
+        }
+        delete[] points;
+
+        for (int r = 0; r < 3; r++) {
+            flushTier((Range)r);
+        }
+
+        for (const auto& id : legacyIds) {
+            for (int r = 0; r < 3; r++) {
+                String path = getLegacyFilePath(id.c_str(), (Range)r);
+                if (LittleFS.exists(path)) LittleFS.remove(path);
+            }
+        }
+        Serial.printf("[History] Migrated %u series to the append-only log\n", (unsigned)legacyIds.size());
     }
     
-    unsigned long lastSaveTime = 0;
-    const unsigned long SAVE_INTERVAL = 60000;
+    unsigned long lastFlushTime = 0;
+    const unsigned long FLUSH_INTERVAL = 60000;
 }
 
 void init() {
@@ -162,43 +643,76 @@ void init() {
             Serial.println("[History] Failed to create /history directory");
         }
     }
+
+    loadLogs();
+    migrateLegacyFiles();
+
+    // Replay interned every id in the log. Series whose points were all
+    // dropped by a later 'D' record, or whose sensor/device is gone, give
+    // their handles back so stale ids don't fill the registry. A gone id only
+    // gets a new 'D' record while some of its points survived, so an already
+    // dropped series isn't dropped again on every boot.
+    for (size_t h = 0; h < Registry::MAX_HANDLES; h++) {
+        Registry::Handle handle = (Registry::Handle)h;
+        const char* id = Registry::getId(handle);
+        if (!id) continue;
+        bool empty = true;
+        if (histories[h]) {
+            for (int i = 0; i < 3; i++) {
+                if (!isColumnEmpty(*histories[h], (Range)i)) empty = false;
+            }
+        }
+        bool configured = SensorConfig::getSensor(handle) || Devices::getDevice(handle);
+        if (configured) {
+            if (histories[h] && empty) freeSensorHistory(handle);
+            continue;
+        }
+        if (empty) {
+            if (histories[h]) freeSensorHistory(handle);
+        } else {
+            removeSensor(id);
+        }
+        for (auto& log : logs) {
+            std::replace(log.tags.begin(), log.tags.end(), handle, Registry::INVALID_HANDLE);
+        }
+        Registry::release(handle);
+    }
     
-    size_t sensorCount;
-    const char** sensorIds = SensorConfig::getSensorIds(sensorCount);
-    
+    size_t sensorCount = SensorConfig::getSensorCount();
     for (size_t i = 0; i < sensorCount; i++) {
-        initSensorHistory(sensorIds[i]);
+        initSensorHistory(SensorConfig::getSensorByIndex(i)->handle);
     }
     
-    Serial.println("[History] Initialized");
+    Serial.printf("[History] Initialized (%u series, %u/%u/%u segments)\n",
+        (unsigned)seriesCount, (unsigned)logs[RANGE_6H].segments.size(),
+        (unsigned)logs[RANGE_24H].segments.size(), (unsigned)logs[RANGE_7D].segments.size());
 }
 
 void loop() {
-    if (millis() - lastSaveTime < SAVE_INTERVAL) return;
-    lastSaveTime = millis();
+    if (millis() - lastFlushTime < FLUSH_INTERVAL) return;
+    lastFlushTime = millis();
     
-    for (auto& pair : histories) {
-        for (int i = 0; i < 3; i++) {
-            if (pair.second.buffers[i].count > 0) {
-                saveBuffer(pair.first.c_str(), (Range)i, pair.second.buffers[i]);
-            }
-        }
+    for (int i = 0; i < 3; i++) {
+        flushTier((Range)i);
     }
 }
 
 void record(const char* sensorId, float value, RecordMode mode) {
+    record(Registry::intern(sensorId), value, mode);
+}
+
+void record(Registry::Handle handle, float value, RecordMode mode) {
     uint32_t now = (uint32_t)time(nullptr);
     if (now < MIN_VALID_EPOCH) return;
+    if (SensorConfig::getRevision() != scaleRevision) refreshScales();
 
-    if (histories.find(sensorId) == histories.end()) {
-        initSensorHistory(sensorId);
-    }
-    
-    SensorHistory& sh = histories[sensorId];
+    SensorHistory* series = initSensorHistory(handle);
+    if (!series) return;
+    SensorHistory& sh = *series;
     
     for (int i = 0; i < 3; i++) {
         SensorAccumulator& acc = sh.accumulators[i];
-        CircularBuffer& buf = sh.buffers[i];
+        uint32_t interval = getInterval((Range)i);
         
         acc.mode = mode;
         acc.sum += value;
@@ -206,16 +720,15 @@ void record(const char* sensorId, float value, RecordMode mode) {
         acc.sampleCount++;
         
         // Round to interval boundaries (e.g., 13:00:00, 13:05:00, 13:10:00)
-        uint32_t currentBoundary = (now / buf.interval) * buf.interval;
-        uint32_t lastBoundary = (buf.lastWrite / buf.interval) * buf.interval;
+        uint32_t currentBoundary = (now / interval) * interval;
         
-        if (currentBoundary > lastBoundary) {
+        if (currentBoundary > acc.lastBoundary) {
             if (acc.sampleCount > 0) {
                 float recorded = (acc.mode == LAST_VALUE)
                     ? acc.lastValue
                     : acc.sum / acc.sampleCount;
-                addPoint(buf, currentBoundary, recorded);
-                buf.lastWrite = currentBoundary;
+                addPoint(sh, (Range)i, currentBoundary, recorded);
+                logs[i].pending.push_back({handle, currentBoundary, recorded});
                 
                 acc.sum = 0;
                 acc.sampleCount = 0;
@@ -225,33 +738,31 @@ void record(const char* sensorId, float value, RecordMode mode) {
 }
 
 size_t getHistory(const char* sensorId, Range range, uint8_t* buffer, size_t bufferSize) {
-    auto it = histories.find(sensorId);
-    if (it == histories.end()) return 0;
+    const SensorHistory* series = findSeries(Registry::find(sensorId));
+    if (!series) return 0;
     
-    CircularBuffer& buf = it->second.buffers[range];
+    const SensorHistory& sh = *series;
+    uint32_t newest = tierNewest[range];
+    if (newest == 0) return 0;
     
-    size_t pointSize = sizeof(HistoryPoint);
-    size_t maxPoints = bufferSize / pointSize;
-    size_t pointsToReturn = min((size_t)buf.count, maxPoints);
+    size_t capacity = getCapacity(range);
+    uint32_t interval = getInterval(range);
+    size_t maxPoints = bufferSize / sizeof(HistoryPoint);
     
-    if (pointsToReturn == 0) return 0;
-    
-    size_t startIdx;
-    if (buf.count >= (uint32_t)buf.capacity) {
-        startIdx = buf.head;
-    } else {
-        startIdx = 0;
-    }
-    
-    uint8_t* ptr = buffer;
-    for (size_t i = 0; i < pointsToReturn; i++) {
-        size_t idx = (startIdx + i) % buf.capacity;
-        if (buf.points[idx].timestamp < 1600000000) continue;
-        memcpy(ptr, &buf.points[idx], pointSize);
-        ptr += pointSize;
+    // Walk the shared time axis oldest first, emitting the slots that hold a value
+    HistoryPoint* out = reinterpret_cast<HistoryPoint*>(buffer);
+    size_t count = 0;
+    uint32_t oldest = newest >= (capacity - 1) * interval ? newest - (capacity - 1) * interval : 0;
+    for (uint32_t ts = oldest; ts <= newest && count < maxPoints; ts += interval) {
+        if (ts < MIN_VALID_EPOCH) continue;
+        float value;
+        if (!readSlot(sh, range, getSlot(range, ts), value)) continue;
+        HistoryPoint point = {ts, value};
+        memcpy(&out[count], &point, sizeof(point));
+        count++;
     }
     
-    return ptr - buffer;
+    return count * sizeof(HistoryPoint);
 }
 
 size_t getPointCount(Range range) {
@@ -259,37 +770,46 @@ size_t getPointCount(Range range) {
 }
 
 void removeSensor(const char* sensorId) {
-    auto it = histories.find(sensorId);
-    if (it == histories.end()) return;
+    Registry::Handle handle = Registry::find(sensorId);
+    if (!findSeries(handle)) return;
     
     for (int i = 0; i < 3; i++) {
-        delete[] it->second.buffers[i].points;
-        
-        String path = getFilePath(sensorId, (Range)i);
-        if (LittleFS.exists(path)) {
-            LittleFS.remove(path);
-        }
+        auto& pending = logs[i].pending;
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+            [handle](const PendingPoint& p) { return p.series == handle; }), pending.end());
+
+        // The handle may be reused, so the segment must not map its tag to this series any more
+        auto& tags = logs[i].tags;
+        std::replace(tags.begin(), tags.end(), handle, Registry::INVALID_HANDLE);
+
+        appendDrop((Range)i, sensorId);
     }
     
-    histories.erase(it);
+    freeSensorHistory(handle);
     Serial.printf("[History] Removed sensor: %s\n", sensorId);
 }
 
 void clearAll() {
-    for (auto& pair : histories) {
+    for (SensorHistory* sh : histories) {
+        if (!sh) continue;
         for (int i = 0; i < 3; i++) {
-            pair.second.buffers[i].head = 0;
-            pair.second.buffers[i].count = 0;
-            pair.second.buffers[i].lastWrite = 0;
-            pair.second.accumulators[i].sum = 0;
-            pair.second.accumulators[i].lastValue = 0;
-            pair.second.accumulators[i].sampleCount = 0;
-
-            String path = getFilePath(pair.first.c_str(), (Range)i);
-            if (LittleFS.exists(path)) {
-                LittleFS.remove(path);
-            }
+            clearColumn(*sh, (Range)i);
+            sh->accumulators[i].sum = 0;
+            sh->accumulators[i].lastValue = 0;
+            sh->accumulators[i].sampleCount = 0;
+            sh->accumulators[i].lastBoundary = 0;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (const auto& seg : logs[i].segments) {
+            LittleFS.remove(getSegmentPath((Range)i, seg.seq));
         }
+        logs[i].segments.clear();
+        logs[i].tags.clear();
+        logs[i].pending.clear();
+        logs[i].activeWritable = false;
+        tierNewest[i] = 0;
     }
     Serial.println("[History] Cleared all history");
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "registry.h"
 
 namespace History {
 
@@ -32,6 +33,7 @@ void init();
 void loop();
 
 void record(const char* sensorId, float value, RecordMode mode = AVERAGE);
+void record(Registry::Handle handle, float value, RecordMode mode = AVERAGE);
 void removeSensor(const char* sensorId);
 void clearAll();
 
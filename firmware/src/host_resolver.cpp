@@ -0,0 +1,225 @@
+#include "host_resolver.h"
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+namespace HostResolver {
+
+static constexpr size_t CHANGE_QUEUE_SIZE = 4;
+static constexpr size_t TASK_STACK_SIZE = 4096;     // getaddrinfo and the mDNS query
+static constexpr UBaseType_t TASK_PRIORITY = 1;
+static constexpr BaseType_t TASK_CORE = 0;
+static constexpr uint32_t IDLE_WAIT_MS = 1000;
+
+namespace {
+
+    struct Entry {
+        char name[MAX_NAME_LENGTH];     // empty when free
+        in_addr addr;
+        bool hasAddress;
+        bool pending;                   // queued for or on the resolver task
+        bool failed;                    // last attempt found nothing
+        unsigned long resolvedAt;
+        unsigned long nextAttemptAt;    // refresh, or retry after a failure
+        unsigned long lastUsed;
+    };
+
+    Entry entries[MAX_NAMES];
+    portMUX_TYPE entriesMux = portMUX_INITIALIZER_UNLOCKED;
+    QueueHandle_t wakeQueue = nullptr;
+    QueueHandle_t changeQueue = nullptr;
+    TaskHandle_t resolverTask = nullptr;
+    Callback changeCallback;
+
+    Entry* find(const char* name) {
+        for (auto& entry : entries) {
+            if (entry.name[0] && strcmp(entry.name, name) == 0) return &entry;
+        }
+        return nullptr;
+    }
+
+    // A free entry, else the least recently used one not being resolved
+    Entry* claim(unsigned long now) {
+        Entry* victim = nullptr;
+        for (auto& entry : entries) {
+            if (!entry.name[0]) return &entry;
+            if (entry.pending) continue;
+            if (!victim || now - entry.lastUsed > now - victim->lastUsed) victim = &entry;
+        }
+        return victim;
+    }
+
+    bool refreshDue(const Entry& entry, unsigned long now) {
+        return entry.hasAddress && (long)(now - entry.nextAttemptAt) >= 0 &&
+               now - entry.lastUsed < UNUSED_MS;
+    }
+
+    void wake() {
+        uint8_t token = 0;
+        xQueueSend(wakeQueue, &token, 0);
+    }
+
+    bool resolveName(const char* name, in_addr& addr) {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(name, nullptr, &hints, &found) != 0 || !found) return false;
+        addr = ((sockaddr_in*)found->ai_addr)->sin_addr;
+        freeaddrinfo(found);
+        return true;
+    }
+
+    // Takes the next name that needs resolving; false when there is none
+    bool nextWork(char* name) {
+        unsigned long now = millis();
+        bool found = false;
+        portENTER_CRITICAL(&entriesMux);
+        for (auto& entry : entries) {
+            if (!entry.name[0] || !(entry.pending || refreshDue(entry, now))) continue;
+            entry.pending = true;
+            strlcpy(name, entry.name, MAX_NAME_LENGTH);
+            found = true;
+            break;
+        }
+        portEXIT_CRITICAL(&entriesMux);
+        return found;
+    }
+
+    void store(const char* name, bool ok, in_addr addr, uint32_t elapsedMs) {
+        unsigned long now = millis();
+        bool first = false;
+        bool moved = false;
+        bool failedNow = false;
+        Change change = {};
+
+        portENTER_CRITICAL(&entriesMux);
+        Entry* entry = find(name);
+        if (entry) {
+            entry->pending = false;
+            if (ok) {
+                first = !entry->hasAddress;
+                moved = entry->hasAddress && entry->addr.s_addr != addr.s_addr;
+                change.before = entry->addr;
+                entry->addr = addr;
+                entry->hasAddress = true;
+                entry->failed = false;
+                entry->resolvedAt = now;
+                entry->nextAttemptAt = now + TTL_MS - REFRESH_AHEAD_MS;
+            } else {
+                // The old address is served until it expires
+                if (entry->hasAddress && now - entry->resolvedAt >= TTL_MS) entry->hasAddress = false;
+                failedNow = !entry->failed;
+                entry->failed = true;
+                entry->nextAttemptAt = now + NEGATIVE_TTL_MS;
+            }
+        }
+        portEXIT_CRITICAL(&entriesMux);
+        if (!entry) return;
+
+        char text[INET_ADDRSTRLEN];
+        if (first || moved) {
+            inet_ntop(AF_INET, &addr, text, sizeof(text));
+            Serial.printf("[Resolver] %s -> %s (%lums)\n", name, text, (unsigned long)elapsedMs);
+        } else if (failedNow) {
+            Serial.printf("[Resolver] %s did not resolve\n", name);
+        }
+        if (moved) {
+            strlcpy(change.name, name, sizeof(change.name));
+            change.after = addr;
+            xQueueSend(changeQueue, &change, 0);
+        }
+    }
+
+    void resolverTaskFn(void* param) {
+        char name[MAX_NAME_LENGTH];
+        for (;;) {
+            while (nextWork(name)) {
+                unsigned long start = millis();
+                in_addr addr = {};
+                bool ok = resolveName(name, addr);
+                store(name, ok, addr, millis() - start);
+            }
+            uint8_t token;
+            xQueueReceive(wakeQueue, &token, pdMS_TO_TICKS(IDLE_WAIT_MS));
+        }
+    }
+}
+
+void init() {
+    if (!wakeQueue) {
+        wakeQueue = xQueueCreate(1, sizeof(uint8_t));
+    }
+    if (!changeQueue) {
+        changeQueue = xQueueCreate(CHANGE_QUEUE_SIZE, sizeof(Change));
+    }
+    if (!resolverTask) {
+        xTaskCreatePinnedToCore(
+            resolverTaskFn, "resolver", TASK_STACK_SIZE,
+            nullptr, TASK_PRIORITY, &resolverTask, TASK_CORE);
+    }
+    Serial.println("[Resolver] Initialized");
+}
+
+Lookup lookup(const char* name, in_addr& addr) {
+    if (!resolverTask || !name[0] || strlen(name) >= MAX_NAME_LENGTH) return Lookup::FAILED;
+
+    unsigned long now = millis();
+    Lookup result = Lookup::PENDING;
+    bool queued = false;
+
+    portENTER_CRITICAL(&entriesMux);
+    Entry* entry = find(name);
+    if (!entry) {
+        entry = claim(now);
+        if (entry) {
+            *entry = Entry{};
+            strlcpy(entry->name, name, sizeof(entry->name));
+            entry->pending = true;
+            queued = true;
+        } else {
+            result = Lookup::FAILED;
+        }
+    }
+    if (entry) {
+        entry->lastUsed = now;
+        if (entry->hasAddress && now - entry->resolvedAt < TTL_MS) {
+            addr = entry->addr;
+            result = Lookup::FOUND;
+            // Idle past its refresh; served while it is resolved again
+            queued = !entry->pending && (long)(now - entry->nextAttemptAt) >= 0;
+            entry->pending = entry->pending || queued;
+        } else if (entry->hasAddress) {
+            // Went unused past its TTL without a refresh; resolved before it is served
+            queued = !entry->pending;
+            entry->pending = true;
+        } else if (!entry->pending) {
+            if ((long)(now - entry->nextAttemptAt) >= 0) {
+                entry->pending = true;
+                queued = true;
+            } else {
+                result = Lookup::FAILED;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&entriesMux);
+
+    if (queued) wake();
+    return result;
+}
+
+void loop() {
+    if (!changeQueue) return;
+    Change change;
+    while (xQueueReceive(changeQueue, &change, 0) == pdTRUE) {
+        if (changeCallback) changeCallback(change);
+    }
+}
+
+void onChange(Callback cb) {
+    changeCallback = cb;
+}
+
+}
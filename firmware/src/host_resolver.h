@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <netinet/in.h>
+
+// Name -> IPv4 cache for device targets given as hostnames, such as
+// "shelly-fan.local". lookup() never blocks: a new name is resolved on the
+// resolver task while the caller retries, and a cached address is refreshed
+// in the background before it expires, so mDNS and DNS stay off the control
+// path. A name that fails to resolve is remembered for NEGATIVE_TTL_MS; a
+// name that resolved before keeps its address until TTL_MS runs out.
+namespace HostResolver {
+
+constexpr size_t MAX_NAMES = 16;
+constexpr size_t MAX_NAME_LENGTH = 40;          // matches Device::ipAddress
+constexpr uint32_t TTL_MS = 300000;
+constexpr uint32_t REFRESH_AHEAD_MS = 60000;    // refresh this long before expiry
+constexpr uint32_t NEGATIVE_TTL_MS = 30000;
+constexpr uint32_t UNUSED_MS = 600000;          // not refreshed once unused this long
+
+enum class Lookup : uint8_t {
+    FOUND,
+    PENDING,    // being resolved; ask again shortly
+    FAILED,     // did not resolve recently
+};
+
+// A refresh found a name at a new address
+struct Change {
+    char name[MAX_NAME_LENGTH];
+    in_addr before;
+    in_addr after;
+};
+
+using Callback = std::function<void(const Change& change)>;
+
+void init();
+
+// Safe to call from any task. `name` carries no port.
+Lookup lookup(const char* name, in_addr& addr);
+
+// Delivers address changes to the callback on the calling task
+void loop();
+void onChange(Callback cb);
+
+}
@@ -0,0 +1,561 @@
+#include "http_engine.h"
+#include "host_resolver.h"
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace HttpEngine {
+
+namespace {
+    constexpr size_t REQUEST_BUFFER_SIZE = MAX_HOST_LENGTH + MAX_PATH_LENGTH + 48;
+    constexpr size_t HEADER_BUFFER_SIZE = 512;
+    constexpr size_t RECV_CHUNK_SIZE = 512;
+    constexpr uint32_t RESOLVE_RECHECK_MS = 10;
+
+    enum class Phase : uint8_t { IDLE, RESOLVING, CONNECTING, SENDING, RECEIVING, DONE };
+
+    // Chunked transfer decoding, one byte of framing at a time
+    enum class Chunk : uint8_t { SIZE, EXTENSION, DATA, DATA_END, TRAILER };
+
+    struct Slot {
+        Phase phase = Phase::IDLE;
+        int fd = -1;
+        uint32_t tag = 0;
+        char host[MAX_HOST_LENGTH];
+        sockaddr_in addr;
+        bool resolved = false;
+        bool reused = false;            // fd came from the pool
+        unsigned long startedAt = 0;
+        unsigned long deadline = 0;
+        uint32_t connectTimeoutMs = 0;
+        uint32_t timeoutMs = 0;
+        Status status = Status::OK;
+        char request[REQUEST_BUFFER_SIZE];
+        size_t requestLength = 0;
+        size_t sent = 0;
+        BodySink sink = nullptr;
+        void* sinkContext = nullptr;
+        char header[HEADER_BUFFER_SIZE];
+        size_t headerReceived = 0;
+        size_t headerLength = 0;        // 0 until the header is complete
+        int httpCode = 0;
+        long contentLength = -1;
+        size_t bodyLength = 0;
+        bool bodyDone = false;
+        bool chunked = false;
+        Chunk chunk = Chunk::SIZE;
+        size_t chunkRemaining = 0;
+        uint8_t trailerLine = 0;
+        bool keepAlive = false;         // server will keep the connection open
+    };
+
+    // Idle keep-alive connections, one per target at most
+    struct PooledConnection {
+        int fd = -1;
+        char host[MAX_HOST_LENGTH];
+        in_addr addr;                   // what host resolved to when it was opened
+        unsigned long idleSince = 0;
+    };
+
+    Slot slots[MAX_IN_FLIGHT];
+    char recvBuffer[RECV_CHUNK_SIZE];   // body bytes pass through on their way to a sink
+    PooledConnection pool[MAX_POOLED];
+    size_t maxInFlight = MAX_IN_FLIGHT;
+    size_t active = 0;
+    bool keepAliveEnabled = true;
+    Stats stats;
+
+    // Names go through the resolver cache; an address literal never waits
+    HostResolver::Lookup resolve(const char* host, sockaddr_in& addr) {
+        char name[MAX_HOST_LENGTH];
+        strlcpy(name, host, sizeof(name));
+        uint16_t port = 80;
+        char* colon = strchr(name, ':');
+        if (colon) {
+            *colon = '\0';
+            port = (uint16_t)atoi(colon + 1);
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, name, &addr.sin_addr) == 1) return HostResolver::Lookup::FOUND;
+        return HostResolver::lookup(name, addr.sin_addr);
+    }
+
+    void closePooled(PooledConnection& conn) {
+        close(conn.fd);
+        conn.fd = -1;
+    }
+
+    // A pooled connection is usable while the server has neither closed it
+    // nor sent anything unprompted.
+    bool stillOpen(int fd) {
+        char probe;
+        ssize_t n = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    // Resolves the slot's host first: a connection opened to an address the
+    // name no longer has would still reach the old device, so it is closed.
+    int takePooled(Slot& slot) {
+        slot.resolved = resolve(slot.host, slot.addr) == HostResolver::Lookup::FOUND;
+        for (auto& conn : pool) {
+            if (conn.fd < 0 || strcmp(conn.host, slot.host) != 0) continue;
+            int fd = conn.fd;
+            conn.fd = -1;
+            if (slot.resolved && conn.addr.s_addr == slot.addr.sin_addr.s_addr && stillOpen(fd)) return fd;
+            close(fd);
+        }
+        return -1;
+    }
+
+    // When full, the most recently pooled connection is replaced. A poll
+    // sweep cycles through every device, which would flush an LRU pool
+    // holding fewer entries than there are devices; this way the other
+    // entries survive until the next sweep.
+    void releaseToPool(const Slot& slot) {
+        PooledConnection* target = nullptr;
+        for (auto& conn : pool) {
+            if (conn.fd < 0) {
+                target = &conn;
+                break;
+            }
+            if (!target || (long)(conn.idleSince - target->idleSince) > 0) target = &conn;
+        }
+        if (target->fd >= 0) {
+            closePooled(*target);
+            stats.evicted++;
+        }
+        target->fd = slot.fd;
+        strlcpy(target->host, slot.host, sizeof(target->host));
+        target->addr = slot.addr.sin_addr;
+        target->idleSince = millis();
+    }
+
+    void fail(Slot& slot, Status status) {
+        slot.status = status;
+        slot.phase = Phase::DONE;
+    }
+
+    void sendPending(Slot& slot);
+
+    void openConnection(Slot& slot) {
+        if (!slot.resolved) {
+            switch (resolve(slot.host, slot.addr)) {
+                case HostResolver::Lookup::FOUND:
+                    break;
+                case HostResolver::Lookup::PENDING:
+                    // poll() asks again; the wait counts against the connect deadline
+                    if (slot.phase != Phase::RESOLVING) {
+                        slot.phase = Phase::RESOLVING;
+                        slot.deadline = millis() + slot.connectTimeoutMs;
+                    }
+                    return;
+                case HostResolver::Lookup::FAILED:
+                    fail(slot, Status::CONNECT_FAILED);
+                    return;
+            }
+            slot.resolved = true;
+        }
+        unsigned long connectDeadline =
+            slot.phase == Phase::RESOLVING ? slot.deadline : millis() + slot.connectTimeoutMs;
+
+        slot.fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (slot.fd < 0) {
+            fail(slot, Status::CONNECT_FAILED);
+            return;
+        }
+        fcntl(slot.fd, F_SETFL, fcntl(slot.fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(slot.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        stats.connects++;
+
+        slot.deadline = connectDeadline;
+        if (connect(slot.fd, (sockaddr*)&slot.addr, sizeof(slot.addr)) == 0) {
+            slot.phase = Phase::SENDING;
+            slot.deadline = millis() + slot.timeoutMs;
+            sendPending(slot);
+        } else if (errno == EINPROGRESS) {
+            slot.phase = Phase::CONNECTING;
+        } else {
+            fail(slot, Status::CONNECT_FAILED);
+        }
+    }
+
+    // The server may drop a pooled connection just as it is reused. Nothing
+    // was answered yet, so the request is repeated once on a fresh one.
+    bool reconnect(Slot& slot) {
+        if (!slot.reused || slot.headerReceived > 0) return false;
+        close(slot.fd);
+        slot.fd = -1;
+        slot.reused = false;
+        slot.sent = 0;
+        stats.reconnects++;
+        openConnection(slot);
+        return true;
+    }
+
+    bool headerIs(const char* line, const char* name) {
+        return strncasecmp(line, name, strlen(name)) == 0;
+    }
+
+    bool headerHas(const char* line, const char* value) {
+        const char* end = strstr(line, "\r\n");
+        size_t length = strlen(value);
+        for (const char* p = line; p + length <= end; p++) {
+            if (strncasecmp(p, value, length) == 0) return true;
+        }
+        return false;
+    }
+
+    // False until the header is complete
+    bool parseHeader(Slot& slot) {
+        const char* data = slot.header;
+        const char* end = strstr(data, "\r\n\r\n");
+        if (!end) return false;
+        slot.headerLength = end - data + 4;
+        if (sscanf(data, "HTTP/1.%*d %d", &slot.httpCode) != 1) {
+            fail(slot, Status::BAD_RESPONSE);
+            return true;
+        }
+
+        bool http11 = strncmp(data, "HTTP/1.1", 8) == 0;
+        bool closeRequested = false;
+        for (const char* line = strstr(data, "\r\n"); line && line < end; line = strstr(line, "\r\n")) {
+            line += 2;
+            if (headerIs(line, "Content-Length:")) {
+                slot.contentLength = atol(line + 15);
+            } else if (headerIs(line, "Transfer-Encoding:")) {
+                slot.chunked = headerHas(line, "chunked");
+            } else if (headerIs(line, "Connection:")) {
+                closeRequested = headerHas(line, "close");
+            }
+        }
+        // Without a length the body ends at EOF and the connection with it
+        slot.keepAlive = http11 && !closeRequested && (slot.contentLength >= 0 || slot.chunked);
+        return true;
+    }
+
+    void deliver(Slot& slot, const char* data, size_t length) {
+        if (length == 0) return;
+        slot.bodyLength += length;
+        if (slot.sink) slot.sink(slot.sinkContext, data, length);
+    }
+
+    void dechunk(Slot& slot, const char* data, size_t length) {
+        size_t i = 0;
+        while (i < length && !slot.bodyDone) {
+            char c = data[i];
+            switch (slot.chunk) {
+                case Chunk::SIZE:
+                case Chunk::EXTENSION:
+                    i++;
+                    if (c == '\n') {
+                        slot.chunk = slot.chunkRemaining ? Chunk::DATA : Chunk::TRAILER;
+                    } else if (c == ';') {
+                        slot.chunk = Chunk::EXTENSION;
+                    } else if (slot.chunk == Chunk::SIZE && isxdigit((unsigned char)c)) {
+                        slot.chunkRemaining = slot.chunkRemaining * 16 +
+                            (isdigit((unsigned char)c) ? c - '0' : (tolower(c) - 'a' + 10));
+                    }
+                    break;
+                case Chunk::DATA: {
+                    size_t take = min(slot.chunkRemaining, length - i);
+                    deliver(slot, data + i, take);
+                    i += take;
+                    slot.chunkRemaining -= take;
+                    if (slot.chunkRemaining == 0) slot.chunk = Chunk::DATA_END;
+                    break;
+                }
+                case Chunk::DATA_END:
+                    i++;
+                    if (c == '\n') slot.chunk = Chunk::SIZE;
+                    break;
+                case Chunk::TRAILER:
+                    // Trailer lines until an empty one
+                    i++;
+                    if (c == '\n') {
+                        if (slot.trailerLine == 0) slot.bodyDone = true;
+                        slot.trailerLine = 0;
+                    } else if (c != '\r') {
+                        slot.trailerLine = 1;
+                    }
+                    break;
+            }
+        }
+        // Bytes past the body would desync the next response
+        if (i < length) slot.keepAlive = false;
+    }
+
+    void consumeBody(Slot& slot, const char* data, size_t length) {
+        if (slot.chunked) {
+            dechunk(slot, data, length);
+        } else if (slot.contentLength >= 0) {
+            size_t remaining = slot.contentLength - slot.bodyLength;
+            if (length > remaining) {
+                slot.keepAlive = false;
+                length = remaining;
+            }
+            deliver(slot, data, length);
+            slot.bodyDone = slot.bodyLength == (size_t)slot.contentLength;
+        } else {
+            deliver(slot, data, length);    // read to EOF
+        }
+    }
+
+    void readAvailable(Slot& slot) {
+        for (;;) {
+            bool inHeader = slot.headerLength == 0;
+            char* buffer = inHeader ? slot.header + slot.headerReceived : recvBuffer;
+            size_t room = inHeader ? HEADER_BUFFER_SIZE - 1 - slot.headerReceived : RECV_CHUNK_SIZE;
+            if (room == 0) {
+                fail(slot, Status::BAD_RESPONSE);
+                return;
+            }
+
+            ssize_t n = recv(slot.fd, buffer, room, 0);
+            if (n > 0) {
+                if (inHeader) {
+                    slot.headerReceived += n;
+                    slot.header[slot.headerReceived] = '\0';
+                    if (!parseHeader(slot)) continue;
+                    if (slot.phase == Phase::DONE) return;
+                    // Body bytes that arrived with the header
+                    consumeBody(slot, slot.header + slot.headerLength, slot.headerReceived - slot.headerLength);
+                } else {
+                    consumeBody(slot, recvBuffer, n);
+                }
+                if (slot.bodyDone) {
+                    slot.phase = Phase::DONE;
+                    return;
+                }
+                continue;
+            }
+            if (n == 0) {
+                slot.keepAlive = false;
+                if (!slot.headerLength) {
+                    if (!reconnect(slot)) fail(slot, Status::BAD_RESPONSE);
+                } else if (slot.chunked || slot.contentLength >= 0) {
+                    // Closed before the announced end
+                    fail(slot, Status::BAD_RESPONSE);
+                } else {
+                    slot.phase = Phase::DONE;
+                }
+                return;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !reconnect(slot)) {
+                fail(slot, Status::BAD_RESPONSE);
+            }
+            return;
+        }
+    }
+
+    void sendPending(Slot& slot) {
+        ssize_t n = send(slot.fd, slot.request + slot.sent, slot.requestLength - slot.sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !reconnect(slot)) {
+                fail(slot, Status::BAD_RESPONSE);
+            }
+            return;
+        }
+        slot.sent += n;
+        if (slot.sent == slot.requestLength) slot.phase = Phase::RECEIVING;
+    }
+
+    void finishConnect(Slot& slot) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(slot.fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            fail(slot, Status::CONNECT_FAILED);
+            return;
+        }
+        slot.phase = Phase::SENDING;
+        slot.deadline = millis() + slot.timeoutMs;
+        sendPending(slot);
+    }
+
+    void complete(Slot& slot, const Callback& callback) {
+        Response response = {};
+        response.tag = slot.tag;
+        response.status = slot.status;
+        response.httpCode = slot.status == Status::OK ? slot.httpCode : 0;
+        response.bodyLength = slot.bodyLength;
+        response.elapsedMs = millis() - slot.startedAt;
+        response.reused = slot.reused;
+
+        if (slot.fd >= 0) {
+            if (slot.bodyDone && slot.keepAlive && keepAliveEnabled) releaseToPool(slot);
+            else close(slot.fd);
+        }
+
+        if (callback) callback(response);
+
+        slot.fd = -1;
+        slot.phase = Phase::IDLE;
+        active--;
+    }
+}
+
+bool start(const Request& request) {
+    if (active >= maxInFlight) return false;
+    Slot* slot = nullptr;
+    for (auto& s : slots) {
+        if (s.phase == Phase::IDLE) {
+            slot = &s;
+            break;
+        }
+    }
+    if (!slot) return false;
+
+    active++;
+    slot->tag = request.tag;
+    strlcpy(slot->host, request.host, sizeof(slot->host));
+    slot->resolved = false;
+    slot->startedAt = millis();
+    slot->connectTimeoutMs = request.connectTimeoutMs;
+    slot->timeoutMs = request.timeoutMs;
+    slot->status = Status::OK;
+    slot->sent = 0;
+    slot->headerLength = 0;
+    slot->contentLength = -1;
+    slot->sink = request.sink;
+    slot->sinkContext = request.sinkContext;
+    slot->headerReceived = 0;
+    slot->httpCode = 0;
+    slot->bodyLength = 0;
+    slot->bodyDone = false;
+    slot->chunked = false;
+    slot->chunk = Chunk::SIZE;
+    slot->chunkRemaining = 0;
+    slot->trailerLine = 0;
+    slot->keepAlive = false;
+
+    int written = snprintf(slot->request, sizeof(slot->request),
+        "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+        request.path, request.host, keepAliveEnabled ? "keep-alive" : "close");
+    slot->requestLength = min((size_t)written, sizeof(slot->request) - 1);
+
+    slot->fd = keepAliveEnabled ? takePooled(*slot) : -1;
+    slot->reused = slot->fd >= 0;
+    if (slot->reused) {
+        stats.reused++;
+        slot->phase = Phase::SENDING;
+        slot->deadline = slot->startedAt + slot->timeoutMs;
+        sendPending(*slot);
+    } else {
+        openConnection(*slot);
+    }
+    return true;
+}
+
+void poll(uint32_t waitMs, const Callback& callback) {
+    fd_set readSet;
+    fd_set writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    int maxFd = -1;
+    unsigned long now = millis();
+    uint32_t wait = waitMs;
+
+    for (auto& slot : slots) {
+        switch (slot.phase) {
+            case Phase::IDLE:
+                continue;
+            case Phase::DONE:
+                wait = 0;
+                continue;
+            case Phase::RESOLVING:
+                wait = min(wait, RESOLVE_RECHECK_MS);
+                break;
+            case Phase::CONNECTING:
+            case Phase::SENDING:
+                FD_SET(slot.fd, &writeSet);
+                break;
+            case Phase::RECEIVING:
+                FD_SET(slot.fd, &readSet);
+                break;
+        }
+        maxFd = max(maxFd, slot.fd);
+        long remaining = (long)(slot.deadline - now);
+        wait = min(wait, (uint32_t)max(remaining, 0L));
+    }
+
+    // Idle connections are watched too, so one the server closes is
+    // dropped now rather than failing its next request
+    for (auto& conn : pool) {
+        if (conn.fd < 0) continue;
+        if (now - conn.idleSince >= POOL_IDLE_MS) {
+            closePooled(conn);
+            continue;
+        }
+        FD_SET(conn.fd, &readSet);
+        maxFd = max(maxFd, conn.fd);
+    }
+
+    if (maxFd >= 0) {
+        timeval tv = {(time_t)(wait / 1000), (suseconds_t)((wait % 1000) * 1000)};
+        if (select(maxFd + 1, &readSet, &writeSet, nullptr, &tv) < 0) {
+            FD_ZERO(&readSet);
+            FD_ZERO(&writeSet);
+        }
+    } else if (wait > 0) {
+        delay(wait);
+    }
+
+    for (auto& conn : pool) {
+        if (conn.fd >= 0 && FD_ISSET(conn.fd, &readSet)) closePooled(conn);
+    }
+
+    now = millis();
+    for (auto& slot : slots) {
+        if (slot.phase == Phase::RESOLVING) {
+            openConnection(slot);
+        } else if (slot.phase == Phase::CONNECTING && FD_ISSET(slot.fd, &writeSet)) {
+            finishConnect(slot);
+        } else if (slot.phase == Phase::SENDING && FD_ISSET(slot.fd, &writeSet)) {
+            sendPending(slot);
+        } else if (slot.phase == Phase::RECEIVING && FD_ISSET(slot.fd, &readSet)) {
+            readAvailable(slot);
+        }
+
+        if (slot.phase == Phase::IDLE) continue;
+        if (slot.phase != Phase::DONE && (long)(now - slot.deadline) >= 0) {
+            bool connecting = slot.phase == Phase::RESOLVING || slot.phase == Phase::CONNECTING;
+            fail(slot, connecting ? Status::CONNECT_FAILED : Status::TIMEOUT);
+        }
+        if (slot.phase == Phase::DONE) complete(slot, callback);
+    }
+}
+
+size_t inFlight() {
+    return active;
+}
+
+bool hasFreeSlot() {
+    return active < maxInFlight;
+}
+
+Stats getStats() {
+    return stats;
+}
+
+void setMaxInFlight(size_t count) {
+    maxInFlight = constrain(count, (size_t)1, MAX_IN_FLIGHT);
+}
+
+void setKeepAlive(bool enabled) {
+    keepAliveEnabled = enabled;
+    if (enabled) return;
+    for (auto& conn : pool) {
+        if (conn.fd >= 0) closePooled(conn);
+    }
+}
+
+}
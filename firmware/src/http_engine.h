@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include "poll_scheduler.h"
+#include "socket_budget.h"
+
+// Non-blocking HTTP/1.1 GET client over plain sockets. Up to MAX_IN_FLIGHT
+// requests progress together, each with its own connect and response
+// deadline, so a sweep over many plugs takes about as long as the slowest
+// one rather than the sum of all of them. Connections are kept alive and
+// pooled per target, so a repeat request skips the TCP handshake; one whose
+// host name has since resolved to another address is closed instead. Bodies
+// are streamed to a per-request sink rather than buffered. Host names go
+// through HostResolver; a request waits in its slot while a new name is
+// resolved instead of blocking the engine. Not thread-safe: start() and
+// poll() belong to the task that owns the engine.
+namespace HttpEngine {
+
+constexpr size_t MAX_IN_FLIGHT = SocketBudget::HTTP_IN_FLIGHT;
+constexpr size_t MAX_HOST_LENGTH = 40;      // matches Device::ipAddress
+constexpr size_t MAX_PATH_LENGTH = 48;
+constexpr size_t MAX_POOLED = SocketBudget::HTTP_POOLED;
+// Covers the fast re-polls of a unit whose draw is moving; a stable unit is
+// polled once a minute and not worth holding a socket for
+constexpr uint32_t POOL_IDLE_MS = 3 * PollScheduler::FAST_INTERVAL_MS;
+
+// Receives the decoded body in pieces as it arrives
+using BodySink = void (*)(void* context, const char* data, size_t length);
+
+struct Request {
+    char host[MAX_HOST_LENGTH];     // "192.168.1.20", optionally with ":port"
+    char path[MAX_PATH_LENGTH];
+    uint32_t connectTimeoutMs;
+    uint32_t timeoutMs;             // from connected to the last byte
+    uint32_t tag;                   // caller's id, echoed in the Response
+    BodySink sink;                  // nullptr discards the body
+    void* sinkContext;
+};
+
+enum class Status : uint8_t {
+    OK,
+    CONNECT_FAILED,     // unresolvable, refused or connect deadline passed
+    TIMEOUT,            // connected, but the response missed its deadline
+    BAD_RESPONSE,       // closed early or not HTTP
+};
+
+struct Response {
+    uint32_t tag;
+    Status status;
+    int httpCode;           // 0 unless status is OK
+    size_t bodyLength;      // bytes passed to the sink
+    uint32_t elapsedMs;
+    bool reused;            // sent on a pooled connection
+};
+
+struct Stats {
+    uint32_t connects;      // fresh TCP connections opened
+    uint32_t reused;        // requests sent on a pooled connection
+    uint32_t reconnects;    // pooled connection was dead, request repeated
+    uint32_t evicted;       // idle connections closed to make room
+};
+
+using Callback = std::function<void(const Response& response)>;
+
+// Opens the connection and queues the request. False when every slot is
+// busy; the request is not started.
+bool start(const Request& request);
+
+// Waits up to `waitMs` for socket activity, advances every request and
+// calls `callback` once for each one that finished or missed its deadline.
+void poll(uint32_t waitMs, const Callback& callback);
+
+size_t inFlight();
+bool hasFreeSlot();
+Stats getStats();
+
+// Caps concurrent requests below MAX_IN_FLIGHT; 1 reproduces a serial
+// client. Used by the native benchmark.
+void setMaxInFlight(size_t count);
+
+// Off sends "Connection: close" and drops the pool. Used by the native
+// benchmark to compare against a fresh connection per request.
+void setKeepAlive(bool enabled);
+
+}
@@ -0,0 +1,215 @@
+#include "json_scan.h"
+
+namespace JsonScan {
+
+namespace {
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    bool isLiteralChar(char c) {
+        return isalnum((unsigned char)c) || c == '-' || c == '+' || c == '.';
+    }
+
+    void appendPath(Scanner& s, const char* part, size_t length) {
+        size_t room = MAX_PATH_LENGTH - 1 - s.pathLength;
+        if (length > room) length = room;
+        memcpy(s.path + s.pathLength, part, length);
+        s.pathLength += length;
+    }
+
+    // Path of the current element in the innermost array
+    void elementPath(Scanner& s) {
+        char part[6];
+        int length = snprintf(part, sizeof(part), "[%u]", s.elementIndex[s.depth]);
+        s.pathLength = s.pathLengths[s.depth];
+        appendPath(s, part, length);
+    }
+
+    void keyPath(Scanner& s) {
+        s.pathLength = s.pathLengths[s.depth];
+        if (s.pathLength > 0) appendPath(s, ".", 1);
+        appendPath(s, s.token, s.tokenLength);
+    }
+
+    void record(Scanner& s, Kind kind) {
+        s.path[s.pathLength] = '\0';
+        s.token[s.tokenLength] = '\0';
+        for (size_t i = 0; i < s.fieldCount; i++) {
+            Field& field = s.fields[i];
+            if (strcmp(field.path, s.path) != 0) continue;
+            field.kind = kind;
+            memcpy(field.value, s.token, s.tokenLength + 1);
+        }
+    }
+
+    void valueDone(Scanner& s) {
+        s.state = s.depth == 0 ? State::DONE : State::NEXT;
+    }
+
+    void open(Scanner& s, char c) {
+        if (s.depth >= MAX_DEPTH) {
+            s.state = State::FAILED;
+            return;
+        }
+        s.stack[s.depth++] = c;
+        s.pathLengths[s.depth] = s.pathLength;
+        if (c == '{') {
+            s.state = State::KEY_OR_END;
+        } else {
+            s.elementIndex[s.depth] = 0;
+            elementPath(s);
+            s.state = State::VALUE;
+        }
+    }
+
+    void close(Scanner& s, char c) {
+        char expected = c == '}' ? '{' : '[';
+        if (s.depth == 0 || s.stack[s.depth - 1] != expected) {
+            s.state = State::FAILED;
+            return;
+        }
+        s.depth--;
+        valueDone(s);
+    }
+
+    void startToken(Scanner& s, State state, bool inKey) {
+        s.state = state;
+        s.inKey = inKey;
+        s.tokenLength = 0;
+    }
+
+    void appendToken(Scanner& s, char c) {
+        if (s.tokenLength < MAX_VALUE_LENGTH - 1) s.token[s.tokenLength++] = c;
+    }
+
+    void endLiteral(Scanner& s) {
+        Kind kind = Kind::NUMBER;
+        if (s.token[0] == 't' || s.token[0] == 'f') kind = Kind::BOOLEAN;
+        else if (s.token[0] == 'n') kind = Kind::NULL_VALUE;
+        record(s, kind);
+        valueDone(s);
+    }
+
+    // Returns false when `c` has to be looked at again in the new state
+    bool step(Scanner& s, char c) {
+        switch (s.state) {
+            case State::VALUE:
+                if (isSpace(c)) return true;
+                if (c == '{' || c == '[') open(s, c);
+                else if (c == ']') close(s, c);     // empty array
+                else if (c == '"') startToken(s, State::STRING, false);
+                else if (c == '-' || isalnum((unsigned char)c)) {
+                    startToken(s, State::LITERAL, false);
+                    appendToken(s, c);
+                } else s.state = State::FAILED;
+                return true;
+
+            case State::KEY_OR_END:
+                if (isSpace(c)) return true;
+                if (c == '"') startToken(s, State::STRING, true);
+                else if (c == '}') close(s, c);
+                else s.state = State::FAILED;
+                return true;
+
+            case State::COLON:
+                if (isSpace(c)) return true;
+                s.state = c == ':' ? State::VALUE : State::FAILED;
+                return true;
+
+            case State::STRING:
+                if (c == '\\') {
+                    s.state = State::ESCAPE;
+                } else if (c != '"') {
+                    appendToken(s, c);
+                } else if (s.inKey) {
+                    keyPath(s);
+                    s.state = State::COLON;
+                } else {
+                    record(s, Kind::STRING);
+                    valueDone(s);
+                }
+                return true;
+
+            case State::ESCAPE:
+                appendToken(s, c);
+                s.state = State::STRING;
+                return true;
+
+            case State::LITERAL:
+                if (isLiteralChar(c)) {
+                    appendToken(s, c);
+                    return true;
+                }
+                endLiteral(s);
+                return false;
+
+            case State::NEXT:
+                if (isSpace(c)) return true;
+                if (c == ',') {
+                    if (s.stack[s.depth - 1] == '{') {
+                        s.state = State::KEY_OR_END;
+                    } else {
+                        if (s.elementIndex[s.depth] < 255) s.elementIndex[s.depth]++;
+                        elementPath(s);
+                        s.state = State::VALUE;
+                    }
+                } else if (c == '}' || c == ']') {
+                    close(s, c);
+                } else {
+                    s.state = State::FAILED;
+                }
+                return true;
+
+            case State::DONE:
+            case State::FAILED:
+                return true;
+        }
+        return true;
+    }
+}
+
+void begin(Scanner& scanner, const char* const* paths, size_t count) {
+    scanner.fieldCount = min(count, MAX_FIELDS);
+    for (size_t i = 0; i < scanner.fieldCount; i++) {
+        scanner.fields[i].path = paths[i];
+        scanner.fields[i].kind = Kind::MISSING;
+        scanner.fields[i].value[0] = '\0';
+    }
+    scanner.state = State::VALUE;
+    scanner.inKey = false;
+    scanner.depth = 0;
+    scanner.pathLengths[0] = 0;
+    scanner.pathLength = 0;
+    scanner.tokenLength = 0;
+}
+
+void feed(Scanner& scanner, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (scanner.state == State::DONE || scanner.state == State::FAILED) return;
+        if (!step(scanner, data[i])) i--;
+    }
+}
+
+bool complete(const Scanner& scanner) {
+    return scanner.state == State::DONE;
+}
+
+bool failed(const Scanner& scanner) {
+    return scanner.state == State::FAILED;
+}
+
+const Field* find(const Scanner& scanner, const char* path) {
+    for (size_t i = 0; i < scanner.fieldCount; i++) {
+        const Field& field = scanner.fields[i];
+        if (field.kind != Kind::MISSING && strcmp(field.path, path) == 0) return &field;
+    }
+    return nullptr;
+}
+
+float number(const Field* field) {
+    if (!field || field->kind != Kind::NUMBER) return NAN;
+    return strtof(field->value, nullptr);
+}
+
+}
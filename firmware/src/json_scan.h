@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Incremental JSON scanner that picks a few scalar fields out of a document
+// fed in arbitrary pieces, without building a tree. Device replies are
+// parsed straight off the socket this way: Tasmota's Status 0 runs to a few
+// kilobytes of which two values are used. No heap; the state lives in the
+// Scanner.
+namespace JsonScan {
+
+constexpr size_t MAX_FIELDS = 16;         // state and power of a six-channel unit
+constexpr size_t MAX_DEPTH = 8;
+constexpr size_t MAX_PATH_LENGTH = 64;
+constexpr size_t MAX_VALUE_LENGTH = 16;     // longer values are truncated
+
+enum class Kind : uint8_t { MISSING, STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+struct Field {
+    const char* path;       // "StatusSNS.ENERGY.Power", "relays[1].ison"; must outlive the scan
+    Kind kind;
+    char value[MAX_VALUE_LENGTH];   // string contents, or the literal as written
+};
+
+enum class State : uint8_t {
+    VALUE, KEY_OR_END, COLON, STRING, ESCAPE, LITERAL, NEXT, DONE, FAILED
+};
+
+struct Scanner {
+    Field fields[MAX_FIELDS];
+    size_t fieldCount;
+    State state;
+    bool inKey;
+    char stack[MAX_DEPTH];          // '{' or '[' per open container
+    uint8_t pathLengths[MAX_DEPTH + 1];
+    uint8_t elementIndex[MAX_DEPTH + 1];    // per open array
+    uint8_t depth;
+    char path[MAX_PATH_LENGTH];     // dotted key path of the current value
+    uint8_t pathLength;
+    char token[MAX_VALUE_LENGTH];   // key or scalar being read
+    uint8_t tokenLength;
+};
+
+// Resets `scanner` to look for `paths`; at most MAX_FIELDS are kept.
+void begin(Scanner& scanner, const char* const* paths, size_t count);
+
+void feed(Scanner& scanner, const char* data, size_t length);
+
+// A complete top-level value was read
+bool complete(const Scanner& scanner);
+bool failed(const Scanner& scanner);
+
+// The field for `path` when it was found, else nullptr
+const Field* find(const Scanner& scanner, const char* path);
+
+// Number or NaN when the field is missing or not numeric
+float number(const Field* field);
+
+}
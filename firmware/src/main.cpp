@@ -2,8 +2,15 @@
 #include "storage.h"
 #include "wifi_manager.h"
 #include "websocket_server.h"
+#include "ws_frame.h"
+#include "ws_outbox.h"
 #include "device_controller.h"
+#include "device_reconciler.h"
+#include "poll_scheduler.h"
+#include "device_notify.h"
+#include "host_resolver.h"
 #include "sensors.h"
+#include "sensor_sampler.h"
 #include "device_modes.h"
 #include "devices.h"
 #include "energy_tracker.h"
@@ -12,12 +19,14 @@
 #include "history.h"
 #include "climate_config.h"
 #include "event_log.h"
+#include "time_utils.h"
 #include "ota_manager.h"
 #include "contract.h"
+#include "registry.h"
 #include <ArduinoJson.h>
 #include <ESPmDNS.h>
 #include <WiFi.h>
-#include <map>
+#include <arpa/inet.h>
 
 namespace {
     constexpr uint32_t MIN_VALID_EPOCH = 1600000000;
@@ -28,43 +37,131 @@ namespace {
     };
 
     unsigned long lastBroadcast = 0;
-    unsigned long lastDevicePoll = 0;
     const unsigned long BROADCAST_INTERVAL = 5000;
-    const unsigned long DEVICE_POLL_INTERVAL = 30000;
-    unsigned int pollCycle = 0;
-    const unsigned int OFFLINE_RECHECK_INTERVAL = 3;
     const int OFFLINE_THRESHOLD = 3;
-    std::map<String, int> deviceFailCount;
-    std::map<String, float> currentSensorReadings;
-    std::map<String, CachedSensorReading> cachedSensorReadings;
+    // All indexed by Registry handle
+    int deviceFailCount[Registry::MAX_HANDLES] = {};
+    Registry::Readings currentSensorReadings;
+    Sensors::Snapshot sensorSnapshot;
+    uint32_t sampledRound = 0;
+    CachedSensorReading cachedSensorReadings[Registry::MAX_HANDLES] = {};
     bool sensorReadingsDirty = false;
 
-    void sendMessage(const String& message, uint32_t clientId = 0) {
+    // Called before a sensor/device is removed, since its handle may be reused later
+    void clearHandleState(Registry::Handle handle) {
+        if (handle >= Registry::MAX_HANDLES) return;
+        deviceFailCount[handle] = 0;
+        DeviceReconciler::clear(handle);
+        PollScheduler::reset(handle);
+        currentSensorReadings.set(handle, NAN);
+        cachedSensorReadings[handle] = {};
+        SensorSampler::reset(handle);
+    }
+
+    void sendMessage(const JsonDocument& doc, uint32_t clientId = 0, const char* key = nullptr) {
         if (clientId) {
-            WebSocketServer::sendTo(clientId, message);
+            WebSocketServer::sendTo(clientId, doc, key);
         } else {
-            WebSocketServer::broadcast(message);
+            WebSocketServer::broadcast(doc, key);
         }
     }
 
-    void sendTyped(const char* type, const String& json, uint32_t clientId) {
+    // The module writes its payload straight into the frame's "data". These
+    // are full snapshots, so a newer one replaces any still queued.
+    void sendTyped(const char* type, void (*write)(JsonVariant data), uint32_t clientId) {
         JsonDocument doc;
         doc["type"] = type;
-        JsonDocument dataDoc;
-        deserializeJson(dataDoc, json);
-        doc["data"] = dataDoc;
-        String out;
-        serializeJson(doc, out);
-        sendMessage(out, clientId);
+        write(doc["data"].to<JsonVariant>());
+        sendMessage(doc, clientId, type);
+    }
+
+    void sendDeviceModes(uint32_t clientId = 0)   { sendTyped("device_modes",   DeviceModes::getModesJson,      clientId); }
+    void sendDevices(uint32_t clientId = 0)       { Devices::computeControlModes(); sendTyped("devices", Devices::getDevicesJson, clientId); }
+    void sendClimateConfig(uint32_t clientId = 0) { sendTyped("climate_config", ClimateConfig::getConfigJson,   clientId); }
+    void sendEvents(uint32_t clientId = 0)        { sendTyped("events",         EventLog::getEventsJson,        clientId); }
+    void sendEnergy(uint32_t clientId = 0)        { sendTyped("energy",         EnergyTracker::getEnergiesJson, clientId); }
+    void sendDli(uint32_t clientId = 0)           { sendTyped("dli",            DliTracker::getDliJson,         clientId); }
+    void sendSensors(uint32_t clientId = 0)       { sendTyped("sensor_config",  SensorConfig::getSensorsJson,   clientId); }
+
+    // A list broadcast as "<list>_delta" frames: only entries changed since
+    // the last one, or the full list when the changes outgrew a delta
+    struct DeltaFeed {
+        const char* type;
+        uint32_t (*version)();
+        bool (*takeChanges)(JsonObject data);
+        void (*sendFull)(uint32_t clientId);
+        uint32_t sentVersion;
+    };
+
+    DeltaFeed sensorFeed = {"sensor_config_delta", SensorConfig::getVersion, SensorConfig::takeChanges, sendSensors, 0};
+    DeltaFeed deviceFeed = {"devices_delta", Devices::getVersion, Devices::takeChanges, sendDevices, 0};
+    DeltaFeed modeFeed = {"device_modes_delta", DeviceModes::getVersion, DeviceModes::takeChanges, sendDeviceModes, 0};
+    DeltaFeed energyFeed = {"energy_delta", EnergyTracker::getVersion, EnergyTracker::takeChanges, sendEnergy, 0};
+    uint32_t sentDliVersion = 0;
+
+    void broadcastChanges(DeltaFeed& feed) {
+        uint32_t version = feed.version();
+        if (version == feed.sentVersion) return;
+        feed.sentVersion = version;
+
+        JsonDocument doc;
+        doc["type"] = feed.type;
+        if (!feed.takeChanges(doc["data"].to<JsonObject>())) {
+            feed.sendFull(0);
+            return;
+        }
+        WebSocketServer::broadcast(doc);
+    }
+
+    void broadcastDliChange() {
+        uint32_t version = DliTracker::getVersion();
+        if (version == sentDliVersion) return;
+        sentDliVersion = version;
+        sendDli();
+    }
+
+    // Config edits from any client reach every client in the same pass
+    void broadcastConfigChanges() {
+        broadcastChanges(sensorFeed);
+        broadcastChanges(deviceFeed);
+        broadcastChanges(modeFeed);
     }
 
-    void sendDeviceModes(uint32_t clientId = 0)   { String j; DeviceModes::getModesJson(j);     sendTyped("device_modes",   j, clientId); }
-    void sendDevices(uint32_t clientId = 0)       { Devices::computeControlModes(); String j; Devices::getDevicesJson(j); sendTyped("devices", j, clientId); }
-    void sendClimateConfig(uint32_t clientId = 0) { String j; ClimateConfig::getConfigJson(j);  sendTyped("climate_config", j, clientId); }
-    void sendEvents(uint32_t clientId = 0)        { String j; EventLog::getEventsJson(j);       sendTyped("events",         j, clientId); }
-    void sendEnergy(uint32_t clientId = 0)        { String j; EnergyTracker::getEnergiesJson(j);sendTyped("energy",         j, clientId); }
-    void sendDli(uint32_t clientId = 0)           { String j; DliTracker::getDliJson(j);        sendTyped("dli",            j, clientId); }
-    void sendSensors(uint32_t clientId = 0)       { String j; SensorConfig::getSensorsJson(j);  sendTyped("sensor_config",  j, clientId); }
+    // After /api/config/restore rewrote the files. Handles whose ids are gone
+    // lose their state here before they can be reused.
+    void reloadConfig() {
+        Devices::init(clearHandleState);
+        DeviceModes::init();
+        SensorConfig::init(clearHandleState);
+        EnergyTracker::init();
+        ClimateConfig::init();
+
+        sendDevices();
+        sendDeviceModes();
+        sendSensors();
+        sendEnergy();
+        sendClimateConfig();
+    }
+
+    void sendSystemInfo(uint32_t clientId = 0) {
+        JsonDocument response;
+        response["type"] = "system_info";
+        JsonObject respData = response["data"].to<JsonObject>();
+        respData["uptime"] = millis() / 1000;
+        respData["freeHeap"] = ESP.getFreeHeap();
+        respData["chipModel"] = ESP.getChipModel();
+        respData["wifiRssi"] = WiFi.RSSI();
+        respData["ipAddress"] = WiFiManager::getIP();
+        respData["firmwareVersion"] = FIRMWARE_VERSION;
+        respData["timezone"] = TimeUtils::getTimezone();
+        respData["timezoneSet"] = TimeUtils::hasSavedTimezone();
+        PollScheduler::Stats polls = PollScheduler::getStats();
+        respData["pollRate"] = roundf(polls.achievedPerMinute * 10) / 10;
+        respData["pollTarget"] = roundf(polls.targetPerMinute * 10) / 10;
+        respData["wsClients"] = WebSocketServer::getClientCount();
+        respData["wsQueuedBytes"] = WsFrame::getStats().liveBytes;
+        sendMessage(response, clientId, "system_info");
+    }
 
     void sendHistory(const char* sensorId, const char* range, uint32_t clientId = 0) {
         History::Range r;
@@ -104,28 +201,154 @@ namespace {
             
             histData["payload"] = (const char*)b64buf;
             
-            String out;
-            serializeJson(doc, out);
+            sendMessage(doc, clientId);
             delete[] b64buf;
-            sendMessage(out, clientId);
         }
     }
 
-    void pollAllDevices() {
-        size_t count = Devices::getDeviceCount();
-        if (count == 0) return;
-        
-        bool recheckOffline = (pollCycle % OFFLINE_RECHECK_INTERVAL == 0);
-        pollCycle++;
-        
-        for (size_t i = 0; i < count; i++) {
-            Devices::Device* device = Devices::getDeviceByIndex(i);
-            if (!device || strlen(device->ipAddress) == 0) continue;
-            
-            if (!device->isOnline && !recheckOffline) continue;
-            
-            DeviceController::queryAsync(device->controlMethod, device->ipAddress);
+    // A device answered or pushed; `on` is -1 when it did not report its relay.
+    // True when online or relay state changed.
+    bool updateReachable(Devices::Device* device, int8_t on) {
+        bool changed = false;
+        deviceFailCount[device->handle] = 0;
+        if (!device->isOnline) {
+            Devices::setDeviceOnline(device->id, true);
+            changed = true;
+            Serial.printf("[DeviceCtrl] %s came online\n", device->name);
+
+            char desc[128];
+            snprintf(desc, sizeof(desc), "%s is reachable", device->name);
+            EventLog::pushEvent("system", "Device online", desc);
+        }
+        if (on >= 0 && device->isOn != (on == 1)) {
+            Devices::setDeviceState(device->id, on == 1);
+            changed = true;
+        }
+        if (changed) DeviceModes::onDeviceState(device->handle);
+        return changed;
+    }
+
+    void broadcastDeviceStatus(const Devices::Device* device, bool on, bool success) {
+        JsonDocument response;
+        response["type"] = "device_status";
+        JsonObject respData = response["data"].to<JsonObject>();
+        respData["deviceId"] = device->id;
+        respData["target"] = device->ipAddress;
+        respData["on"] = on;
+        respData["success"] = success;
+        respData["online"] = device->isOnline;
+        uint32_t statusTimestamp = (uint32_t)time(nullptr);
+        if (statusTimestamp >= MIN_VALID_EPOCH) {
+            respData["timestamp"] = statusTimestamp;
+        }
+        char key[WsOutbox::MAX_KEY_LENGTH];
+        snprintf(key, sizeof(key), "device_status:%s", device->id);
+        WebSocketServer::broadcast(response, key);
+    }
+
+    // One channel of a poll or control result
+    void applyChannelResult(Devices::Device* device, const DeviceController::QueryResult& result,
+                            const DeviceController::AsyncResult& ar) {
+        bool changed = false;
+
+        if (result.reachable) {
+            changed = updateReachable(device, result.isOn ? 1 : 0);
+        } else {
+            int& fails = deviceFailCount[device->handle];
+            fails++;
+            if (device->isOnline && fails >= OFFLINE_THRESHOLD) {
+                Devices::setDeviceOnline(device->id, false);
+                changed = true;
+                Serial.printf("[DeviceCtrl] %s went offline after %d failures\n", device->name, fails);
+
+                char desc[128];
+                snprintf(desc, sizeof(desc), "%s is unreachable", device->name);
+                EventLog::pushEvent("system", "Device offline", desc, "warning");
+            }
+        }
+
+        if (result.reachable && !isnan(result.watts) && device->hasEnergyMonitoring) {
+            EnergyTracker::updateWatts(device->id, result.watts);
+        }
+
+        if (ar.wasControl) {
+            if (result.reachable) PollScheduler::onControl(device->unitHandle, device->channel, result.isOn);
+            DeviceReconciler::onControlResult(device->handle, ar.sequence, result.reachable, ar.requestedState, result.isOn);
+            DeviceModes::onDeviceControlResult(device->id, result.reachable, ar.requestedState, result.isOn);
+        }
+
+        if (ar.wasControl || changed) {
+            broadcastDeviceStatus(device, result.reachable ? result.isOn : ar.requestedState, result.reachable);
+        }
+    }
+
+    // A unit query fans out to the device on each channel
+    void onDeviceResult(const DeviceController::AsyncResult& ar) {
+        Registry::Handle unit = Registry::INVALID_HANDLE;
+        bool reachable = false;
+        uint8_t onMask = 0;
+        float watts = NAN;
+
+        for (uint8_t i = 0; i < ar.channelCount; i++) {
+            const DeviceController::QueryResult& result = ar.results[i];
+            uint8_t channel = ar.firstChannel + i;
+            Devices::Device* device = Devices::findDeviceByTarget(ar.method, ar.target, channel);
+            if (!device || device->handle >= Registry::MAX_HANDLES) continue;
+
+            applyChannelResult(device, result, ar);
+
+            unit = device->unitHandle;
+            reachable |= result.reachable;
+            if (result.isOn) onMask |= 1 << channel;
+            if (!isnan(result.watts)) watts = (isnan(watts) ? 0 : watts) + result.watts;
+        }
+
+        if (!ar.wasControl && unit != Registry::INVALID_HANDLE) {
+            PollScheduler::onQueryResult(unit, reachable, onMask, watts);
+        }
+    }
+
+    void onDeviceNotify(const DeviceNotify::Notification& notification) {
+        Devices::Device* device = notification.deviceId[0]
+            ? Devices::getDevice(notification.deviceId)
+            : Devices::findDeviceByTarget(nullptr, notification.source, notification.channel);
+        if (!device || device->handle >= Registry::MAX_HANDLES) {
+            Serial.printf("[Notify] No device for %s\n",
+                notification.deviceId[0] ? notification.deviceId : notification.source);
+            return;
+        }
+
+        bool changed = updateReachable(device, notification.on);
+        if (!isnan(notification.watts) && device->hasEnergyMonitoring) {
+            EnergyTracker::updateWatts(device->id, notification.watts);
         }
+        PollScheduler::onPush(device->unitHandle, device->channel, device->isOn);
+
+        if (changed) broadcastDeviceStatus(device, device->isOn, true);
+    }
+
+    // A device configured by hostname answers at a new address now
+    void onHostChange(const HostResolver::Change& change) {
+        size_t nameLength = strlen(change.name);
+        const Devices::Device* device = nullptr;
+        for (size_t i = 0; i < Devices::getDeviceCount() && !device; i++) {
+            const Devices::Device* d = Devices::getDeviceByIndex(i);
+            if (d && strncmp(d->ipAddress, change.name, nameLength) == 0 &&
+                (d->ipAddress[nameLength] == '\0' || d->ipAddress[nameLength] == ':')) {
+                device = d;
+            }
+        }
+        if (!device) return;
+
+        char before[INET_ADDRSTRLEN];
+        char after[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &change.before, before, sizeof(before));
+        inet_ntop(AF_INET, &change.after, after, sizeof(after));
+        Serial.printf("[DeviceCtrl] %s (%s) moved from %s to %s\n", device->name, change.name, before, after);
+
+        char desc[128];
+        snprintf(desc, sizeof(desc), "%s (%s) moved from %s to %s", device->name, change.name, before, after);
+        EventLog::pushEvent("device", "Device address changed", desc);
     }
 
     void handleMessage(uint32_t clientId, const String& message) {
@@ -150,9 +373,7 @@ namespace {
             JsonDocument response;
             response["type"] = "pong";
             response["data"]["timestamp"] = millis();
-            String out;
-            serializeJson(response, out);
-            sendMessage(out, clientId);
+            sendMessage(response, clientId);
             break;
         }
         case WsContract::ClientMessage::GetInit: {
@@ -166,9 +387,7 @@ namespace {
             JsonDocument ppfdResp;
             ppfdResp["type"] = "ppfd_calibration";
             ppfdResp["data"]["factor"] = Sensors::getPpfdCalibrationFactor();
-            String ppfdOut;
-            serializeJson(ppfdResp, ppfdOut);
-            sendMessage(ppfdOut, clientId);
+            sendMessage(ppfdResp, clientId);
             break;
         }
         case WsContract::ClientMessage::GetDeviceModes:
@@ -192,9 +411,7 @@ namespace {
             JsonDocument response;
             response["type"] = "ppfd_calibration";
             response["data"]["factor"] = Sensors::getPpfdCalibrationFactor();
-            String out;
-            serializeJson(response, out);
-            sendMessage(out, clientId);
+            sendMessage(response, clientId);
             break;
         }
         case WsContract::ClientMessage::GetEnergy:
@@ -212,31 +429,22 @@ namespace {
         case WsContract::ClientMessage::ClearEvents:
             EventLog::clearEvents();
             break;
-        case WsContract::ClientMessage::GetSystemInfo: {
-            JsonDocument response;
-            response["type"] = "system_info";
-            JsonObject respData = response["data"].to<JsonObject>();
-            respData["uptime"] = millis() / 1000;
-            respData["freeHeap"] = ESP.getFreeHeap();
-            respData["chipModel"] = ESP.getChipModel();
-            respData["wifiRssi"] = WiFi.RSSI();
-            respData["ipAddress"] = WiFiManager::getIP();
-            respData["firmwareVersion"] = FIRMWARE_VERSION;
-            String out;
-            serializeJson(response, out);
-            sendMessage(out, clientId);
+        case WsContract::ClientMessage::GetSystemInfo:
+            sendSystemInfo(clientId);
             break;
-        }
         case WsContract::ClientMessage::DeviceControl: {
-            const char* method = payload["method"];
-            const char* target = payload["target"];
+            const char* method = payload["method"] | "";
+            const char* target = payload["target"] | "";
             bool on = payload["on"];
+            uint8_t channel = payload["channel"] | 0;
 
-            DeviceController::controlAsync(
-                method ? method : "",
-                target ? target : "",
-                on
-            );
+            // Known devices go through their desired state, so repeated clicks collapse
+            Devices::Device* device = Devices::findDeviceByTarget(method, target, channel);
+            if (device) {
+                DeviceReconciler::setDesired(device->handle, on, true);
+            } else {
+                DeviceController::controlAsync(method, target, on, channel);
+            }
             break;
         }
         case WsContract::ClientMessage::SetDeviceMode: {
@@ -246,18 +454,17 @@ namespace {
             if (payload["triggers"].is<JsonArray>()) modeDoc["triggers"] = payload["triggers"];
             if (payload["cycle"].is<JsonObject>()) modeDoc["cycle"] = payload["cycle"];
             if (payload["schedule"].is<JsonObject>()) modeDoc["schedule"] = payload["schedule"];
+            if (payload["rule"].is<JsonObject>()) modeDoc["rule"] = payload["rule"];
 
             DeviceModes::setMode(modeDoc);
-            sendDeviceModes();
-            sendDevices();
+            Devices::computeControlModes();
             break;
         }
         case WsContract::ClientMessage::DeleteDeviceMode: {
             const char* deviceId = payload["deviceId"];
             if (deviceId) {
                 DeviceModes::removeMode(deviceId);
-                sendDeviceModes();
-                sendDevices();
+                Devices::computeControlModes();
             }
             break;
         }
@@ -270,9 +477,14 @@ namespace {
             deviceDoc["ipAddress"] = payload["ipAddress"];
             deviceDoc["controlMode"] = payload["controlMode"];
             deviceDoc["hasEnergyMonitoring"] = payload["hasEnergyMonitoring"] | false;
-
-            Devices::addDevice(deviceDoc);
-            sendDevices();
+            deviceDoc["channel"] = payload["channel"] | 0;
+
+            JsonDocument ack;
+            ack["type"] = "add_device";
+            JsonObject ackData = ack["data"].to<JsonObject>();
+            ackData["success"] = Devices::addDevice(deviceDoc);
+            if (!ackData["success"]) ackData["error"] = "Device limit reached";
+            sendMessage(ack, clientId);
             break;
         }
         case WsContract::ClientMessage::UpdateDevice: {
@@ -283,17 +495,16 @@ namespace {
             if (payload["controlMethod"].is<const char*>()) updates["controlMethod"] = payload["controlMethod"];
             if (payload["ipAddress"].is<const char*>()) updates["ipAddress"] = payload["ipAddress"];
             if (payload["hasEnergyMonitoring"].is<bool>()) updates["hasEnergyMonitoring"] = payload["hasEnergyMonitoring"];
+            if (payload["channel"].is<int>()) updates["channel"] = payload["channel"];
 
             Devices::updateDevice(deviceId, updates);
-            sendDevices();
             break;
         }
         case WsContract::ClientMessage::RemoveDevice: {
             const char* deviceId = payload["id"];
+            clearHandleState(Registry::find(deviceId));
             DeviceModes::removeMode(deviceId);
             Devices::removeDevice(deviceId);
-            sendDevices();
-            sendDeviceModes();
             break;
         }
         case WsContract::ClientMessage::AddSensor: {
@@ -307,9 +518,13 @@ namespace {
             sensorDoc["tempSourceId"] = payload["tempSourceId"];
             sensorDoc["humSourceId"] = payload["humSourceId"];
             if (payload["leafTempOffset"].is<float>()) sensorDoc["leafTempOffset"] = payload["leafTempOffset"];
+            if (payload["aggregate"].is<const char*>()) sensorDoc["aggregate"] = payload["aggregate"];
+            if (payload["sourceIds"].is<JsonArray>()) sensorDoc["sourceIds"] = payload["sourceIds"];
+            if (payload["sampleIntervalMs"].is<uint32_t>()) sensorDoc["sampleIntervalMs"] = payload["sampleIntervalMs"];
+            if (payload["oversample"].is<int>()) sensorDoc["oversample"] = payload["oversample"];
+            if (payload["smoothing"].is<float>()) sensorDoc["smoothing"] = payload["smoothing"];
 
             SensorConfig::addSensor(sensorDoc);
-            sendSensors();
             break;
         }
         case WsContract::ClientMessage::UpdateSensor: {
@@ -323,15 +538,19 @@ namespace {
             if (payload["tempSourceId"].is<const char*>()) updates["tempSourceId"] = payload["tempSourceId"];
             if (payload["humSourceId"].is<const char*>()) updates["humSourceId"] = payload["humSourceId"];
             if (payload["leafTempOffset"].is<float>()) updates["leafTempOffset"] = payload["leafTempOffset"];
+            if (payload["aggregate"].is<const char*>()) updates["aggregate"] = payload["aggregate"];
+            if (payload["sourceIds"].is<JsonArray>()) updates["sourceIds"] = payload["sourceIds"];
+            if (payload["sampleIntervalMs"].is<uint32_t>()) updates["sampleIntervalMs"] = payload["sampleIntervalMs"];
+            if (payload["oversample"].is<int>()) updates["oversample"] = payload["oversample"];
+            if (payload["smoothing"].is<float>()) updates["smoothing"] = payload["smoothing"];
 
             SensorConfig::updateSensor(sensorId, updates);
-            sendSensors();
             break;
         }
         case WsContract::ClientMessage::RemoveSensor: {
             const char* sensorId = payload["id"];
+            clearHandleState(Registry::find(sensorId));
             SensorConfig::removeSensor(sensorId);
-            sendSensors();
             break;
         }
         case WsContract::ClientMessage::CalibratePpfd: {
@@ -347,9 +566,7 @@ namespace {
                 JsonObject respData = response["data"].to<JsonObject>();
                 respData["factor"] = factor;
                 respData["success"] = true;
-                String out;
-                serializeJson(response, out);
-                WebSocketServer::broadcast(out);
+                WebSocketServer::broadcast(response);
             } else {
                 JsonDocument response;
                 response["type"] = "ppfd_calibration";
@@ -357,9 +574,7 @@ namespace {
                 respData["success"] = false;
                 respData["error"] = isnan(rawPpfd) || rawPpfd <= 0
                     ? "no_reading" : "invalid_value";
-                String out;
-                serializeJson(response, out);
-                WebSocketServer::broadcast(out);
+                WebSocketServer::broadcast(response);
             }
             break;
         }
@@ -370,12 +585,12 @@ namespace {
             } else {
                 EnergyTracker::resetAllEnergy();
             }
-            sendEnergy();
+            broadcastChanges(energyFeed);
             break;
         }
         case WsContract::ClientMessage::ResetDli:
             DliTracker::resetDli();
-            sendDli();
+            broadcastDliChange();
             break;
         case WsContract::ClientMessage::ResetPpfdCalibration: {
             Sensors::setPpfdCalibrationFactor(1.0f);
@@ -385,9 +600,7 @@ namespace {
             JsonObject respData = response["data"].to<JsonObject>();
             respData["factor"] = 1.0f;
             respData["success"] = true;
-            String out;
-            serializeJson(response, out);
-            WebSocketServer::broadcast(out);
+            WebSocketServer::broadcast(response);
             break;
         }
         case WsContract::ClientMessage::SetClimatePhase: {
@@ -416,23 +629,28 @@ namespace {
             }
             break;
         }
+        case WsContract::ClientMessage::SetTimezone: {
+            const char* timezone = payload["timezone"];
+            bool firstZone = !TimeUtils::hasSavedTimezone();
+            if (timezone && TimeUtils::setTimezone(timezone)) {
+                if (firstZone) DeviceModes::shiftClockTimes(TimeUtils::utcOffsetMinutes());
+                sendSystemInfo();
+            }
+            break;
+        }
         case WsContract::ClientMessage::ClearHistory: {
             History::clearAll();
             JsonDocument response;
             response["type"] = "clear_history";
             response["data"]["success"] = true;
-            String out;
-            serializeJson(response, out);
-            WebSocketServer::broadcast(out);
+            WebSocketServer::broadcast(response);
             break;
         }
         case WsContract::ClientMessage::Restart: {
             JsonDocument response;
             response["type"] = "restart";
             response["data"]["success"] = true;
-            String out;
-            serializeJson(response, out);
-            WebSocketServer::broadcast(out);
+            WebSocketServer::broadcast(response);
             delay(500);
             ESP.restart();
             break;
@@ -440,45 +658,37 @@ namespace {
         }
     }
 
-    void readAndRecordSensors() {
-        Sensors::read();
-        uint32_t readingTimestamp = (uint32_t)time(nullptr);
-        bool hasValidTimestamp = readingTimestamp >= MIN_VALID_EPOCH;
-
-        size_t sensorCount;
-        const char** sensorIds = SensorConfig::getSensorIds(sensorCount);
-        
-        bool anyValid = false;
-        
-        for (size_t i = 0; i < sensorCount; i++) {
-            float value = Sensors::getSensorValue(sensorIds[i]);
-            
-            if (!isnan(value)) {
-                anyValid = true;
-                History::record(sensorIds[i], value);
-                currentSensorReadings[String(sensorIds[i])] = value;
-                if (hasValidTimestamp) {
-                    cachedSensorReadings[String(sensorIds[i])] = { value, readingTimestamp };
-                }
-            }
+    void recordSensorValue(Registry::Handle handle, float value) {
+        History::record(handle, value);
+        currentSensorReadings.set(handle, value);
+        if (sensorSnapshot.timestamp >= MIN_VALID_EPOCH) {
+            cachedSensorReadings[handle] = { value, sensorSnapshot.timestamp };
         }
+        DeviceModes::onSensorReading(handle, currentSensorReadings);
+        sensorReadingsDirty = true;
+    }
+
+    // Every value recorded here comes from the same acquisition round
+    void sampleSensors() {
+        if (!Sensors::readSnapshot(sensorSnapshot) || sensorSnapshot.round == sampledRound) return;
+        sampledRound = sensorSnapshot.round;
+        SensorSampler::loop(sensorSnapshot, recordSensorValue);
+    }
 
+    void recordDevices() {
         size_t deviceCount = Devices::getDeviceCount();
         for (size_t i = 0; i < deviceCount; i++) {
             Devices::Device* device = Devices::getDeviceByIndex(i);
             if (device && device->isOnline) {
-                History::record(device->id, device->isOn ? 1.0f : 0.0f, History::LAST_VALUE);
+                History::record(device->handle, device->isOn ? 1.0f : 0.0f, History::LAST_VALUE);
             }
         }
-        
-        if (anyValid) sensorReadingsDirty = true;
     }
 
     void broadcastSensorData() {
         if (!WebSocketServer::hasClients()) return;
 
-        size_t sensorCount;
-        const char** sensorIds = SensorConfig::getSensorIds(sensorCount);
+        size_t sensorCount = SensorConfig::getSensorCount();
         
         JsonDocument doc;
         doc["type"] = "sensors";
@@ -487,37 +697,32 @@ namespace {
         bool anyValid = false;
         
 		for (size_t i = 0; i < sensorCount; i++) {
-			auto it = cachedSensorReadings.find(String(sensorIds[i]));
-			if (it == cachedSensorReadings.end()) continue;
+			SensorConfig::Sensor* cfg = SensorConfig::getSensorByIndex(i);
+			if (cfg->handle >= Registry::MAX_HANDLES) continue;
+			const CachedSensorReading& cached = cachedSensorReadings[cfg->handle];
+			if (cached.timestamp == 0) continue;
             
             anyValid = true;
-            float value = it->second.value;
 
             JsonObject entry = data.add<JsonObject>();
-            entry["id"] = sensorIds[i];
-            SensorConfig::Sensor* cfg = SensorConfig::getSensor(sensorIds[i]);
-            if (cfg) entry["type"] = cfg->type;
-            entry["value"] = value;
-            if (it->second.timestamp >= MIN_VALID_EPOCH) {
-                entry["timestamp"] = it->second.timestamp;
+            entry["id"] = cfg->id;
+            entry["type"] = cfg->type;
+            entry["value"] = cached.value;
+            if (cached.timestamp >= MIN_VALID_EPOCH) {
+                entry["timestamp"] = cached.timestamp;
             }
 
-            if (cfg && strcmp(cfg->hardwareType, "as7341") == 0) {
-                uint16_t channels[8];
-                if (Sensors::getSpectralChannels(channels, 8)) {
-                    JsonArray ch = entry["channels"].to<JsonArray>();
-                    for (int j = 0; j < 8; j++) {
-                        ch.add(channels[j]);
-                    }
+            if (strcmp(cfg->hardwareType, "as7341") == 0 && sensorSnapshot.as7341.valid) {
+                JsonArray ch = entry["channels"].to<JsonArray>();
+                for (int j = 0; j < 8; j++) {
+                    ch.add(sensorSnapshot.as7341.channels[j]);
                 }
             }
         }
         
         if (!anyValid) return;
 
-        String out;
-        serializeJson(doc, out);
-        WebSocketServer::broadcast(out);
+        WebSocketServer::broadcast(doc, "sensors");
     }
 }
 
@@ -540,70 +745,13 @@ void setup() {
         Serial.println("[ERROR] Storage init failed!");
     }
     
+    TimeUtils::init();
     WiFiManager::init();
+    HostResolver::init();
+    HostResolver::onChange(onHostChange);
     DeviceController::init();
-    DeviceController::onResult([](const DeviceController::AsyncResult& ar) {
-        Devices::Device* device = Devices::findDeviceByTarget(ar.method, ar.target);
-        if (!device) return;
-
-        bool changed = false;
-        String devId(device->id);
-
-        if (ar.result.reachable) {
-            deviceFailCount[devId] = 0;
-            if (!device->isOnline) {
-                Devices::setDeviceOnline(device->id, true);
-                changed = true;
-                Serial.printf("[DeviceCtrl] %s came online\n", device->name);
-
-                char desc[128];
-                snprintf(desc, sizeof(desc), "%s is reachable", device->name);
-                EventLog::pushEvent("system", "Device online", desc);
-            }
-            if (device->isOn != ar.result.isOn) {
-                Devices::setDeviceState(device->id, ar.result.isOn);
-                changed = true;
-            }
-        } else {
-            int& fails = deviceFailCount[devId];
-            fails++;
-            if (device->isOnline && fails >= OFFLINE_THRESHOLD) {
-                Devices::setDeviceOnline(device->id, false);
-                changed = true;
-                Serial.printf("[DeviceCtrl] %s went offline after %d failures\n", device->name, fails);
-
-                char desc[128];
-                snprintf(desc, sizeof(desc), "%s is unreachable", device->name);
-                EventLog::pushEvent("system", "Device offline", desc, "warning");
-            }
-        }
-
-        if (ar.result.reachable && !isnan(ar.result.watts) && device->hasEnergyMonitoring) {
-            EnergyTracker::updateWatts(device->id, ar.result.watts);
-        }
-
-        if (ar.wasControl) {
-            DeviceModes::onDeviceControlResult(device->id, ar.result.reachable, ar.requestedState, ar.result.isOn);
-        }
-
-		if (ar.wasControl || changed) {
-			JsonDocument response;
-			response["type"] = "device_status";
-			JsonObject respData = response["data"].to<JsonObject>();
-			respData["deviceId"] = device->id;
-			respData["target"] = ar.target;
-			respData["on"] = ar.result.reachable ? ar.result.isOn : ar.requestedState;
-			respData["success"] = ar.result.reachable;
-			respData["online"] = device->isOnline;
-			uint32_t statusTimestamp = (uint32_t)time(nullptr);
-			if (statusTimestamp >= MIN_VALID_EPOCH) {
-				respData["timestamp"] = statusTimestamp;
-			}
-			String out;
-            serializeJson(response, out);
-            WebSocketServer::broadcast(out);
-        }
-    });
+    DeviceController::onResult(onDeviceResult);
+    DeviceNotify::onNotify(onDeviceNotify);
     Sensors::init();
     Devices::init();
     SensorConfig::init();
@@ -615,6 +763,7 @@ void setup() {
     EventLog::init();
     
     WebSocketServer::onMessage(handleMessage);
+    WebSocketServer::onRestore(reloadConfig);
     
     OtaManager::validateRollback();
 }
@@ -625,6 +774,9 @@ void loop() {
     
     WiFiManager::loop();
     DeviceController::loop();
+    DeviceReconciler::loop();
+    DeviceNotify::loop();
+    HostResolver::loop();
     
     bool connected = WiFiManager::isConnected();
     
@@ -641,36 +793,34 @@ void loop() {
                 Serial.println("[mDNS] Started: espgrow.local");
                 MDNS.addService("http", "tcp", 80);
             }
-            pollAllDevices();
-            lastDevicePoll = millis();
+            PollScheduler::restart();
         }
         
         WebSocketServer::loop();
+        broadcastConfigChanges();
         EnergyTracker::loop();
         DliTracker::loop();
-        
-        if (millis() - lastDevicePoll >= DEVICE_POLL_INTERVAL) {
-            lastDevicePoll = millis();
-            pollAllDevices();
-        }
+        PollScheduler::loop();
     }
     
     // Sensor reading, history, and automation run regardless of WiFi
+    Sensors::loop();
+    sampleSensors();
     History::loop();
     
     if (millis() - lastBroadcast >= BROADCAST_INTERVAL) {
         lastBroadcast = millis();
-        readAndRecordSensors();
+        recordDevices();
         if (connected) {
             broadcastSensorData();
-            if (EnergyTracker::hasChanged()) sendEnergy();
-            if (DliTracker::hasChanged()) sendDli();
+            broadcastChanges(energyFeed);
+            broadcastDliChange();
         }
     }
     
+    DeviceModes::loop(currentSensorReadings);
     if (sensorReadingsDirty) {
         sensorReadingsDirty = false;
-        DeviceModes::loop(currentSensorReadings);
         EventLog::loop(currentSensorReadings);
     }
     
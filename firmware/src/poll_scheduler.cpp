@@ -0,0 +1,221 @@
+#include "poll_scheduler.h"
+#include "device_controller.h"
+#include "devices.h"
+
+namespace PollScheduler {
+
+namespace {
+    constexpr uint32_t TICK_MS = 50;
+    constexpr uint32_t RESTART_SPREAD_MS = 5000;
+    constexpr uint32_t STALE_QUERY_MS = 10000;      // result was lost; poll again
+    constexpr uint8_t MAX_BACKOFF_STEPS = 8;
+
+    // A change smaller than both is noise, not a moving load
+    constexpr float POWER_DELTA_W = 2.0f;
+    constexpr float POWER_DELTA_RATIO = 0.1f;
+
+    struct DeviceState {
+        bool scheduled = false;
+        bool inFlight = false;
+        bool waiting = false;       // due, but the queue was full
+        bool seen = false;          // lastOnMask/lastWatts hold a result
+        bool pushed = false;        // reports its own changes
+        uint8_t lastOnMask = 0;
+        float lastWatts = NAN;
+        uint8_t failures = 0;
+        uint32_t intervalMs = BASE_INTERVAL_MS;
+        unsigned long dueAt = 0;
+        unsigned long sentAt = 0;
+    };
+
+    DeviceState states[Registry::MAX_HANDLES];
+    size_t cursor = 0;
+    unsigned long lastTick = 0;
+
+    bool windowStarted = false;
+    bool windowReported = false;
+    unsigned long windowStart = 0;
+    uint32_t windowSent = 0;
+    uint32_t windowDeferred = 0;
+    uint32_t windowMaxLag = 0;
+    Stats lastWindow = {};
+
+    bool powerMoved(float before, float after) {
+        if (isnan(before) || isnan(after)) return isnan(before) != isnan(after);
+        float delta = fabsf(after - before);
+        return delta > POWER_DELTA_W && delta > POWER_DELTA_RATIO * max(fabsf(before), fabsf(after));
+    }
+
+    void setBit(uint8_t& mask, uint8_t bit, bool on) {
+        if (on) mask |= 1 << bit;
+        else mask &= ~(1 << bit);
+    }
+
+    void closeWindow(unsigned long now) {
+        lastWindow.achievedPerMinute = windowSent * 60000.0f / max(now - windowStart, 1UL);
+        lastWindow.deferred = windowDeferred;
+        lastWindow.maxLagMs = windowMaxLag;
+        windowReported = true;
+
+        Stats stats = getStats();
+        Serial.printf("[Poll] %u units, %.1f polls/min (target %.1f), %lu deferred, max lag %lums\n",
+            (unsigned)stats.units, stats.achievedPerMinute, stats.targetPerMinute,
+            (unsigned long)stats.deferred, (unsigned long)stats.maxLagMs);
+
+        windowStart = now;
+        windowSent = 0;
+        windowDeferred = 0;
+        windowMaxLag = 0;
+    }
+}
+
+void loop() {
+    unsigned long now = millis();
+    if (now - lastTick < TICK_MS) return;
+    lastTick = now;
+
+    if (!windowStarted) {
+        windowStarted = true;
+        windowStart = now;
+    }
+    if (now - windowStart >= REPORT_INTERVAL_MS) closeWindow(now);
+
+    size_t count = Devices::getDeviceCount();
+    for (size_t n = 0; n < count; n++) {
+        size_t index = (cursor + n) % count;
+        Devices::Device* device = Devices::getDeviceByIndex(index);
+        if (!device || device->handle >= Registry::MAX_HANDLES || !device->ipAddress[0]) continue;
+        if (device->unitChannels == 0) continue;
+
+        DeviceState& s = states[device->handle];
+        if (!s.scheduled) {
+            s.scheduled = true;
+            s.dueAt = now;
+        }
+        if (s.inFlight) {
+            if (now - s.sentAt < STALE_QUERY_MS) continue;
+            s.inFlight = false;
+        }
+        if ((long)(now - s.dueAt) < 0) continue;
+
+        if (!DeviceController::queryAsync(device->controlMethod, device->ipAddress, device->unitChannels)) {
+            // Queue full; start from this device next tick so nobody starves
+            if (!s.waiting) windowDeferred++;
+            s.waiting = true;
+            cursor = index;
+            return;
+        }
+        s.waiting = false;
+        s.inFlight = true;
+        s.sentAt = now;
+        windowSent++;
+        windowMaxLag = max(windowMaxLag, (uint32_t)(now - s.dueAt));
+    }
+}
+
+void restart() {
+    unsigned long now = millis();
+    size_t count = Devices::getDeviceCount();
+    for (size_t i = 0; i < count; i++) {
+        Devices::Device* device = Devices::getDeviceByIndex(i);
+        if (!device || device->handle >= Registry::MAX_HANDLES) continue;
+        DeviceState& s = states[device->handle];
+        s.scheduled = true;
+        s.inFlight = false;
+        s.waiting = false;
+        s.failures = 0;
+        s.dueAt = now + (unsigned long)(i * RESTART_SPREAD_MS / count);
+    }
+}
+
+void onQueryResult(Registry::Handle unit, bool reachable, uint8_t onMask, float watts) {
+    if (unit >= Registry::MAX_HANDLES) return;
+    DeviceState& s = states[unit];
+    unsigned long from = s.inFlight ? s.sentAt : millis();
+    s.inFlight = false;
+
+    uint32_t interval;
+    if (!reachable) {
+        if (s.failures < MAX_BACKOFF_STEPS) s.failures++;
+        interval = min(FAST_INTERVAL_MS << s.failures, OFFLINE_MAX_INTERVAL_MS);
+    } else {
+        if (s.pushed && s.seen && s.lastOnMask != onMask) {
+            s.pushed = false;
+            Devices::Device* d = Devices::getDevice(unit);
+            Serial.printf("[Poll] %s changed without a push, polling it again\n", d ? d->id : "?");
+        }
+
+        if (s.pushed) {
+            interval = PUSHED_INTERVAL_MS;
+        } else if (!s.seen) {
+            interval = BASE_INTERVAL_MS;
+        } else if (s.failures > 0 || s.lastOnMask != onMask || powerMoved(s.lastWatts, watts)) {
+            interval = FAST_INTERVAL_MS;
+        } else {
+            interval = min(s.intervalMs * 2, STABLE_INTERVAL_MS);
+        }
+        s.failures = 0;
+        s.seen = true;
+        s.lastOnMask = onMask;
+        s.lastWatts = watts;
+    }
+
+    s.scheduled = true;
+    s.intervalMs = interval;
+    s.dueAt = from + interval;
+}
+
+void onControl(Registry::Handle unit, uint8_t channel, bool isOn) {
+    if (unit >= Registry::MAX_HANDLES) return;
+    DeviceState& s = states[unit];
+    if (s.seen) setBit(s.lastOnMask, channel, isOn);
+    if (s.pushed) return;
+    unsigned long next = millis() + FAST_INTERVAL_MS;
+    s.intervalMs = FAST_INTERVAL_MS;
+    if (!s.scheduled || (long)(s.dueAt - next) > 0) s.dueAt = next;
+    s.scheduled = true;
+}
+
+void onPush(Registry::Handle unit, uint8_t channel, bool isOn) {
+    if (unit >= Registry::MAX_HANDLES) return;
+    DeviceState& s = states[unit];
+    s.pushed = true;
+    s.seen = true;
+    setBit(s.lastOnMask, channel, isOn);
+    s.failures = 0;
+    s.intervalMs = PUSHED_INTERVAL_MS;
+    if (!s.inFlight) {
+        s.scheduled = true;
+        s.dueAt = millis() + PUSHED_INTERVAL_MS;
+    }
+}
+
+void reset(Registry::Handle unit) {
+    if (unit < Registry::MAX_HANDLES) states[unit] = DeviceState{};
+}
+
+Stats getStats() {
+    Stats stats = lastWindow;
+    stats.units = 0;
+    stats.targetPerMinute = 0;
+
+    size_t count = Devices::getDeviceCount();
+    for (size_t i = 0; i < count; i++) {
+        Devices::Device* device = Devices::getDeviceByIndex(i);
+        if (!device || device->handle >= Registry::MAX_HANDLES || !device->ipAddress[0]) continue;
+        if (device->unitChannels == 0) continue;
+        stats.units++;
+        stats.targetPerMinute += 60000.0f / states[device->handle].intervalMs;
+    }
+
+    // Until the first window closes, report the one in progress
+    if (!windowReported && windowStarted) {
+        unsigned long elapsed = millis() - windowStart;
+        stats.achievedPerMinute = elapsed >= 1000 ? windowSent * 60000.0f / elapsed : 0;
+        stats.deferred = windowDeferred;
+        stats.maxLagMs = windowMaxLag;
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include "registry.h"
+
+// Status polling for every unit with an address; a multi-channel unit is one
+// query, keyed by Device::unitHandle. Each unit has its own due time, so
+// queries go out a few at a time instead of in one burst that overflows the
+// controller queue. The interval adapts per unit: short while its power draw
+// or a relay is moving, longer while it is stable, and backing off
+// exponentially while it does not answer. A unit that pushes its state is
+// only polled as a safety net.
+namespace PollScheduler {
+
+constexpr uint32_t FAST_INTERVAL_MS = 5000;         // power draw is changing
+constexpr uint32_t BASE_INTERVAL_MS = 30000;        // first poll after a restart
+constexpr uint32_t STABLE_INTERVAL_MS = 60000;
+constexpr uint32_t OFFLINE_MAX_INTERVAL_MS = 300000;
+constexpr uint32_t PUSHED_INTERVAL_MS = 600000;
+constexpr uint32_t REPORT_INTERVAL_MS = 300000;
+
+struct Stats {
+    size_t units;
+    float targetPerMinute;      // what the current intervals ask for
+    float achievedPerMinute;    // queries sent over the last report window
+    uint32_t deferred;          // due polls that waited for queue space
+    uint32_t maxLagMs;          // worst send delay past the due time
+};
+
+// Sends the queries that are due, as far as the controller queue takes them
+void loop();
+
+// Spreads every device's next poll across the first few seconds, e.g. after
+// WiFi (re)connects
+void restart();
+
+// `onMask` has bit n set while channel n is on; `watts` is the unit's total
+void onQueryResult(Registry::Handle unit, bool reachable, uint8_t onMask, float watts);
+
+// A control just switched a channel; its draw is about to move
+void onControl(Registry::Handle unit, uint8_t channel, bool isOn);
+
+// A channel pushed its state. Until a poll finds a change that no push
+// reported, the unit is polled every PUSHED_INTERVAL_MS.
+void onPush(Registry::Handle unit, uint8_t channel, bool isOn);
+
+// Forgets a unit's interval and history, e.g. when its device is removed
+void reset(Registry::Handle unit);
+
+Stats getStats();
+
+}
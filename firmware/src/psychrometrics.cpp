@@ -0,0 +1,118 @@
+#include "psychrometrics.h"
+#include <cmath>
+
+namespace Psychrometrics {
+
+namespace {
+    constexpr float MAGNUS_A = 17.27f;
+    constexpr float MAGNUS_B = 237.3f;
+    constexpr float SVP_0C = 0.6108f;        // kPa
+    // Water vapour: grams per m³ per kPa, divided by absolute temperature
+    constexpr float AH_FACTOR = 2166.74f;
+    constexpr float PRESSURE_KPA = 101.325f;
+
+    // Moist air enthalpy from temperature and vapour pressure
+    float enthalpyFrom(float tempC, float vp) {
+        float mixingRatio = 0.622f * vp / (PRESSURE_KPA - vp);
+        return 1.006f * tempC + mixingRatio * (2501.0f + 1.86f * tempC);
+    }
+
+    // SVP in kPa at every whole degree from TABLE_MIN_C to TABLE_MAX_C
+    constexpr size_t TABLE_SIZE = 121;
+    const float SVP_TABLE[TABLE_SIZE] = {
+        0.0184212f, 0.0204554f, 0.0226905f, 0.0251436f, 0.0278336f, 0.0307805f, 0.0340056f, 0.0375321f,
+        0.0413844f, 0.0455889f, 0.0501738f, 0.055169f, 0.0606065f, 0.0665204f, 0.0729471f, 0.0799252f,
+        0.0874958f, 0.0957027f, 0.104592f, 0.114214f, 0.124619f, 0.135864f, 0.148007f, 0.16111f,
+        0.175238f, 0.190462f, 0.206854f, 0.22449f, 0.243454f, 0.263831f, 0.285711f, 0.30919f,
+        0.334367f, 0.361349f, 0.390247f, 0.421176f, 0.45426f, 0.489626f, 0.52741f, 0.567752f,
+        0.6108f, 0.656709f, 0.705641f, 0.757766f, 0.813261f, 0.872311f, 0.935109f, 1.00186f,
+        1.07277f, 1.14806f, 1.22796f, 1.31271f, 1.40256f, 1.49777f, 1.5986f, 1.70535f,
+        1.81829f, 1.93773f, 2.06399f, 2.19739f, 2.33828f, 2.48701f, 2.64393f, 2.80944f,
+        2.98392f, 3.16778f, 3.36144f, 3.56534f, 3.77993f, 4.00568f, 4.24307f, 4.49259f,
+        4.75478f, 5.03015f, 5.31926f, 5.62268f, 5.941f, 6.27482f, 6.62476f, 6.99147f,
+        7.37561f, 7.77787f, 8.19896f, 8.63958f, 9.1005f, 9.58248f, 10.0863f, 10.6128f,
+        11.1628f, 11.7372f, 12.3368f, 12.9625f, 13.6153f, 14.2962f, 15.0061f, 15.746f,
+        16.517f, 17.3201f, 18.1564f, 19.027f, 19.9331f, 20.8759f, 21.8564f, 22.8761f,
+        23.936f, 25.0376f, 26.1821f, 27.3709f, 28.6053f, 29.8868f, 31.2168f, 32.5967f,
+        34.0282f, 35.5126f, 37.0517f, 38.647f, 40.3001f, 42.0127f, 43.7865f, 45.6233f,
+        47.5249f,
+    };
+
+    bool inTable(float tempC) {
+        return tempC >= TABLE_MIN_C && tempC < TABLE_MAX_C;
+    }
+
+    float tableSvp(float tempC) {
+        float x = tempC - TABLE_MIN_C;
+        size_t i = (size_t)x;
+        float frac = x - (float)i;
+        return SVP_TABLE[i] + (SVP_TABLE[i + 1] - SVP_TABLE[i]) * frac;
+    }
+}
+
+float saturationVaporPressure(float tempC) {
+    if (!inTable(tempC)) return Exact::saturationVaporPressure(tempC);
+    return tableSvp(tempC);
+}
+
+float vaporPressureDeficit(float tempC, float rhPercent, float leafOffsetC) {
+    float svpLeaf = saturationVaporPressure(tempC - leafOffsetC);
+    float svpAir = saturationVaporPressure(tempC);
+    return svpLeaf - svpAir * (rhPercent / 100.0f);
+}
+
+float dewPoint(float tempC, float rhPercent) {
+    if (rhPercent <= 0.0f) return NAN;
+    float vp = saturationVaporPressure(tempC) * (rhPercent / 100.0f);
+    if (vp < SVP_TABLE[0] || vp >= SVP_TABLE[TABLE_SIZE - 1]) return Exact::dewPoint(tempC, rhPercent);
+
+    // SVP is monotonic: find the degree whose segment holds vp and invert it
+    size_t lo = 0, hi = TABLE_SIZE - 1;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (SVP_TABLE[mid] <= vp) lo = mid;
+        else hi = mid;
+    }
+    float frac = (vp - SVP_TABLE[lo]) / (SVP_TABLE[hi] - SVP_TABLE[lo]);
+    return TABLE_MIN_C + (float)lo + frac;
+}
+
+float absoluteHumidity(float tempC, float rhPercent) {
+    float vp = saturationVaporPressure(tempC) * (rhPercent / 100.0f);
+    return AH_FACTOR * vp / (tempC + 273.15f);
+}
+
+float enthalpy(float tempC, float rhPercent) {
+    return enthalpyFrom(tempC, saturationVaporPressure(tempC) * (rhPercent / 100.0f));
+}
+
+namespace Exact {
+
+float saturationVaporPressure(float tempC) {
+    return SVP_0C * expf((MAGNUS_A * tempC) / (tempC + MAGNUS_B));
+}
+
+float vaporPressureDeficit(float tempC, float rhPercent, float leafOffsetC) {
+    float svpLeaf = saturationVaporPressure(tempC - leafOffsetC);
+    float svpAir = saturationVaporPressure(tempC);
+    return svpLeaf - svpAir * (rhPercent / 100.0f);
+}
+
+float dewPoint(float tempC, float rhPercent) {
+    if (rhPercent <= 0.0f) return NAN;
+    float gamma = (MAGNUS_A * tempC) / (MAGNUS_B + tempC) + logf(rhPercent / 100.0f);
+    return (MAGNUS_B * gamma) / (MAGNUS_A - gamma);
+}
+
+float absoluteHumidity(float tempC, float rhPercent) {
+    float vp = saturationVaporPressure(tempC) * (rhPercent / 100.0f);
+    return AH_FACTOR * vp / (tempC + 273.15f);
+}
+
+float enthalpy(float tempC, float rhPercent) {
+    return enthalpyFrom(tempC, saturationVaporPressure(tempC) * (rhPercent / 100.0f));
+}
+
+}
+
+}
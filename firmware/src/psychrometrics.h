@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Psychrometric kernels (Magnus-Tetens, a = 17.27, b = 237.3 °C) for the
+// calculated sensors. Saturation vapour pressure comes from a 1 °C table
+// with linear interpolation, so nothing on the per-sample path calls expf or
+// logf; the C3 has no FPU and those cost microseconds each. Inputs outside
+// TABLE_MIN_C..TABLE_MAX_C fall back to the Exact functions.
+//
+// Worst-case error against Exact over the table range, RH 1-100 %, checked
+// by the native benchmark. Interpolation error grows with temperature and
+// peaks near 80 °C; it is well below sensor accuracy everywhere:
+//   saturationVaporPressure   0.01 kPa (< 0.02 % of the value)
+//   vaporPressureDeficit      0.01 kPa
+//   dewPoint                  0.02 °C
+//   absoluteHumidity          0.06 g/m³
+//   enthalpy                  0.5 kJ/kg (< 0.1 % of the value)
+namespace Psychrometrics {
+
+constexpr float TABLE_MIN_C = -40.0f;
+constexpr float TABLE_MAX_C = 80.0f;
+
+// kPa
+float saturationVaporPressure(float tempC);
+// kPa; leaf temperature is air temperature minus leafOffsetC
+float vaporPressureDeficit(float tempC, float rhPercent, float leafOffsetC = 0.0f);
+// °C, NaN for RH <= 0
+float dewPoint(float tempC, float rhPercent);
+// g/m³
+float absoluteHumidity(float tempC, float rhPercent);
+// kJ per kg of dry air, at sea-level pressure
+float enthalpy(float tempC, float rhPercent);
+
+// Closed-form reference implementations
+namespace Exact {
+float saturationVaporPressure(float tempC);
+float vaporPressureDeficit(float tempC, float rhPercent, float leafOffsetC = 0.0f);
+float dewPoint(float tempC, float rhPercent);
+float absoluteHumidity(float tempC, float rhPercent);
+float enthalpy(float tempC, float rhPercent);
+}
+
+}
@@ -0,0 +1,113 @@
+#include "registry.h"
+
+namespace Registry {
+
+namespace {
+    // Open-addressed index, twice the handle count to keep probes short
+    constexpr size_t INDEX_SIZE = MAX_HANDLES * 2;
+
+    char ids[MAX_HANDLES][MAX_ID_LENGTH];
+    uint32_t hashes[MAX_HANDLES];
+    bool used[MAX_HANDLES];
+    bool released[MAX_HANDLES];
+    Handle index[INDEX_SIZE];
+    bool indexReady = false;
+    uint32_t generation = 0;
+
+    void clearIndex() {
+        for (size_t i = 0; i < INDEX_SIZE; i++) index[i] = INVALID_HANDLE;
+        indexReady = true;
+    }
+
+    void insertIndex(Handle handle) {
+        size_t slot = hashes[handle] % INDEX_SIZE;
+        while (index[slot] != INVALID_HANDLE) {
+            slot = (slot + 1) % INDEX_SIZE;
+        }
+        index[slot] = handle;
+    }
+
+    Handle lookup(const char* id, uint32_t h) {
+        if (!indexReady) clearIndex();
+        size_t slot = h % INDEX_SIZE;
+        while (index[slot] != INVALID_HANDLE) {
+            Handle candidate = index[slot];
+            if (hashes[candidate] == h && strcmp(ids[candidate], id) == 0) return candidate;
+            slot = (slot + 1) % INDEX_SIZE;
+        }
+        return INVALID_HANDLE;
+    }
+
+    Handle allocate() {
+        // Never-used handles first, then released ones
+        for (size_t i = 0; i < MAX_HANDLES; i++) {
+            if (!used[i] && !released[i]) return (Handle)i;
+        }
+        for (size_t i = 0; i < MAX_HANDLES; i++) {
+            if (!used[i]) return (Handle)i;
+        }
+        return INVALID_HANDLE;
+    }
+}
+
+uint32_t hash(const char* str) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    while (*str) {
+        h ^= (uint8_t)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+Handle intern(const char* id) {
+    if (!id || id[0] == '\0') return INVALID_HANDLE;
+
+    uint32_t h = hash(id);
+    Handle existing = lookup(id, h);
+    if (existing != INVALID_HANDLE) return existing;
+
+    Handle handle = allocate();
+    if (handle == INVALID_HANDLE) {
+        Serial.printf("[Registry] Handle table full, cannot intern %s\n", id);
+        return INVALID_HANDLE;
+    }
+
+    strlcpy(ids[handle], id, MAX_ID_LENGTH);
+    hashes[handle] = hash(ids[handle]);
+    used[handle] = true;
+    released[handle] = false;
+    insertIndex(handle);
+    generation++;
+    return handle;
+}
+
+Handle find(const char* id) {
+    if (!id || id[0] == '\0') return INVALID_HANDLE;
+    return lookup(id, hash(id));
+}
+
+const char* getId(Handle handle) {
+    if (handle >= MAX_HANDLES || !used[handle]) return nullptr;
+    return ids[handle];
+}
+
+uint32_t getGeneration() {
+    return generation;
+}
+
+void release(Handle handle) {
+    if (handle >= MAX_HANDLES || !used[handle]) return;
+    used[handle] = false;
+    released[handle] = true;
+    ids[handle][0] = '\0';
+    generation++;
+
+    // Linear probing has no cheap delete; rebuild from the remaining handles
+    clearIndex();
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (used[i]) insertIndex((Handle)i);
+    }
+}
+
+}
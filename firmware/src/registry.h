@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Interns sensor and device IDs into small integer handles. IDs are interned
+// when config loads; per-tick paths index dense arrays by handle instead of
+// looking up strings.
+namespace Registry {
+
+using Handle = uint16_t;
+
+// Sensors and devices share the table: room for 100+ plugs next to a full
+// sensor setup. Every per-handle array scales with it.
+constexpr Handle INVALID_HANDLE = 0xFFFF;
+constexpr size_t MAX_HANDLES = 160;
+constexpr size_t MAX_ID_LENGTH = 24;   // matches Sensor::id / Device::id
+
+// Returns the existing handle for `id` or assigns a new one.
+// INVALID_HANDLE when the id is empty or the table is full.
+Handle intern(const char* id);
+
+// Lookup only; INVALID_HANDLE when `id` was never interned.
+Handle find(const char* id);
+
+// The interned id, or nullptr for a free handle.
+const char* getId(Handle handle);
+
+// Frees a handle once its sensor/device is removed. Released handles are
+// only reused after every fresh handle has been handed out, so per-handle
+// state left behind by a removed id is not picked up by a new one.
+void release(Handle handle);
+
+// Bumped whenever a handle is assigned or released, so callers caching
+// handles resolved from ids know when to resolve them again.
+uint32_t getGeneration();
+
+uint32_t hash(const char* str);
+
+// Latest value per handle, NaN where there is none.
+struct Readings {
+    float values[MAX_HANDLES];
+
+    Readings() { clear(); }
+
+    void clear() {
+        for (size_t i = 0; i < MAX_HANDLES; i++) values[i] = NAN;
+    }
+
+    float get(Handle handle) const {
+        return handle < MAX_HANDLES ? values[handle] : NAN;
+    }
+
+    void set(Handle handle, float value) {
+        if (handle < MAX_HANDLES) values[handle] = value;
+    }
+};
+
+}
@@ -0,0 +1,154 @@
+#include "rule_engine.h"
+#include "devices.h"
+#include "time_utils.h"
+
+namespace RuleEngine {
+
+namespace {
+    bool emit(Program& program, const Node& node) {
+        if (program.count >= MAX_NODES) return false;
+        program.nodes[program.count++] = node;
+        return true;
+    }
+
+    // Operands first, so the program runs front to back
+    bool compileNode(JsonVariantConst expr, Program& program, uint8_t depth) {
+        if (depth >= MAX_DEPTH || !expr.is<JsonObjectConst>()) return false;
+        JsonObjectConst obj = expr.as<JsonObjectConst>();
+        Node node = {};
+
+        if (obj["and"].is<JsonArrayConst>() || obj["or"].is<JsonArrayConst>()) {
+            bool isAnd = obj["and"].is<JsonArrayConst>();
+            JsonArrayConst operands = obj[isAnd ? "and" : "or"].as<JsonArrayConst>();
+            if (operands.size() == 0) return false;
+            for (JsonVariantConst operand : operands) {
+                if (!compileNode(operand, program, depth + 1)) return false;
+            }
+            node.op = isAnd ? Op::AND : Op::OR;
+            node.count = operands.size();
+        } else if (!obj["not"].isNull()) {
+            if (!compileNode(obj["not"], program, depth + 1)) return false;
+            node.op = Op::NOT;
+        } else if (obj["sensorId"].is<const char*>()) {
+            node.op = Op::SENSOR;
+            node.handle = Registry::find(obj["sensorId"]);
+            node.flag = obj["triggerAbove"] | true;
+            node.threshold.day = obj["dayThreshold"] | 0.0f;
+            node.threshold.night = obj["nightThreshold"] | node.threshold.day;
+            node.threshold.deadzone = obj["deadzone"] | 0.5f;
+        } else if (obj["startTime"].is<const char*>()) {
+            node.op = Op::TIME_WINDOW;
+            node.window.start = TimeUtils::parseTimeToMinutes(obj["startTime"]);
+            node.window.end = TimeUtils::parseTimeToMinutes(obj["endTime"] | "00:00");
+        } else if (obj["daytime"].is<bool>()) {
+            node.op = Op::DAYTIME;
+            node.flag = obj["daytime"];
+        } else if (obj["deviceId"].is<const char*>()) {
+            node.op = Op::DEVICE_ON;
+            node.handle = Registry::find(obj["deviceId"]);
+            node.flag = obj["isOn"] | true;
+        } else if (obj["onDurationSec"].is<uint32_t>()) {
+            node.op = Op::CYCLE;
+            node.cycle.onSec = max(obj["onDurationSec"].as<uint32_t>(), (uint32_t)1);
+            node.cycle.offSec = max(obj["offDurationSec"] | (uint32_t)0, (uint32_t)1);
+        } else {
+            return false;
+        }
+        return emit(program, node);
+    }
+}
+
+bool compile(JsonVariantConst expr, Program& program) {
+    program = Program{};
+    if (compileNode(expr, program, 0)) return true;
+    program = Program{};
+    return false;
+}
+
+Result evaluate(const Program& program, const Context& context) {
+    Result result = {false, -1, NAN, NAN, 0};
+    uint32_t stack = 0;             // top of stack in bit 0
+
+    for (uint8_t i = 0; i < program.count; i++) {
+        const Node& node = program.nodes[i];
+        bool value = false;
+
+        switch (node.op) {
+            case Op::SENSOR: {
+                float reading = context.readings->get(node.handle);
+                if (isnan(reading)) break;
+                float threshold = context.daytime ? node.threshold.day : node.threshold.night;
+                float deadzone = node.threshold.deadzone;
+                // Tighter while unmet, looser while met, so a reading near the threshold cannot flap
+                bool wasMet = context.sensorsMet & (1U << i);
+                float effective = wasMet
+                    ? (node.flag ? threshold - deadzone : threshold + deadzone)
+                    : (node.flag ? threshold + deadzone : threshold - deadzone);
+                value = node.flag ? reading > effective : reading < effective;
+                if (value) result.sensorsMet |= 1U << i;
+
+                // The last met sensor explains the result, else the first with a reading
+                if (value || result.report < 0) {
+                    result.report = i;
+                    result.reportValue = reading;
+                    result.reportThreshold = threshold;
+                }
+                break;
+            }
+            case Op::TIME_WINDOW:
+                value = TimeUtils::isMinuteInRange(context.minuteOfDay, node.window.start, node.window.end);
+                break;
+            case Op::DAYTIME:
+                value = context.daytime == node.flag;
+                break;
+            case Op::DEVICE_ON: {
+                Devices::Device* device = Devices::getDevice(node.handle);
+                value = device && device->isOn == node.flag;
+                break;
+            }
+            case Op::CYCLE: {
+                uint32_t period = node.cycle.onSec + node.cycle.offSec;
+                value = (context.nowMs - context.anchorMs) / 1000 % period < node.cycle.onSec;
+                break;
+            }
+            case Op::AND:
+            case Op::OR: {
+                uint32_t mask = (1UL << node.count) - 1;
+                uint32_t operands = stack & mask;
+                stack >>= node.count;
+                value = node.op == Op::AND ? operands == mask : operands != 0;
+                break;
+            }
+            case Op::NOT:
+                value = !(stack & 1);
+                stack >>= 1;
+                break;
+        }
+        stack = (stack << 1) | value;
+    }
+
+    result.value = program.count > 0 && (stack & 1);
+    return result;
+}
+
+uint32_t msUntilChange(const Program& program, const Context& context) {
+    uint32_t soonest = NO_DEADLINE;
+
+    for (uint8_t i = 0; i < program.count; i++) {
+        const Node& node = program.nodes[i];
+        if (node.op == Op::TIME_WINDOW && context.minuteOfDay >= 0) {
+            for (uint16_t edge : {node.window.start, node.window.end}) {
+                int32_t seconds = TimeUtils::secondsUntilMinute(edge);
+                if (seconds >= 0) soonest = min(soonest, (uint32_t)seconds * 1000);
+            }
+        } else if (node.op == Op::CYCLE) {
+            uint32_t onMs = node.cycle.onSec * 1000;
+            uint32_t periodMs = onMs + node.cycle.offSec * 1000;
+            uint32_t phase = (context.nowMs - context.anchorMs) % periodMs;
+            soonest = min(soonest, phase < onMs ? onMs - phase : periodMs - phase);
+        }
+    }
+    return soonest;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "registry.h"
+
+// Compiles automation expressions into a flat postfix program, evaluated in
+// one pass over its nodes with a bit stack: no recursion, no allocation.
+// An expression is a JSON tree whose leaves reuse the device mode keys:
+//
+//   {"and": [a, b, ...]}  {"or": [a, b, ...]}  {"not": a}
+//   {"sensorId": "t_canopy", "dayThreshold": 26, "nightThreshold": 22,
+//    "deadzone": 0.5, "triggerAbove": true}
+//   {"startTime": "06:00", "endTime": "22:00"}
+//   {"daytime": true}
+//   {"deviceId": "heater", "isOn": false}
+//   {"onDurationSec": 60, "offDurationSec": 600}
+//
+// Each threshold holds with hysteresis around its own last result: once met,
+// a triggerAbove leaf stays met until the value drops `deadzone` below the
+// threshold, whatever `not`/`and`/`or` make of it. A missing reading is
+// never met.
+namespace RuleEngine {
+
+constexpr uint8_t MAX_NODES = 16;    // one bit each in sensorsMet
+constexpr uint8_t MAX_DEPTH = 6;     // nesting levels
+constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+enum class Op : uint8_t {
+    SENSOR,
+    TIME_WINDOW,
+    DAYTIME,
+    DEVICE_ON,
+    CYCLE,
+    AND,
+    OR,
+    NOT,
+};
+
+struct Node {
+    Op op;
+    uint8_t count;              // AND/OR: operands on the stack
+    bool flag;                  // SENSOR: above; DAYTIME: day; DEVICE_ON: on
+    Registry::Handle handle;    // SENSOR: sensor; DEVICE_ON: device
+    union {
+        struct { float day, night, deadzone; } threshold;
+        struct { uint16_t start, end; } window;         // minutes since midnight
+        struct { uint32_t onSec, offSec; } cycle;
+    };
+};
+
+struct Program {
+    Node nodes[MAX_NODES];
+    uint8_t count;
+};
+
+struct Context {
+    const Registry::Readings* readings;
+    bool daytime;
+    int minuteOfDay;            // -1 until the clock is synced
+    unsigned long nowMs;
+    unsigned long anchorMs;     // cycle phase starts here
+    uint16_t sensorsMet;        // bit per SENSOR node met last time, for hysteresis
+};
+static_assert(MAX_NODES <= 16, "sensorsMet holds one bit per node");
+
+struct Result {
+    bool value;
+    int8_t report;              // sensor node that decided it, -1 for none
+    float reportValue;
+    float reportThreshold;
+    uint16_t sensorsMet;        // to pass back in on the next evaluation
+};
+
+// False when the expression is malformed or too large; `program` is then empty
+bool compile(JsonVariantConst expr, Program& program);
+
+Result evaluate(const Program& program, const Context& context);
+
+// Milliseconds until a time window or cycle in the program next changes
+// value; NO_DEADLINE when none does. Readings, day/night and device states
+// are not covered: their changes arrive as events.
+uint32_t msUntilChange(const Program& program, const Context& context);
+
+}
@@ -1,6 +1,8 @@
 #include "sensor_config.h"
 #include "storage.h"
 #include "history.h"
+#include "change_set.h"
+#include <algorithm>
 #include <vector>
 
 namespace SensorConfig {
@@ -9,6 +11,47 @@ namespace {
     const char* SENSORS_PATH = "/sensors.json";
     std::vector<Sensor> sensors;
     std::vector<const char*> sensorIdPtrs;
+    int16_t indexByHandle[Registry::MAX_HANDLES];
+    uint32_t revision = 0;
+    ChangeSet changes;
+
+    void clampSampling(Sensor& sensor) {
+        sensor.sampleIntervalMs = constrain(sensor.sampleIntervalMs, MIN_SAMPLE_INTERVAL_MS, MAX_SAMPLE_INTERVAL_MS);
+        sensor.oversample = constrain(sensor.oversample, (uint8_t)1, MAX_OVERSAMPLE);
+        sensor.smoothing = isnan(sensor.smoothing) ? 0.0f : constrain(sensor.smoothing, 0.0f, MAX_SMOOTHING);
+    }
+
+    void readSampling(Sensor& sensor, JsonVariantConst obj) {
+        sensor.sampleIntervalMs = obj["sampleIntervalMs"] | DEFAULT_SAMPLE_INTERVAL_MS;
+        sensor.oversample = obj["oversample"] | (uint8_t)1;
+        sensor.smoothing = obj["smoothing"] | 0.0f;
+        clampSampling(sensor);
+    }
+
+    void readGroup(Sensor& sensor, JsonVariantConst obj) {
+        strlcpy(sensor.aggregate, obj["aggregate"] | "", sizeof(sensor.aggregate));
+        size_t n = 0;
+        for (JsonVariantConst id : obj["sourceIds"].as<JsonArrayConst>()) {
+            if (n == MAX_GROUP_SOURCES) break;
+            strlcpy(sensor.sourceIds[n++], id | "", sizeof(sensor.sourceIds[0]));
+        }
+        for (; n < MAX_GROUP_SOURCES; n++) sensor.sourceIds[n][0] = '\0';
+    }
+
+    void writeGroup(JsonObject obj, const Sensor& sensor) {
+        if (sensor.aggregate[0] == '\0') return;
+        obj["aggregate"] = sensor.aggregate;
+        JsonArray ids = obj["sourceIds"].to<JsonArray>();
+        for (const auto& id : sensor.sourceIds) {
+            if (id[0] != '\0') ids.add(id);
+        }
+    }
+
+    void writeSampling(JsonObject obj, const Sensor& sensor) {
+        if (sensor.sampleIntervalMs != DEFAULT_SAMPLE_INTERVAL_MS) obj["sampleIntervalMs"] = sensor.sampleIntervalMs;
+        if (sensor.oversample != 1) obj["oversample"] = sensor.oversample;
+        if (sensor.smoothing != 0.0f) obj["smoothing"] = sensor.smoothing;
+    }
     
     void saveConfig() {
         JsonDocument doc;
@@ -25,17 +68,45 @@ namespace {
             if (sensor.tempSourceId[0] != '\0') obj["tempSourceId"] = sensor.tempSourceId;
             if (sensor.humSourceId[0] != '\0') obj["humSourceId"] = sensor.humSourceId;
             if (sensor.leafTempOffset != 0.0f) obj["leafTempOffset"] = sensor.leafTempOffset;
+            writeGroup(obj, sensor);
+            writeSampling(obj, sensor);
         }
         
         Storage::writeJson(SENSORS_PATH, doc);
         Serial.printf("[SensorConfig] Saved %d sensors\n", sensors.size());
     }
     
-    void loadConfig() {
-        sensors.clear();
+    // Ids a reload dropped (e.g. a restore) give back their handles and
+    // history; the caller clears its own per-handle state first
+    void releaseDropped(const std::vector<Sensor>& previous, void (*onDropped)(Registry::Handle)) {
+        for (const auto& old : previous) {
+            if (old.handle == Registry::INVALID_HANDLE) continue;
+            bool kept = false;
+            for (const auto& sensor : sensors) {
+                if (strcmp(sensor.id, old.id) == 0) kept = true;
+            }
+            if (kept) continue;
+            if (onDropped) onDropped(old.handle);
+            History::removeSensor(old.id);
+            Registry::release(old.handle);
+        }
+    }
+
+    void dropUnhandled() {
+        sensors.erase(std::remove_if(sensors.begin(), sensors.end(), [](const Sensor& sensor) {
+            if (Registry::intern(sensor.id) != Registry::INVALID_HANDLE) return false;
+            Serial.printf("[SensorConfig] No handle for %s, skipped\n", sensor.id);
+            return true;
+        }), sensors.end());
+    }
+
+    void loadConfig(void (*onDropped)(Registry::Handle)) {
+        std::vector<Sensor> previous;
+        previous.swap(sensors);
         JsonDocument doc;
         if (!Storage::readJson(SENSORS_PATH, doc)) {
             Serial.println("[SensorConfig] No sensors file found");
+            releaseDropped(previous, onDropped);
             return;
         }
         
@@ -51,24 +122,60 @@ namespace {
             strlcpy(sensor.tempSourceId, obj["tempSourceId"] | "", sizeof(sensor.tempSourceId));
             strlcpy(sensor.humSourceId, obj["humSourceId"] | "", sizeof(sensor.humSourceId));
             sensor.leafTempOffset = obj["leafTempOffset"] | 0.0f;
+            readGroup(sensor, obj);
+            readSampling(sensor, obj);
             
             sensors.push_back(sensor);
         }
         
+        releaseDropped(previous, onDropped);
+        dropUnhandled();
         Serial.printf("[SensorConfig] Loaded %d sensors\n", sensors.size());
     }
     
-    void updateIdPtrs() {
+    void rebuildIndex() {
         sensorIdPtrs.clear();
-        for (auto& sensor : sensors) {
+        memset(indexByHandle, -1, sizeof(indexByHandle));
+
+        for (size_t i = 0; i < sensors.size(); i++) {
+            Sensor& sensor = sensors[i];
             sensorIdPtrs.push_back(sensor.id);
+            sensor.handle = Registry::intern(sensor.id);
+            // First sensor wins for duplicate ids, like a linear scan would
+            if (sensor.handle != Registry::INVALID_HANDLE && indexByHandle[sensor.handle] < 0) {
+                indexByHandle[sensor.handle] = (int16_t)i;
+            }
         }
+
+        // Sources resolve after every id is interned; they may point forward
+        for (auto& sensor : sensors) {
+            sensor.tempSource = Registry::find(sensor.tempSourceId);
+            sensor.humSource = Registry::find(sensor.humSourceId);
+            for (size_t i = 0; i < MAX_GROUP_SOURCES; i++) {
+                sensor.sources[i] = Registry::find(sensor.sourceIds[i]);
+            }
+        }
+        revision++;
+    }
+
+    void writeSensorJson(JsonObject obj, const Sensor& sensor) {
+        obj["id"] = sensor.id;
+        obj["name"] = sensor.name;
+        obj["type"] = sensor.type;
+        obj["unit"] = sensor.unit;
+        obj["hardwareType"] = sensor.hardwareType;
+        if (sensor.address[0] != '\0') obj["address"] = sensor.address;
+        if (sensor.tempSourceId[0] != '\0') obj["tempSourceId"] = sensor.tempSourceId;
+        if (sensor.humSourceId[0] != '\0') obj["humSourceId"] = sensor.humSourceId;
+        if (sensor.leafTempOffset != 0.0f) obj["leafTempOffset"] = sensor.leafTempOffset;
+        writeGroup(obj, sensor);
+        writeSampling(obj, sensor);
     }
 }
 
-void init() {
-    loadConfig();
-    updateIdPtrs();
+void init(void (*onDropped)(Registry::Handle)) {
+    loadConfig(onDropped);
+    rebuildIndex();
     Serial.println("[SensorConfig] Initialized");
 }
 
@@ -83,10 +190,18 @@ bool addSensor(JsonDocument& doc) {
     strlcpy(sensor.tempSourceId, doc["tempSourceId"] | "", sizeof(sensor.tempSourceId));
     strlcpy(sensor.humSourceId, doc["humSourceId"] | "", sizeof(sensor.humSourceId));
     sensor.leafTempOffset = doc["leafTempOffset"] | 0.0f;
+    readGroup(sensor, doc.as<JsonVariantConst>());
+    readSampling(sensor, doc.as<JsonVariantConst>());
+
+    if (Registry::intern(sensor.id) == Registry::INVALID_HANDLE) {
+        Serial.printf("[SensorConfig] No handle for %s, not added\n", sensor.id);
+        return false;
+    }
     
     sensors.push_back(sensor);
-    updateIdPtrs();
+    rebuildIndex();
     saveConfig();
+    changes.mark(sensors.back().handle);
     
     Serial.printf("[SensorConfig] Added sensor: %s\n", sensor.name);
     return true;
@@ -103,8 +218,15 @@ bool updateSensor(const char* sensorId, JsonDocument& doc) {
             if (doc["tempSourceId"].is<const char*>()) strlcpy(sensor.tempSourceId, doc["tempSourceId"], sizeof(sensor.tempSourceId));
             if (doc["humSourceId"].is<const char*>()) strlcpy(sensor.humSourceId, doc["humSourceId"], sizeof(sensor.humSourceId));
             if (doc["leafTempOffset"].is<float>()) sensor.leafTempOffset = doc["leafTempOffset"];
+            if (doc["aggregate"].is<const char*>()) readGroup(sensor, doc.as<JsonVariantConst>());
+            if (doc["sampleIntervalMs"].is<uint32_t>()) sensor.sampleIntervalMs = doc["sampleIntervalMs"];
+            if (doc["oversample"].is<int>()) sensor.oversample = constrain(doc["oversample"].as<int>(), 1, (int)MAX_OVERSAMPLE);
+            if (doc["smoothing"].is<float>()) sensor.smoothing = doc["smoothing"];
+            clampSampling(sensor);
             
+            rebuildIndex();
             saveConfig();
+            changes.mark(sensor.handle);
             Serial.printf("[SensorConfig] Updated sensor: %s\n", sensor.name);
             return true;
         }
@@ -117,8 +239,10 @@ bool removeSensor(const char* sensorId) {
         if (strcmp(it->id, sensorId) == 0) {
             Serial.printf("[SensorConfig] Removed sensor: %s\n", it->name);
             History::removeSensor(sensorId);
+            changes.markRemoved(it->handle, it->id);
+            Registry::release(it->handle);
             sensors.erase(it);
-            updateIdPtrs();
+            rebuildIndex();
             saveConfig();
             return true;
         }
@@ -126,33 +250,38 @@ bool removeSensor(const char* sensorId) {
     return false;
 }
 
-void getSensorsJson(String& out) {
-    JsonDocument doc;
-    JsonArray arr = doc.to<JsonArray>();
-    
+void getSensorsJson(JsonVariant out) {
+    JsonArray arr = out.to<JsonArray>();
     for (const auto& sensor : sensors) {
-        JsonObject obj = arr.add<JsonObject>();
-        obj["id"] = sensor.id;
-        obj["name"] = sensor.name;
-        obj["type"] = sensor.type;
-        obj["unit"] = sensor.unit;
-        obj["hardwareType"] = sensor.hardwareType;
-        if (sensor.address[0] != '\0') obj["address"] = sensor.address;
-        if (sensor.tempSourceId[0] != '\0') obj["tempSourceId"] = sensor.tempSourceId;
-        if (sensor.humSourceId[0] != '\0') obj["humSourceId"] = sensor.humSourceId;
-        if (sensor.leafTempOffset != 0.0f) obj["leafTempOffset"] = sensor.leafTempOffset;
+        writeSensorJson(arr.add<JsonObject>(), sensor);
     }
-    
-    serializeJson(doc, out);
+}
+
+uint32_t getVersion() {
+    return changes.version;
+}
+
+bool takeChanges(JsonObject data) {
+    bool written = changes.writeDelta(data, [](JsonArray upsert, Registry::Handle handle) {
+        const Sensor* sensor = getSensor(handle);
+        if (sensor) writeSensorJson(upsert.add<JsonObject>(), *sensor);
+    });
+    changes.clear();
+    return written;
 }
 
 Sensor* getSensor(const char* sensorId) {
-    for (auto& sensor : sensors) {
-        if (strcmp(sensor.id, sensorId) == 0) {
-            return &sensor;
-        }
-    }
-    return nullptr;
+    return getSensor(Registry::find(sensorId));
+}
+
+Sensor* getSensor(Registry::Handle handle) {
+    if (handle >= Registry::MAX_HANDLES || indexByHandle[handle] < 0) return nullptr;
+    return &sensors[indexByHandle[handle]];
+}
+
+Sensor* getSensorByIndex(size_t index) {
+    if (index >= sensors.size()) return nullptr;
+    return &sensors[index];
 }
 
 size_t getSensorCount() {
@@ -164,4 +293,8 @@ const char** getSensorIds(size_t& count) {
     return sensorIdPtrs.data();
 }
 
+uint32_t getRevision() {
+    return revision;
+}
+
 }
@@ -2,9 +2,17 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "registry.h"
 
 namespace SensorConfig {
 
+constexpr uint32_t DEFAULT_SAMPLE_INTERVAL_MS = 5000;
+constexpr uint32_t MIN_SAMPLE_INTERVAL_MS = 1000;
+constexpr uint32_t MAX_SAMPLE_INTERVAL_MS = 3600000;
+constexpr uint8_t MAX_OVERSAMPLE = 8;
+constexpr float MAX_SMOOTHING = 0.95f;
+constexpr size_t MAX_GROUP_SOURCES = 4;
+
 struct Sensor {
     char id[24];
     char name[32];
@@ -15,17 +23,44 @@ struct Sensor {
     char tempSourceId[24];
     char humSourceId[24];
     float leafTempOffset;   // VPD leaf temperature offset (°C below air temp, default 0)
+    uint32_t sampleIntervalMs;  // one filtered value per interval
+    uint8_t oversample;         // raw samples per interval, reduced to their median (1 = off)
+    float smoothing;            // EMA weight kept from the previous value (0 = off)
+    // Group sensors ("calculated" with an aggregate): "avg", "min" or "max"
+    // over sourceIds, which share this sensor's type
+    char aggregate[4];
+    char sourceIds[MAX_GROUP_SOURCES][24];
+
+    // Resolved from the ids above whenever the sensor list changes
+    Registry::Handle handle;
+    Registry::Handle tempSource;
+    Registry::Handle humSource;
+    Registry::Handle sources[MAX_GROUP_SOURCES];
 };
 
-void init();
+// Also reloads after a restore: `onDropped` sees each handle whose id is
+// gone, before the handle is released for reuse
+void init(void (*onDropped)(Registry::Handle handle) = nullptr);
 
 bool addSensor(JsonDocument& doc);
 bool updateSensor(const char* sensorId, JsonDocument& doc);
 bool removeSensor(const char* sensorId);
 
-void getSensorsJson(String& out);
+void getSensorsJson(JsonVariant out);
+
+// Sensors added, updated or removed since the last takeChanges(), which
+// writes {"upsert", "remove"} and is false when the full list must be sent
+uint32_t getVersion();
+bool takeChanges(JsonObject data);
+
 Sensor* getSensor(const char* sensorId);
+Sensor* getSensor(Registry::Handle handle);
+Sensor* getSensorByIndex(size_t index);
 size_t getSensorCount();
 const char** getSensorIds(size_t& count);
 
+// Bumped on every add/update/remove so callers can cache lookups derived
+// from the sensor list (e.g. the first light sensor).
+uint32_t getRevision();
+
 }
@@ -0,0 +1,238 @@
+#include "sensor_graph.h"
+#include "sensor_config.h"
+#include "psychrometrics.h"
+#include <vector>
+
+namespace SensorGraph {
+
+namespace {
+    enum Op : uint8_t {
+        OP_NONE,                // unsupported or part of a cycle: always NaN
+        OP_SHT3X_TEMPERATURE,
+        OP_SHT3X_HUMIDITY,
+        OP_SHT4X_TEMPERATURE,
+        OP_SHT4X_HUMIDITY,
+        OP_SCD4X_TEMPERATURE,
+        OP_SCD4X_HUMIDITY,
+        OP_SCD4X_CO2,
+        OP_AS7341_LIGHT,
+        OP_VPD,
+        OP_DEWPOINT,
+        OP_ABSOLUTE_HUMIDITY,
+        OP_ENTHALPY,
+        OP_AVERAGE,
+        OP_MIN,
+        OP_MAX
+    };
+
+    struct Node {
+        Registry::Handle handle;
+        Op op;
+        uint8_t inputCount;
+        uint8_t parts;          // bit per hardware part (PARTS) the value reads from
+        Registry::Handle inputs[SensorConfig::MAX_GROUP_SOURCES];
+        float leafOffset;
+    };
+
+    const char* const PARTS[] = {"sht3x", "sht4x", "scd4x", "as7341"};
+
+    struct Leaf {
+        const char* type;
+        Op op;
+    };
+
+    // Indexed like PARTS
+    const Leaf LEAVES[][3] = {
+        {{"temperature", OP_SHT3X_TEMPERATURE}, {"humidity", OP_SHT3X_HUMIDITY}, {nullptr, OP_NONE}},
+        {{"temperature", OP_SHT4X_TEMPERATURE}, {"humidity", OP_SHT4X_HUMIDITY}, {nullptr, OP_NONE}},
+        {{"temperature", OP_SCD4X_TEMPERATURE}, {"humidity", OP_SCD4X_HUMIDITY}, {"co2", OP_SCD4X_CO2}},
+        {{"light", OP_AS7341_LIGHT}, {nullptr, OP_NONE}, {nullptr, OP_NONE}},
+    };
+
+    const Leaf DERIVED[] = {
+        {"vpd", OP_VPD},
+        {"dewpoint", OP_DEWPOINT},
+        {"absolute_humidity", OP_ABSOLUTE_HUMIDITY},
+        {"enthalpy", OP_ENTHALPY},
+    };
+
+    const Leaf AGGREGATES[] = {
+        {"avg", OP_AVERAGE},
+        {"min", OP_MIN},
+        {"max", OP_MAX},
+    };
+
+    enum Mark : uint8_t { UNVISITED, VISITING, DONE };
+
+    std::vector<Node> program;              // topological order
+    int16_t nodeByHandle[Registry::MAX_HANDLES];
+    Mark marks[Registry::MAX_HANDLES];
+    uint32_t compiledRevision = 0;
+    bool compiled = false;
+
+    Registry::Readings values;
+    uint32_t cachedRound = 0;
+    bool cacheValid = false;
+
+    Op findOp(const Leaf* table, size_t count, const char* name) {
+        for (size_t i = 0; i < count; i++) {
+            if (table[i].type && strcmp(table[i].type, name) == 0) return table[i].op;
+        }
+        return OP_NONE;
+    }
+
+    void buildNode(const SensorConfig::Sensor& cfg, Node& node) {
+        node = {};
+        node.handle = cfg.handle;
+        node.leafOffset = cfg.leafTempOffset;
+
+        for (size_t p = 0; p < sizeof(PARTS) / sizeof(PARTS[0]); p++) {
+            if (strcmp(cfg.hardwareType, PARTS[p]) == 0) {
+                node.op = findOp(LEAVES[p], 3, cfg.type);
+                node.parts = 1 << p;
+                return;
+            }
+        }
+        if (strcmp(cfg.hardwareType, "calculated") != 0) return;
+
+        if (cfg.aggregate[0] != '\0') {
+            node.op = findOp(AGGREGATES, sizeof(AGGREGATES) / sizeof(AGGREGATES[0]), cfg.aggregate);
+            for (Registry::Handle source : cfg.sources) {
+                if (source != Registry::INVALID_HANDLE) node.inputs[node.inputCount++] = source;
+            }
+            return;
+        }
+
+        node.op = findOp(DERIVED, sizeof(DERIVED) / sizeof(DERIVED[0]), cfg.type);
+        node.inputs[0] = cfg.tempSource;
+        node.inputs[1] = cfg.humSource;
+        node.inputCount = 2;
+    }
+
+    // Depth-first post-order: a node is appended after all of its inputs
+    bool visit(Registry::Handle handle) {
+        if (handle >= Registry::MAX_HANDLES) return true;
+        if (marks[handle] == DONE) return true;
+        if (marks[handle] == VISITING) return false;
+
+        SensorConfig::Sensor* cfg = SensorConfig::getSensor(handle);
+        if (!cfg) {
+            marks[handle] = DONE;
+            return true;
+        }
+
+        marks[handle] = VISITING;
+        Node node;
+        buildNode(*cfg, node);
+        for (uint8_t i = 0; i < node.inputCount; i++) {
+            if (!visit(node.inputs[i])) {
+                Serial.printf("[SensorGraph] Cycle through %s, value disabled\n", cfg->id);
+                node.op = OP_NONE;
+            }
+            int16_t input = node.inputs[i] < Registry::MAX_HANDLES ? nodeByHandle[node.inputs[i]] : -1;
+            if (input >= 0) node.parts |= program[input].parts;
+        }
+        marks[handle] = DONE;
+
+        nodeByHandle[handle] = (int16_t)program.size();
+        program.push_back(node);
+        return true;
+    }
+
+    void compile() {
+        if (compiled && compiledRevision == SensorConfig::getRevision()) return;
+        compiledRevision = SensorConfig::getRevision();
+        compiled = true;
+        cacheValid = false;
+
+        program.clear();
+        memset(nodeByHandle, -1, sizeof(nodeByHandle));
+        memset(marks, UNVISITED, sizeof(marks));
+
+        size_t count = SensorConfig::getSensorCount();
+        program.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            visit(SensorConfig::getSensorByIndex(i)->handle);
+        }
+    }
+
+    float aggregate(const Node& node) {
+        float result = NAN;
+        uint8_t valid = 0;
+        for (uint8_t i = 0; i < node.inputCount; i++) {
+            float v = values.get(node.inputs[i]);
+            if (isnan(v)) continue;
+            if (valid++ == 0) {
+                result = v;
+            } else if (node.op == OP_AVERAGE) {
+                result += v;
+            } else if (node.op == OP_MIN) {
+                result = min(result, v);
+            } else {
+                result = max(result, v);
+            }
+        }
+        if (node.op == OP_AVERAGE && valid > 0) result /= valid;
+        return result;
+    }
+
+    float compute(const Node& node, const Sensors::Snapshot& snapshot, float ppfdFactor) {
+        switch (node.op) {
+            case OP_SHT3X_TEMPERATURE: return snapshot.sht3x.valid ? snapshot.sht3x.temperature : NAN;
+            case OP_SHT3X_HUMIDITY:    return snapshot.sht3x.valid ? snapshot.sht3x.humidity : NAN;
+            case OP_SHT4X_TEMPERATURE: return snapshot.sht4x.valid ? snapshot.sht4x.temperature : NAN;
+            case OP_SHT4X_HUMIDITY:    return snapshot.sht4x.valid ? snapshot.sht4x.humidity : NAN;
+            case OP_SCD4X_TEMPERATURE: return snapshot.scd4x.valid ? snapshot.scd4x.temperature : NAN;
+            case OP_SCD4X_HUMIDITY:    return snapshot.scd4x.valid ? snapshot.scd4x.humidity : NAN;
+            case OP_SCD4X_CO2:         return snapshot.scd4x.valid ? (float)snapshot.scd4x.co2 : NAN;
+            case OP_AS7341_LIGHT:      return snapshot.as7341.valid ? snapshot.as7341.rawPpfd * ppfdFactor : NAN;
+
+            case OP_VPD:
+            case OP_DEWPOINT:
+            case OP_ABSOLUTE_HUMIDITY:
+            case OP_ENTHALPY: {
+                float temp = values.get(node.inputs[0]);
+                float hum = values.get(node.inputs[1]);
+                if (isnan(temp) || isnan(hum) || hum <= 0) return NAN;
+                if (node.op == OP_VPD) return Psychrometrics::vaporPressureDeficit(temp, hum, node.leafOffset);
+                if (node.op == OP_DEWPOINT) return Psychrometrics::dewPoint(temp, hum);
+                if (node.op == OP_ABSOLUTE_HUMIDITY) return Psychrometrics::absoluteHumidity(temp, hum);
+                return Psychrometrics::enthalpy(temp, hum);
+            }
+
+            case OP_AVERAGE:
+            case OP_MIN:
+            case OP_MAX:
+                return aggregate(node);
+
+            default:
+                return NAN;
+        }
+    }
+}
+
+const Registry::Readings& evaluate(const Sensors::Snapshot& snapshot) {
+    compile();
+    if (cacheValid && cachedRound == snapshot.round) return values;
+
+    values.clear();
+    float ppfdFactor = Sensors::getPpfdCalibrationFactor();
+    for (const Node& node : program) {
+        values.set(node.handle, compute(node, snapshot, ppfdFactor));
+    }
+
+    cachedRound = snapshot.round;
+    cacheValid = true;
+    return values;
+}
+
+bool readsFrom(Registry::Handle handle, const char* hardwareType) {
+    compile();
+    if (handle >= Registry::MAX_HANDLES || nodeByHandle[handle] < 0) return false;
+    for (size_t p = 0; p < sizeof(PARTS) / sizeof(PARTS[0]); p++) {
+        if (strcmp(PARTS[p], hardwareType) == 0) return program[nodeByHandle[handle]].parts & (1 << p);
+    }
+    return false;
+}
+
+}
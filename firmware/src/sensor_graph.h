@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include "registry.h"
+#include "sensors.h"
+
+// Values of every configured sensor. The sensor list is compiled into a
+// dependency graph whenever SensorConfig changes: hardware sensors are
+// leaves, calculated sensors (VPD, dew point, absolute humidity, enthalpy
+// and avg/min/max groups) are nodes over their sources. Each acquisition
+// round is evaluated once, in topological order, and cached.
+namespace SensorGraph {
+
+// Values for `snapshot`, NaN where a sensor has none. Computed on the first
+// call per round; later calls return the cached result.
+const Registry::Readings& evaluate(const Sensors::Snapshot& snapshot);
+
+// True when `handle`'s value depends on a sensor on `hardwareType`,
+// directly or through calculated sources.
+bool readsFrom(Registry::Handle handle, const char* hardwareType);
+
+}
@@ -0,0 +1,86 @@
+#include "sensor_sampler.h"
+#include "sensor_config.h"
+#include "sensor_graph.h"
+
+namespace SensorSampler {
+
+namespace {
+    struct State {
+        float window[SensorConfig::MAX_OVERSAMPLE];
+        uint8_t count;
+        uint8_t oversample;
+        bool sampled;
+        bool hasOutput;
+        unsigned long lastSample;
+        float output;
+    };
+
+    State states[Registry::MAX_HANDLES];
+    uint32_t configRevision = 0;
+
+    float median(float* values, uint8_t count) {
+        // Insertion sort; windows are at most MAX_OVERSAMPLE long
+        for (uint8_t i = 1; i < count; i++) {
+            float v = values[i];
+            int8_t j = i - 1;
+            while (j >= 0 && values[j] > v) {
+                values[j + 1] = values[j];
+                j--;
+            }
+            values[j + 1] = v;
+        }
+        if (count % 2) return values[count / 2];
+        return (values[count / 2 - 1] + values[count / 2]) / 2.0f;
+    }
+}
+
+void loop(const Sensors::Snapshot& snapshot, Callback onValue) {
+    if (SensorConfig::getRevision() != configRevision) {
+        configRevision = SensorConfig::getRevision();
+        Sensors::updateAcquireIntervals();
+    }
+
+    unsigned long now = snapshot.takenAt;
+    const Registry::Readings& values = SensorGraph::evaluate(snapshot);
+    size_t count = SensorConfig::getSensorCount();
+
+    for (size_t i = 0; i < count; i++) {
+        SensorConfig::Sensor* cfg = SensorConfig::getSensorByIndex(i);
+        if (cfg->handle >= Registry::MAX_HANDLES) continue;
+        State& state = states[cfg->handle];
+
+        if (state.oversample != cfg->oversample) {
+            state.oversample = cfg->oversample;
+            state.count = 0;
+        }
+
+        unsigned long period = cfg->sampleIntervalMs / cfg->oversample;
+        if (state.sampled && now - state.lastSample < period) continue;
+        // Stay on the sampling grid unless we fell a whole period behind
+        bool onGrid = state.sampled && now - state.lastSample < 2 * period;
+        state.lastSample = onGrid ? state.lastSample + period : now;
+        state.sampled = true;
+
+        float raw = values.get(cfg->handle);
+        if (isnan(raw)) continue;
+
+        state.window[state.count++] = raw;
+        if (state.count < state.oversample) continue;
+
+        float value = median(state.window, state.count);
+        state.count = 0;
+        if (cfg->smoothing > 0.0f && state.hasOutput) {
+            value = cfg->smoothing * state.output + (1.0f - cfg->smoothing) * value;
+        }
+        state.output = value;
+        state.hasOutput = true;
+        onValue(cfg->handle, value);
+    }
+}
+
+void reset(Registry::Handle handle) {
+    if (handle >= Registry::MAX_HANDLES) return;
+    states[handle] = {};
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include "registry.h"
+#include "sensors.h"
+
+// Per-sensor sampling. Takes each sensor's raw value from the acquisition
+// snapshot at its own rate, collects `oversample` samples per interval and
+// reduces them to their median, optionally EMA-smoothed, before the value
+// reaches history and automation.
+namespace SensorSampler {
+
+using Callback = void (*)(Registry::Handle handle, float value);
+
+// Call once per new acquisition round. `onValue` fires for every sensor
+// whose sampling interval completed in this round.
+void loop(const Sensors::Snapshot& snapshot, Callback onValue);
+
+// Drops a sensor's partial window and smoothing state
+void reset(Registry::Handle handle);
+
+}
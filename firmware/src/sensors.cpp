@@ -1,33 +1,21 @@
 #include "sensors.h"
 #include "sensor_config.h"
 #include "storage.h"
+#include "sensor_graph.h"
 #include <Wire.h>
 #include <SensirionI2cSht3x.h>
 #include <SensirionI2cSht4x.h>
 #include <SensirionI2CScd4x.h>
 #include <Adafruit_AS7341.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
 #include <cmath>
+#include <time.h>
 
 namespace {
 
-    struct TempHumReading {
-        float temperature = NAN;
-        float humidity = NAN;
-        bool valid = false;
-    };
-
-    struct Co2Reading {
-        float temperature = NAN;
-        float humidity = NAN;
-        uint16_t co2 = 0;
-        bool valid = false;
-    };
-
-    struct LightReading {
-        float ppfd = NAN;
-        uint16_t channels[8] = {0};
-        bool valid = false;
-    };
+    using Sensors::Snapshot;
 
     SensirionI2cSht3x sht3x;
     SensirionI2cSht4x sht4x;
@@ -39,10 +27,42 @@ namespace {
     bool scd4xFound = false;
     bool as7341Found = false;
 
-    TempHumReading sht3xData;
-    TempHumReading sht4xData;
-    Co2Reading scd4xData;
-    LightReading as7341Data;
+    constexpr uint8_t SHT3X_ADDRESS = 0x44;
+    uint8_t sht4xAddress = 0x44;
+
+    // Dual-core parts (S3) acquire on a task pinned to the protocol core;
+    // single-core parts (C3) drive the same scheduler from loop().
+#if CONFIG_FREERTOS_UNICORE
+    constexpr bool USE_SENSOR_TASK = false;
+#else
+    constexpr bool USE_SENSOR_TASK = true;
+#endif
+    constexpr size_t SENSOR_STACK_SIZE = 4096;
+    constexpr UBaseType_t SENSOR_PRIORITY = 1;
+    constexpr BaseType_t SENSOR_CORE = 0;
+    constexpr unsigned long SENSOR_POLL_MS = 5;
+
+    TaskHandle_t sensorTask = nullptr;
+
+    // Round being assembled; only the acquisition context touches it
+    Snapshot working;
+
+    // Seqlock around the published round: odd while a copy is in progress.
+    // Readers retry instead of blocking the writer.
+    std::atomic<uint32_t> publishedSeq{0};
+    Snapshot published;
+
+    void publish() {
+        working.round++;
+        working.takenAt = millis();
+        working.timestamp = (uint32_t)time(nullptr);
+
+        uint32_t seq = publishedSeq.load(std::memory_order_relaxed);
+        publishedSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&published, &working, sizeof(Snapshot));
+        publishedSeq.store(seq + 2, std::memory_order_release);
+    }
 
     const char* PPFD_CAL_PATH = "/ppfd_cal.json";
     float ppfdCalFactor = 1.0f;
@@ -62,44 +82,205 @@ namespace {
         Serial.printf("[Sensors] Saved PPFD calibration factor: %.4f\n", ppfdCalFactor);
     }
 
-    float calculateVPD(float tempC, float rhPercent, float leafOffset) {
-        float leafTemp = tempC - leafOffset;
-        float svpLeaf = 0.6108f * expf((17.27f * leafTemp) / (leafTemp + 237.3f));
-        float svpAir = 0.6108f * expf((17.27f * tempC) / (tempC + 237.3f));
-        float avp = svpAir * (rhPercent / 100.0f);
-        return svpLeaf - avp;
+    // Sensirion CRC-8 (poly 0x31, init 0xFF) over one 16-bit word
+    uint8_t sensirionCrc(const uint8_t* data) {
+        uint8_t crc = 0xFF;
+        for (int i = 0; i < 2; i++) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
     }
 
-    // Magnus-Tetens approximation for dew point (°C)
-    float calculateDewPoint(float tempC, float rhPercent) {
-        const float a = 17.27f;
-        const float b = 237.3f;
-        float gamma = (a * tempC) / (b + tempC) + logf(rhPercent / 100.0f);
-        return (b * gamma) / (a - gamma);
+    bool sendCommand(uint8_t address, const uint8_t* command, size_t len) {
+        Wire.beginTransmission(address);
+        Wire.write(command, len);
+        return Wire.endTransmission() == 0;
     }
 
-    float getValueFromHardware(const char* hardwareType, const char* sensorType) {
-        if (strcmp(hardwareType, "sht3x") == 0) {
-            if (!sht3xFound || !sht3xData.valid) return NAN;
-            if (strcmp(sensorType, "temperature") == 0) return sht3xData.temperature;
-            if (strcmp(sensorType, "humidity") == 0) return sht3xData.humidity;
-        }
-        else if (strcmp(hardwareType, "sht4x") == 0) {
-            if (!sht4xFound || !sht4xData.valid) return NAN;
-            if (strcmp(sensorType, "temperature") == 0) return sht4xData.temperature;
-            if (strcmp(sensorType, "humidity") == 0) return sht4xData.humidity;
-        }
-        else if (strcmp(hardwareType, "scd4x") == 0) {
-            if (!scd4xFound || !scd4xData.valid) return NAN;
-            if (strcmp(sensorType, "temperature") == 0) return scd4xData.temperature;
-            if (strcmp(sensorType, "humidity") == 0) return scd4xData.humidity;
-            if (strcmp(sensorType, "co2") == 0) return (float)scd4xData.co2;
+    // Reads two CRC-protected words. Fails (NACK) while a conversion is still running.
+    bool readWords(uint8_t address, uint16_t& first, uint16_t& second) {
+        if (Wire.requestFrom(address, (uint8_t)6) != 6) return false;
+        uint8_t buf[6];
+        for (int i = 0; i < 6; i++) buf[i] = (uint8_t)Wire.read();
+        if (sensirionCrc(buf) != buf[2] || sensirionCrc(buf + 3) != buf[5]) return false;
+        first = (uint16_t)((buf[0] << 8) | buf[1]);
+        second = (uint16_t)((buf[3] << 8) | buf[4]);
+        return true;
+    }
+
+    // Acquisition scheduler. Each driver is split into a start step that kicks
+    // off a conversion and a poll step that collects the result once it is
+    // ready, so a loop() pass costs at most one short I2C transaction per
+    // driver instead of waiting out every conversion in turn.
+    enum PollResult : uint8_t {
+        POLL_PENDING,
+        POLL_DONE,
+        POLL_FAILED
+    };
+
+    struct Driver {
+        const char* name;
+        const char* hardwareType;       // SensorConfig::Sensor::hardwareType
+        const bool* found;
+        bool* valid;
+        unsigned long conversionMs;     // earliest first poll after start
+        unsigned long timeoutMs;        // give up on a conversion after this
+        unsigned long minIntervalMs;    // fastest useful acquisition rate
+        bool (*start)();
+        PollResult (*poll)();
+        std::atomic<uint32_t> intervalMs;   // set from loop(), read by the sensor task
+        bool converting;
+        unsigned long startedAt;
+        unsigned long lastStart;
+    };
+
+    const unsigned long ACQUIRE_INTERVAL = 2000;
+
+    bool sht3xStart() {
+        // Single shot, high repeatability, no clock stretching (15.5 ms)
+        const uint8_t cmd[2] = {0x24, 0x00};
+        return sendCommand(SHT3X_ADDRESS, cmd, sizeof(cmd));
+    }
+
+    PollResult sht3xPoll() {
+        uint16_t rawTemp, rawHum;
+        if (!readWords(SHT3X_ADDRESS, rawTemp, rawHum)) return POLL_PENDING;
+        working.sht3x.temperature = -45.0f + 175.0f * rawTemp / 65535.0f;
+        working.sht3x.humidity = 100.0f * rawHum / 65535.0f;
+        working.sht3x.valid = true;
+        return POLL_DONE;
+    }
+
+    bool sht4xStart() {
+        // High precision measurement (8.3 ms)
+        const uint8_t cmd[1] = {0xFD};
+        return sendCommand(sht4xAddress, cmd, sizeof(cmd));
+    }
+
+    PollResult sht4xPoll() {
+        uint16_t rawTemp, rawHum;
+        if (!readWords(sht4xAddress, rawTemp, rawHum)) return POLL_PENDING;
+        working.sht4x.temperature = -45.0f + 175.0f * rawTemp / 65535.0f;
+        working.sht4x.humidity = -6.0f + 125.0f * rawHum / 65535.0f;
+        working.sht4x.valid = true;
+        return POLL_DONE;
+    }
+
+    bool scd4xStart() {
+        // Runs in periodic mode; nothing to trigger
+        return true;
+    }
+
+    PollResult scd4xPoll() {
+        bool isReady = false;
+        scd4x.getDataReadyFlag(isReady);
+        if (!isReady) return POLL_DONE;
+
+        uint16_t co2;
+        float temp, hum;
+        if (scd4x.readMeasurement(co2, temp, hum) != 0) return POLL_FAILED;
+        working.scd4x.co2 = co2;
+        working.scd4x.temperature = temp;
+        working.scd4x.humidity = hum;
+        working.scd4x.valid = true;
+        return POLL_DONE;
+    }
+
+    bool as7341Start() {
+        return as7341.startReading();
+    }
+
+    PollResult as7341Poll() {
+        if (!as7341.checkReadingProgress()) return POLL_PENDING;
+
+        uint16_t readings[12];
+        if (!as7341.getAllChannels(readings)) return POLL_FAILED;
+
+        // Read PAR-relevant channels (415-680nm)
+        uint16_t f1 = readings[AS7341_CHANNEL_415nm_F1];
+        uint16_t f2 = readings[AS7341_CHANNEL_445nm_F2];
+        uint16_t f3 = readings[AS7341_CHANNEL_480nm_F3];
+        uint16_t f4 = readings[AS7341_CHANNEL_515nm_F4];
+        uint16_t f5 = readings[AS7341_CHANNEL_555nm_F5];
+        uint16_t f6 = readings[AS7341_CHANNEL_590nm_F6];
+        uint16_t f7 = readings[AS7341_CHANNEL_630nm_F7];
+        uint16_t f8 = readings[AS7341_CHANNEL_680nm_F8];
+        
+        working.as7341.channels[0] = f1;
+        working.as7341.channels[1] = f2;
+        working.as7341.channels[2] = f3;
+        working.as7341.channels[3] = f4;
+        working.as7341.channels[4] = f5;
+        working.as7341.channels[5] = f6;
+        working.as7341.channels[6] = f7;
+        working.as7341.channels[7] = f8;
+
+        // Spectral weighting factors from literature (corrects sensor sensitivity bias)
+        // F8 (680nm) is baseline; blue channels are 3-6x more sensitive than red
+        float weighted = (f1 * 5.88f) + (f2 * 3.33f) + (f3 * 2.63f) + (f4 * 2.04f) +
+                       (f5 * 1.69f) + (f6 * 1.54f) + (f7 * 1.33f) + (f8 * 1.00f);
+        
+        // Convert to PPFD (μmol/m²/s) using literature calibration constant
+        // Integration time: 280.78ms, Gain: 16X
+        working.as7341.rawPpfd = weighted * 0.03f;
+        working.as7341.valid = true;
+        return POLL_DONE;
+    }
+
+    // AS7341 reads both SMUX halves (low F1-F4, high F5-F8), ~281 ms each.
+    // SCD4x only produces a new measurement every 5 s in periodic mode.
+    Driver drivers[] = {
+        {"SHT3x", "sht3x", &sht3xFound, &working.sht3x.valid, 16, 100, 500, sht3xStart, sht3xPoll, {ACQUIRE_INTERVAL}, false, 0, 0},
+        {"SHT4x", "sht4x", &sht4xFound, &working.sht4x.valid, 9, 100, 500, sht4xStart, sht4xPoll, {ACQUIRE_INTERVAL}, false, 0, 0},
+        {"SCD4x", "scd4x", &scd4xFound, &working.scd4x.valid, 0, 100, 5000, scd4xStart, scd4xPoll, {ACQUIRE_INTERVAL}, false, 0, 0},
+        {"AS7341", "as7341", &as7341Found, &working.as7341.valid, 0, 1500, 1000, as7341Start, as7341Poll, {ACQUIRE_INTERVAL}, false, 0, 0},
+    };
+
+    // One scheduler pass. Publishes a new round whenever a driver finished.
+    void acquire() {
+        unsigned long now = millis();
+        bool changed = false;
+
+        for (auto& driver : drivers) {
+            if (!*driver.found) continue;
+
+            if (driver.converting) {
+                if (now - driver.startedAt < driver.conversionMs) continue;
+
+                PollResult result = driver.poll();
+                if (result == POLL_PENDING && now - driver.startedAt < driver.timeoutMs) continue;
+
+                driver.converting = false;
+                changed = true;
+                if (result != POLL_DONE) {
+                    *driver.valid = false;
+                    if (result == POLL_PENDING) Serial.printf("[Sensors] %s conversion timed out\n", driver.name);
+                }
+            }
+
+            unsigned long interval = driver.intervalMs.load(std::memory_order_relaxed);
+            if (driver.lastStart != 0 && now - driver.lastStart < interval) continue;
+            driver.lastStart = now;
+            if (driver.start()) {
+                driver.converting = true;
+                driver.startedAt = now;
+            } else {
+                *driver.valid = false;
+                changed = true;
+            }
         }
-        else if (strcmp(hardwareType, "as7341") == 0) {
-            if (!as7341Found || !as7341Data.valid) return NAN;
-            if (strcmp(sensorType, "light") == 0) return as7341Data.ppfd;
+
+        if (changed) publish();
+    }
+
+    void sensorTaskFn(void*) {
+        for (;;) {
+            acquire();
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_POLL_MS));
         }
-        return NAN;
     }
 }
 
@@ -123,14 +304,14 @@ bool init(int sda, int scl) {
         Serial.println("[Sensors] SHT3x not found");
     }
 
-    uint8_t sht4xAddr = sht3xFound ? 0x45 : 0x44;
-    sht4x.begin(Wire, sht4xAddr);
+    sht4xAddress = sht3xFound ? 0x45 : 0x44;
+    sht4x.begin(Wire, sht4xAddress);
     sht4x.softReset();
     delay(10);
     uint32_t sht4xSerial = 0;
     if (sht4x.serialNumber(sht4xSerial) == 0) {
         sht4xFound = true;
-        Serial.printf("[Sensors] SHT4x found at 0x%02X (serial: %u)\n", sht4xAddr, sht4xSerial);
+        Serial.printf("[Sensors] SHT4x found at 0x%02X (serial: %u)\n", sht4xAddress, sht4xSerial);
     } else {
         Serial.println("[Sensors] SHT4x not found");
     }
@@ -171,112 +352,60 @@ bool init(int sda, int scl) {
         Serial.println("[Sensors] AS7341 not found");
     }
 
-    return sht3xFound || sht4xFound || scd4xFound || as7341Found;
+    bool anyFound = sht3xFound || sht4xFound || scd4xFound || as7341Found;
+    if (USE_SENSOR_TASK && anyFound && !sensorTask) {
+        xTaskCreatePinnedToCore(
+            sensorTaskFn, "sensors", SENSOR_STACK_SIZE,
+            nullptr, SENSOR_PRIORITY, &sensorTask, SENSOR_CORE);
+    }
+    return anyFound;
 }
 
-void read() {
-    if (sht3xFound) {
-        float temp, hum;
-        if (sht3x.measureSingleShot(REPEATABILITY_HIGH, false, temp, hum) == 0) {
-            sht3xData.temperature = temp;
-            sht3xData.humidity = hum;
-            sht3xData.valid = true;
-        } else {
-            sht3xData.valid = false;
-        }
-    }
+void loop() {
+    if (!USE_SENSOR_TASK) acquire();
+}
 
-    if (sht4xFound) {
-        float temp, hum;
-        if (sht4x.measureHighPrecision(temp, hum) == 0) {
-            sht4xData.temperature = temp;
-            sht4xData.humidity = hum;
-            sht4xData.valid = true;
-        } else {
-            sht4xData.valid = false;
+void updateAcquireIntervals() {
+    size_t count = SensorConfig::getSensorCount();
+    for (auto& driver : drivers) {
+        // Fastest raw sampling any sensor needs from this part
+        uint32_t period = 0;
+        for (size_t i = 0; i < count; i++) {
+            SensorConfig::Sensor* cfg = SensorConfig::getSensorByIndex(i);
+            if (!SensorGraph::readsFrom(cfg->handle, driver.hardwareType)) continue;
+            uint32_t p = cfg->sampleIntervalMs / cfg->oversample;
+            if (period == 0 || p < period) period = p;
         }
-    }
 
-    if (scd4xFound) {
-        bool isReady = false;
-        scd4x.getDataReadyFlag(isReady);
-        if (isReady) {
-            uint16_t co2;
-            float temp, hum;
-            if (scd4x.readMeasurement(co2, temp, hum) == 0) {
-                scd4xData.co2 = co2;
-                scd4xData.temperature = temp;
-                scd4xData.humidity = hum;
-                scd4xData.valid = true;
-            } else {
-                scd4xData.valid = false;
-            }
+        uint32_t interval = period ? max(period, (uint32_t)driver.minIntervalMs) : ACQUIRE_INTERVAL;
+        if (driver.intervalMs.exchange(interval) != interval) {
+            Serial.printf("[Sensors] %s acquiring every %u ms\n", driver.name, interval);
         }
     }
+}
 
-    if (as7341Found) {
-        if (as7341.readAllChannels()) {
-            // Read PAR-relevant channels (415-680nm)
-            uint16_t f1 = as7341.getChannel(AS7341_CHANNEL_415nm_F1);
-            uint16_t f2 = as7341.getChannel(AS7341_CHANNEL_445nm_F2);
-            uint16_t f3 = as7341.getChannel(AS7341_CHANNEL_480nm_F3);
-            uint16_t f4 = as7341.getChannel(AS7341_CHANNEL_515nm_F4);
-            uint16_t f5 = as7341.getChannel(AS7341_CHANNEL_555nm_F5);
-            uint16_t f6 = as7341.getChannel(AS7341_CHANNEL_590nm_F6);
-            uint16_t f7 = as7341.getChannel(AS7341_CHANNEL_630nm_F7);
-            uint16_t f8 = as7341.getChannel(AS7341_CHANNEL_680nm_F8);
-            
-            as7341Data.channels[0] = f1;
-            as7341Data.channels[1] = f2;
-            as7341Data.channels[2] = f3;
-            as7341Data.channels[3] = f4;
-            as7341Data.channels[4] = f5;
-            as7341Data.channels[5] = f6;
-            as7341Data.channels[6] = f7;
-            as7341Data.channels[7] = f8;
-
-            // Spectral weighting factors from literature (corrects sensor sensitivity bias)
-            // F8 (680nm) is baseline; blue channels are 3-6x more sensitive than red
-            float weighted = (f1 * 5.88f) + (f2 * 3.33f) + (f3 * 2.63f) + (f4 * 2.04f) +
-                           (f5 * 1.69f) + (f6 * 1.54f) + (f7 * 1.33f) + (f8 * 1.00f);
-            
-            // Convert to PPFD (μmol/m²/s) using literature calibration constant
-            // Integration time: 280.78ms, Gain: 16X
-            as7341Data.ppfd = weighted * 0.03f * ppfdCalFactor;
-            as7341Data.valid = true;
-        } else {
-            as7341Data.valid = false;
-        }
+bool readSnapshot(Snapshot& out) {
+    for (;;) {
+        uint32_t before = publishedSeq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        memcpy(&out, &published, sizeof(Snapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (publishedSeq.load(std::memory_order_relaxed) == before) return before != 0;
     }
 }
 
 float getSensorValue(const char* sensorId) {
-    SensorConfig::Sensor* cfg = SensorConfig::getSensor(sensorId);
-    if (!cfg) return NAN;
-
-    if (strcmp(cfg->hardwareType, "calculated") == 0) {
-        float temp = NAN;
-        float hum = NAN;
-
-        if (cfg->tempSourceId[0] != '\0') {
-            temp = getSensorValue(cfg->tempSourceId);
-        }
-        if (cfg->humSourceId[0] != '\0') {
-            hum = getSensorValue(cfg->humSourceId);
-        }
-
-        if (isnan(temp) || isnan(hum) || hum <= 0) return NAN;
+    return getSensorValue(Registry::find(sensorId));
+}
 
-        if (strcmp(cfg->type, "vpd") == 0) {
-            return calculateVPD(temp, hum, cfg->leafTempOffset);
-        }
-        if (strcmp(cfg->type, "dewpoint") == 0) {
-            return calculateDewPoint(temp, hum);
-        }
-        return NAN;
-    }
+float getSensorValue(Registry::Handle handle) {
+    Snapshot snapshot;
+    readSnapshot(snapshot);
+    return getSensorValue(snapshot, handle);
+}
 
-    return getValueFromHardware(cfg->hardwareType, cfg->type);
+float getSensorValue(const Snapshot& snapshot, Registry::Handle handle) {
+    return SensorGraph::evaluate(snapshot).get(handle);
 }
 
 float getPpfdCalibrationFactor() {
@@ -289,16 +418,10 @@ void setPpfdCalibrationFactor(float factor) {
 }
 
 float getRawPpfd() {
-    if (!as7341Found || !as7341Data.valid) return NAN;
-    return as7341Data.ppfd / ppfdCalFactor;
-}
-
-bool getSpectralChannels(uint16_t* out, size_t len) {
-    if (!as7341Found || !as7341Data.valid || len < 8) return false;
-    for (size_t i = 0; i < 8; i++) {
-        out[i] = as7341Data.channels[i];
-    }
-    return true;
+    Snapshot snapshot;
+    readSnapshot(snapshot);
+    if (!snapshot.as7341.valid) return NAN;
+    return snapshot.as7341.rawPpfd;
 }
 
 }
@@ -1,16 +1,64 @@
 #pragma once
 
 #include <Arduino.h>
+#include "registry.h"
 
 namespace Sensors {
 
+struct TempHumReading {
+    float temperature = NAN;
+    float humidity = NAN;
+    bool valid = false;
+};
+
+struct Co2Reading {
+    float temperature = NAN;
+    float humidity = NAN;
+    uint16_t co2 = 0;
+    bool valid = false;
+};
+
+struct LightReading {
+    float rawPpfd = NAN;            // before the PPFD calibration factor
+    uint16_t channels[8] = {0};
+    bool valid = false;
+};
+
+// One acquisition round. Published as a whole, so everything read from a
+// snapshot comes from the same round.
+struct Snapshot {
+    uint32_t round = 0;             // 0 until the first round is published
+    unsigned long takenAt = 0;      // millis() at publication
+    uint32_t timestamp = 0;         // epoch seconds at publication
+    TempHumReading sht3x;
+    TempHumReading sht4x;
+    Co2Reading scd4x;
+    LightReading as7341;
+};
+
 bool init(int sda = -1, int scl = -1);
-void read();
+// Drives the acquisition state machine on single-core targets; call every
+// loop(). Never waits on a conversion. On dual-core targets acquisition runs
+// on its own task and this does nothing.
+void loop();
+
+// Derives each part's acquisition period from the sampling settings of the
+// sensors read from it, clamped to what the part can usefully deliver.
+// Parts no sensor uses stay at 2 s. Call after the sensor config changes.
+void updateAcquireIntervals();
+
+// Copies the latest published round without locking. False until the first
+// round has been published.
+bool readSnapshot(Snapshot& out);
+
+// Value of one sensor in `snapshot`; see SensorGraph for how calculated
+// sensors are derived. Convenience lookups against the latest snapshot follow.
+float getSensorValue(const Snapshot& snapshot, Registry::Handle handle);
 float getSensorValue(const char* sensorId);
+float getSensorValue(Registry::Handle handle);
 
 float getPpfdCalibrationFactor();
 void setPpfdCalibrationFactor(float factor);
 float getRawPpfd();
-bool getSpectralChannels(uint16_t* out, size_t len);
 
 }  // namespace Sensors
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+// lwIP in the prebuilt Arduino core allows 16 active TCP connections
+// (CONFIG_LWIP_MAX_ACTIVE_TCP; build flags cannot raise it). The plug HTTP
+// client and the web server share them, so they are split here, with room
+// left for a browser loading the app.
+namespace SocketBudget {
+
+constexpr size_t LWIP_ACTIVE_TCP = 16;
+constexpr size_t HTTP_IN_FLIGHT = 4;    // plug requests at once
+constexpr size_t HTTP_POOLED = 2;       // idle keep-alive connections to plugs
+constexpr size_t PAGE_LOADS = 2;        // web app assets and API calls
+constexpr size_t WS_CLIENTS = LWIP_ACTIVE_TCP - HTTP_IN_FLIGHT - HTTP_POOLED - PAGE_LOADS;
+
+}
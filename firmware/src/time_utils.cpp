@@ -1,33 +1,136 @@
 #include "time_utils.h"
 #include "wifi_manager.h"
+#include "storage.h"
 #include <time.h>
+#include <sys/time.h>
 
 namespace TimeUtils {
 
 namespace {
-    int parseTimeToMinutes(const char* hhmm) {
-        int hours = 0, minutes = 0;
-        if (sscanf(hhmm, "%d:%d", &hours, &minutes) >= 1) {
-            return hours * 60 + minutes;
+    const char* SYSTEM_PATH = "/system.json";
+    constexpr const char* DEFAULT_TIMEZONE = "UTC0";
+
+    char timezone[MAX_TIMEZONE_LENGTH] = "UTC0";
+    bool timezoneSaved = false;
+    uint32_t timezoneRevision = 0;
+
+    void applyTimezone() {
+        setenv("TZ", timezone, 1);
+        tzset();
+        timezoneRevision++;
+    }
+
+    bool validTimezone(const char* posixTz) {
+        size_t length = posixTz ? strlen(posixTz) : 0;
+        if (length == 0 || length >= MAX_TIMEZONE_LENGTH) return false;
+        for (size_t i = 0; i < length; i++) {
+            if (!isprint((unsigned char)posixTz[i]) || posixTz[i] == ' ') return false;
         }
-        return 0;
+        return true;
+    }
+}
+
+void init() {
+    JsonDocument doc;
+    const char* saved = Storage::readJson(SYSTEM_PATH, doc) ? doc["timezone"].as<const char*>() : nullptr;
+    timezoneSaved = validTimezone(saved);
+    strlcpy(timezone, timezoneSaved ? saved : DEFAULT_TIMEZONE, sizeof(timezone));
+    applyTimezone();
+    Serial.printf("[Time] Zone %s\n", timezone);
+}
+
+bool setTimezone(const char* posixTz) {
+    if (!validTimezone(posixTz)) return false;
+    if (timezoneSaved && strcmp(timezone, posixTz) == 0) return true;
+
+    strlcpy(timezone, posixTz, sizeof(timezone));
+    applyTimezone();
+
+    JsonDocument doc;
+    Storage::readJson(SYSTEM_PATH, doc);
+    doc["timezone"] = timezone;
+    Storage::writeJson(SYSTEM_PATH, doc);
+    timezoneSaved = true;
+    Serial.printf("[Time] Zone set to %s\n", timezone);
+    return true;
+}
+
+const char* getTimezone() {
+    return timezone;
+}
+
+bool hasSavedTimezone() {
+    return timezoneSaved;
+}
+
+int utcOffsetMinutes() {
+    time_t now = time(nullptr);
+    struct tm local;
+    struct tm utc;
+    localtime_r(&now, &local);
+    gmtime_r(&now, &utc);
+    int minutes = (local.tm_hour - utc.tm_hour) * 60 + (local.tm_min - utc.tm_min);
+    // At most a day apart; a different year means the year boundary lies between them
+    int days = local.tm_year != utc.tm_year ? local.tm_year - utc.tm_year : local.tm_yday - utc.tm_yday;
+    return minutes + days * 1440;
+}
+
+uint32_t getClockRevision() {
+    return timezoneRevision + WiFiManager::getTimeSyncCount();
+}
+
+int parseTimeToMinutes(const char* hhmm) {
+    int hours = 0, minutes = 0;
+    if (sscanf(hhmm, "%d:%d", &hours, &minutes) >= 1) {
+        return hours * 60 + minutes;
     }
+    return 0;
 }
 
-bool isTimeInRange(const char* startHHMM, const char* endHHMM) {
-    if (!WiFiManager::isTimeSynced()) return false;
-    
+int currentMinutes() {
+    if (!WiFiManager::isTimeSynced()) return -1;
+
     time_t now = time(nullptr);
-    struct tm* tm_info = gmtime(&now);
-    int currentMinutes = tm_info->tm_hour * 60 + tm_info->tm_min;
-    
-    int startMinutes = parseTimeToMinutes(startHHMM);
-    int endMinutes = parseTimeToMinutes(endHHMM);
-    
+    struct tm t;
+    localtime_r(&now, &t);
+    return t.tm_hour * 60 + t.tm_min;
+}
+
+int64_t epochMs() {
+    if (!WiFiManager::isTimeSynced()) return -1;
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+int32_t secondsUntilMinute(int minuteOfDay) {
+    if (!WiFiManager::isTimeSynced()) return -1;
+
+    time_t now = time(nullptr);
+    struct tm today;
+    localtime_r(&now, &today);
+
+    // mktime settles the DST offset for the target itself
+    for (int days = 0; days < 2; days++) {
+        struct tm t = today;
+        t.tm_mday += days;
+        t.tm_hour = minuteOfDay / 60;
+        t.tm_min = minuteOfDay % 60;
+        t.tm_sec = 0;
+        t.tm_isdst = -1;
+        time_t at = mktime(&t);
+        if (at > now) return (int32_t)(at - now);
+    }
+    return 24 * 3600;
+}
+
+bool isMinuteInRange(int minute, int startMinutes, int endMinutes) {
+    if (minute < 0) return false;
     if (startMinutes <= endMinutes) {
-        return currentMinutes >= startMinutes && currentMinutes < endMinutes;
+        return minute >= startMinutes && minute < endMinutes;
     } else {
-        return currentMinutes >= startMinutes || currentMinutes < endMinutes;
+        return minute >= startMinutes || minute < endMinutes;
     }
 }
 
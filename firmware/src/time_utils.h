@@ -2,6 +2,40 @@
 
 #include <Arduino.h>
 
+// Wall-clock helpers in the device's local time. The zone is a POSIX TZ
+// string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"; the default is UTC.
 namespace TimeUtils {
-    bool isTimeInRange(const char* startHHMM, const char* endHHMM);
+    constexpr size_t MAX_TIMEZONE_LENGTH = 64;
+
+    // Loads the saved zone; call after Storage::init and before NTP starts
+    void init();
+
+    // False when `posixTz` is empty or too long; the zone is saved on success
+    bool setTimezone(const char* posixTz);
+    const char* getTimezone();
+    // False until a zone was set, even UTC; the default is then still in force
+    bool hasSavedTimezone();
+
+    // Local time minus UTC right now, in minutes (60 for CET in winter)
+    int utcOffsetMinutes();
+
+    // Changes whenever the clock is synced or the zone changes, so callers
+    // can recompute wall-clock deadlines
+    uint32_t getClockRevision();
+
+    // "HH:MM" -> minutes since midnight
+    int parseTimeToMinutes(const char* hhmm);
+
+    // Minutes since local midnight, -1 until the clock is synced
+    int currentMinutes();
+
+    // Milliseconds since the Unix epoch, -1 until the clock is synced
+    int64_t epochMs();
+
+    // Seconds until the local clock next reads `minuteOfDay`:00, across DST
+    // changes; -1 until the clock is synced
+    int32_t secondsUntilMinute(int minuteOfDay);
+
+    // [start, end), wrapping past midnight when end < start; false for minute -1
+    bool isMinuteInRange(int minute, int startMinutes, int endMinutes);
 }
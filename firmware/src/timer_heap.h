@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+
+// One deadline per key in [0, N), kept in an indexed binary min-heap:
+// scheduling, rescheduling and cancelling a key are O(log N), and finding
+// nothing due is one comparison. Deadlines are millis() values, compared
+// so that they survive the counter wrapping.
+template <size_t N>
+struct TimerHeap {
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    uint16_t heap[N];           // keys, earliest deadline first
+    uint16_t position[N];       // by key: index into heap, NONE when idle
+    unsigned long dueAt[N];     // by key
+    uint16_t count;
+
+    TimerHeap() { clear(); }
+
+    void clear() {
+        count = 0;
+        for (size_t i = 0; i < N; i++) position[i] = NONE;
+    }
+
+    bool scheduled(uint16_t key) const {
+        return key < N && position[key] != NONE;
+    }
+
+    bool due(uint16_t key, unsigned long now) const {
+        return scheduled(key) && !before(now, dueAt[key]);
+    }
+
+    // Sets or moves the key's deadline
+    void schedule(uint16_t key, unsigned long at) {
+        if (key >= N) return;
+        if (position[key] == NONE) {
+            position[key] = count;
+            heap[count++] = key;
+        }
+        dueAt[key] = at;
+        siftUp(position[key]);
+        siftDown(position[key]);
+    }
+
+    void cancel(uint16_t key) {
+        if (!scheduled(key)) return;
+        uint16_t index = position[key];
+        position[key] = NONE;
+        if (index == --count) return;
+        uint16_t moved = heap[count];
+        place(index, moved);
+        siftUp(index);
+        siftDown(position[moved]);
+    }
+
+    // Takes the earliest key whose deadline has passed; false when none has
+    bool popDue(unsigned long now, uint16_t& key) {
+        if (count == 0 || before(now, dueAt[heap[0]])) return false;
+        key = heap[0];
+        cancel(key);
+        return true;
+    }
+
+private:
+    static bool before(unsigned long a, unsigned long b) {
+        return (long)(a - b) < 0;
+    }
+
+    void place(uint16_t index, uint16_t key) {
+        heap[index] = key;
+        position[key] = index;
+    }
+
+    void siftUp(uint16_t index) {
+        uint16_t key = heap[index];
+        while (index > 0) {
+            uint16_t parent = (index - 1) / 2;
+            if (!before(dueAt[key], dueAt[heap[parent]])) break;
+            place(index, heap[parent]);
+            index = parent;
+        }
+        place(index, key);
+    }
+
+    void siftDown(uint16_t index) {
+        uint16_t key = heap[index];
+        for (;;) {
+            uint16_t child = index * 2 + 1;
+            if (child >= count) break;
+            if (child + 1 < count && before(dueAt[heap[child + 1]], dueAt[heap[child]])) child++;
+            if (!before(dueAt[heap[child]], dueAt[key])) break;
+            place(index, heap[child]);
+            index = child;
+        }
+        place(index, key);
+    }
+};
@@ -1,12 +1,11 @@
 #include "websocket_server.h"
+#include "ws_frame.h"
+#include "ws_outbox.h"
+#include "socket_budget.h"
 #include "ota_manager.h"
 #include "event_log.h"
 #include "storage.h"
-#include "devices.h"
-#include "device_modes.h"
-#include "sensor_config.h"
-#include "energy_tracker.h"
-#include "climate_config.h"
+#include "device_notify.h"
 #include "web_assets.h"
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
@@ -20,15 +19,20 @@ namespace {
     AsyncWebServer* server = nullptr;
     AsyncWebSocket* ws = nullptr;
     MessageCallback messageCallback;
+    RestoreCallback restoreCallback;
+    volatile bool restorePending = false;
     bool initialized = false;
 
     static constexpr size_t MSG_QUEUE_SIZE = 32;
     static constexpr size_t MSG_MAX_LEN = 512;
-    static constexpr size_t MAX_WS_CLIENTS = 4;
+    // What the plug client and page loads leave of lwIP's connections
+    static constexpr size_t MAX_WS_CLIENTS = SocketBudget::WS_CLIENTS;
     static constexpr unsigned long CLEANUP_INTERVAL_MS = 2000;
     static constexpr unsigned long PING_INTERVAL_MS = 30000;
     static constexpr size_t MAX_INCOMING_PER_LOOP = 2;
-    static constexpr size_t DEFERRED_QUEUE_SIZE = 16;
+    // Frames still waiting in any client's queue; past this, a client that
+    // needs to queue more is closed rather than growing the heap
+    static constexpr size_t MAX_QUEUED_FRAME_BYTES = 32 * 1024;
     
     unsigned long lastCleanup = 0;
     unsigned long lastPing = 0;
@@ -44,57 +48,126 @@ namespace {
     MessageSlot messageQueue[MSG_QUEUE_SIZE];
     portMUX_TYPE queueMux = portMUX_INITIALIZER_UNLOCKED;
 
-    struct DeferredMessage {
-        String message;
-        uint32_t clientId;
-        bool isBroadcast;
-    };
-    
-    size_t deferredHead = 0;
-    size_t deferredTail = 0;
-    DeferredMessage deferredQueue[DEFERRED_QUEUE_SIZE];
-
-    bool enqueueDeferred(uint32_t clientId, const String& message, bool isBroadcast) {
-        size_t next = (deferredHead + 1) % DEFERRED_QUEUE_SIZE;
-        if (next == deferredTail) {
-            Serial.println("[WS] Deferred queue full, dropping");
-            return false;
+    // One per client that has fallen behind; the others send directly
+    WsOutbox outboxes[MAX_WS_CLIENTS];
+
+    WsOutbox* findOutbox(uint32_t clientId) {
+        for (auto& outbox : outboxes) {
+            if (outbox.clientId == clientId) return &outbox;
         }
-        deferredQueue[deferredHead].message = message;
-        deferredQueue[deferredHead].clientId = clientId;
-        deferredQueue[deferredHead].isBroadcast = isBroadcast;
-        deferredHead = next;
-        return true;
+        return nullptr;
     }
 
-    void flushDeferred() {
-        size_t attempts = 0;
-        while (deferredTail != deferredHead && attempts < 4) {
-            DeferredMessage& msg = deferredQueue[deferredTail];
-            
-            if (msg.isBroadcast) {
-                ws->textAll(msg.message);
-                msg.message = String();
-                deferredTail = (deferredTail + 1) % DEFERRED_QUEUE_SIZE;
-            } else {
-                AsyncWebSocketClient* client = ws->client(msg.clientId);
-                if (!client || client->status() != WS_CONNECTED) {
-                    msg.message = String();
-                    deferredTail = (deferredTail + 1) % DEFERRED_QUEUE_SIZE;
-                } else if (client->canSend()) {
-                    client->text(msg.message);
-                    msg.message = String();
-                    deferredTail = (deferredTail + 1) % DEFERRED_QUEUE_SIZE;
-                } else {
-                    break;
-                }
+    void releaseOutbox(WsOutbox& outbox) {
+        outbox.clear();
+        outbox.clientId = 0;
+    }
+
+    // The client reconnects and starts over from a full get_init
+    void dropLaggingClient(AsyncWebSocketClient* client, WsOutbox* outbox) {
+        Serial.printf("[WS] Client #%u too far behind, closing\n", client->id());
+        if (outbox) releaseOutbox(*outbox);
+        client->close();
+    }
+
+    void deliver(AsyncWebSocketClient* client, const WsFrame::Ref& frame, const char* key) {
+        WsOutbox* outbox = findOutbox(client->id());
+        if ((!outbox || outbox->empty()) && client->canSend()) {
+            client->text(frame);
+            return;
+        }
+        if (!outbox) outbox = findOutbox(0);
+        if (!outbox || WsFrame::getStats().liveBytes > MAX_QUEUED_FRAME_BYTES) {
+            dropLaggingClient(client, outbox);
+            return;
+        }
+        outbox->clientId = client->id();
+        if (!outbox->push(frame, key)) dropLaggingClient(client, outbox);
+    }
+
+    void flushOutboxes() {
+        for (auto& outbox : outboxes) {
+            if (outbox.clientId == 0) continue;
+            AsyncWebSocketClient* client = ws->client(outbox.clientId);
+            if (!client || client->status() != WS_CONNECTED) {
+                releaseOutbox(outbox);
+                continue;
+            }
+            while (!outbox.empty() && client->canSend()) {
+                client->text(outbox.front());
+                outbox.pop();
             }
-            attempts++;
+            if (outbox.empty()) outbox.clientId = 0;
         }
     }
 
-    bool isPrivateIP(AsyncWebSocketClient* client) {
-        IPAddress ip = client->remoteIP();
+    // OTA status arrives on the web server or download task. It is handed to
+    // loop(), since the outboxes and the event log are only touched there.
+    static constexpr size_t OTA_QUEUE_SIZE = 8;
+
+    struct OtaSlot {
+        OtaManager::Status status;
+        int progress;
+        char error[96];
+    };
+
+    OtaSlot otaQueue[OTA_QUEUE_SIZE];
+    size_t otaCount = 0;
+    portMUX_TYPE otaMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void postOtaStatus(const OtaManager::StatusEvent& event) {
+        OtaSlot slot = {event.status, event.progress, {}};
+        strlcpy(slot.error, event.error.c_str(), sizeof(slot.error));
+        portENTER_CRITICAL(&otaMux);
+        // Progress within one phase only needs its latest value
+        if (otaCount > 0 && otaQueue[otaCount - 1].status == slot.status) {
+            otaQueue[otaCount - 1] = slot;
+        } else if (otaCount < OTA_QUEUE_SIZE) {
+            otaQueue[otaCount++] = slot;
+        }
+        portEXIT_CRITICAL(&otaMux);
+    }
+
+    void broadcastOtaStatus(const OtaSlot& event) {
+        if (event.status == OtaManager::Status::Success) {
+            EventLog::pushEvent("system", "OTA update completed", "Firmware updated successfully");
+            EventLog::flush();
+        } else if (event.status == OtaManager::Status::Error) {
+            EventLog::pushEvent("system", "OTA update failed", event.error[0] ? event.error : "Unknown error", "warning");
+        }
+
+        JsonDocument doc;
+        doc["type"] = "ota_status";
+        JsonObject otaData = doc["data"].to<JsonObject>();
+        
+        switch (event.status) {
+            case OtaManager::Status::Idle:       otaData["status"] = "idle"; break;
+            case OtaManager::Status::Uploading:   otaData["status"] = "uploading"; break;
+            case OtaManager::Status::Downloading: otaData["status"] = "downloading"; break;
+            case OtaManager::Status::Installing:  otaData["status"] = "installing"; break;
+            case OtaManager::Status::Success:     otaData["status"] = "success"; break;
+            case OtaManager::Status::Error:       otaData["status"] = "error"; break;
+            case OtaManager::Status::Rebooting:   otaData["status"] = "rebooting"; break;
+        }
+        
+        if (event.progress >= 0) otaData["progress"] = event.progress;
+        if (event.error[0]) otaData["error"] = event.error;
+        
+        broadcast(doc, "ota_status");
+    }
+
+    void flushOtaStatus() {
+        OtaSlot pending[OTA_QUEUE_SIZE];
+        portENTER_CRITICAL(&otaMux);
+        size_t count = otaCount;
+        memcpy(pending, otaQueue, count * sizeof(OtaSlot));
+        otaCount = 0;
+        portEXIT_CRITICAL(&otaMux);
+
+        for (size_t i = 0; i < count; i++) broadcastOtaStatus(pending[i]);
+    }
+
+    bool isPrivateIP(const IPAddress& ip) {
         uint8_t first = ip[0];
         if (first == 10) return true;
         if (first == 172 && ip[1] >= 16 && ip[1] <= 31) return true;
@@ -108,7 +181,7 @@ namespace {
                    AwsEventType type, void* arg, uint8_t* data, size_t len) {
         switch (type) {
             case WS_EVT_CONNECT:
-                if (!isPrivateIP(client)) {
+                if (!isPrivateIP(client->remoteIP())) {
                     Serial.printf("[WS] Rejected non-local client #%u from %s\n",
                         client->id(), client->remoteIP().toString().c_str());
                     client->close();
@@ -240,33 +313,9 @@ void init() {
         }
 
         if (success) {
-            Serial.println("[API] Restore: success, reloading modules");
-            
-            Devices::init();
-            DeviceModes::init();
-            SensorConfig::init();
-            EnergyTracker::init();
-            ClimateConfig::init();
-            Devices::computeControlModes();
-            
-            auto rebroadcast = [](const char* type, const String& json) {
-                JsonDocument doc;
-                doc["type"] = type;
-                JsonDocument dataDoc;
-                deserializeJson(dataDoc, json);
-                doc["data"] = dataDoc;
-                String out;
-                serializeJson(doc, out);
-                broadcast(out);
-            };
-
-            String j;
-            Devices::getDevicesJson(j);       rebroadcast("devices", j);
-            DeviceModes::getModesJson(j);     rebroadcast("device_modes", j);
-            SensorConfig::getSensorsJson(j);  rebroadcast("sensor_config", j);
-            EnergyTracker::getEnergiesJson(j);rebroadcast("energy", j);
-            ClimateConfig::getConfigJson(j);  rebroadcast("climate_config", j);
-            
+            // Modules are reloaded by the main loop, which owns their state
+            Serial.println("[API] Restore: success, reload queued");
+            restorePending = true;
             request->send(200, "application/json", "{\"success\":true}");
         } else {
             Serial.println("[API] Restore: write failed");
@@ -275,39 +324,41 @@ void init() {
     });
     
     server->addHandler(restoreHandler);
-    
-    OtaManager::begin(server, [](const OtaManager::StatusEvent& event) {
-        if (event.status == OtaManager::Status::Success) {
-            EventLog::pushEvent("system", "OTA update completed", "Firmware updated successfully");
-            EventLog::flush();
-        } else if (event.status == OtaManager::Status::Error) {
-            char desc[128];
-            snprintf(desc, sizeof(desc), "%s", event.error.length() > 0 ? event.error.c_str() : "Unknown error");
-            EventLog::pushEvent("system", "OTA update failed", desc, "warning");
+
+    // API: state pushed by Shelly action URLs/webhooks and Tasmota rules
+    server->on("/api/device/notify", HTTP_GET | HTTP_POST, [](AsyncWebServerRequest *request) {
+        IPAddress remote = request->client()->remoteIP();
+        if (!isPrivateIP(remote)) {
+            request->send(403);
+            return;
         }
 
-        JsonDocument doc;
-        doc["type"] = "ota_status";
-        JsonObject otaData = doc["data"].to<JsonObject>();
-        
-        switch (event.status) {
-            case OtaManager::Status::Idle:       otaData["status"] = "idle"; break;
-            case OtaManager::Status::Uploading:   otaData["status"] = "uploading"; break;
-            case OtaManager::Status::Downloading: otaData["status"] = "downloading"; break;
-            case OtaManager::Status::Installing:  otaData["status"] = "installing"; break;
-            case OtaManager::Status::Success:     otaData["status"] = "success"; break;
-            case OtaManager::Status::Error:       otaData["status"] = "error"; break;
-            case OtaManager::Status::Rebooting:   otaData["status"] = "rebooting"; break;
+        DeviceNotify::Notification notification = {};
+        strlcpy(notification.source, remote.toString().c_str(), sizeof(notification.source));
+        if (request->hasParam("id")) {
+            strlcpy(notification.deviceId, request->getParam("id")->value().c_str(), sizeof(notification.deviceId));
         }
-        
-        if (event.progress >= 0) otaData["progress"] = event.progress;
-        if (event.error.length() > 0) otaData["error"] = event.error;
-        
-        String out;
-        serializeJson(doc, out);
-        broadcast(out);
+        if (request->hasParam("channel")) {
+            notification.channel = (uint8_t)request->getParam("channel")->value().toInt();
+        }
+        notification.on = request->hasParam("on")
+            ? DeviceNotify::parseState(request->getParam("on")->value().c_str()) : -1;
+        notification.watts = request->hasParam("power")
+            ? request->getParam("power")->value().toFloat() : NAN;
+
+        if (notification.on < 0 && isnan(notification.watts)) {
+            request->send(400, "application/json", "{\"error\":\"Expected on or power\"}");
+            return;
+        }
+        if (!DeviceNotify::submit(notification)) {
+            request->send(503, "application/json", "{\"error\":\"Busy\"}");
+            return;
+        }
+        request->send(200, "application/json", "{\"success\":true}");
     });
     
+    OtaManager::begin(server, postOtaStatus);
+    
     server->on("/*", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
         request->send(403);
     });
@@ -380,7 +431,14 @@ void loop() {
         }
     }
     
-    flushDeferred();
+    if (ws) flushOutboxes();
+
+    flushOtaStatus();
+
+    if (restorePending) {
+        restorePending = false;
+        if (restoreCallback) restoreCallback();
+    }
     
     size_t processed = 0;
     while (queueTail != queueHead && processed < MAX_INCOMING_PER_LOOP) {
@@ -397,47 +455,41 @@ void loop() {
     }
 }
 
-void broadcast(const String& message) {
+void broadcast(const JsonDocument& doc, const char* key) {
     if (!ws || ws->count() == 0) return;
-    
-    bool allCanSend = true;
+    WsFrame::Ref frame = WsFrame::serialize(doc);
     for (auto& client : ws->getClients()) {
-        if (client.status() == WS_CONNECTED && !client.canSend()) {
-            allCanSend = false;
-            break;
-        }
-    }
-    
-    if (allCanSend) {
-        ws->textAll(message);
-    } else {
-        enqueueDeferred(0, message, true);
+        if (client.status() == WS_CONNECTED) deliver(&client, frame, key);
     }
 }
 
-void sendTo(uint32_t clientId, const String& message) {
+void sendTo(uint32_t clientId, const JsonDocument& doc, const char* key) {
     if (!ws) return;
     AsyncWebSocketClient* client = ws->client(clientId);
     if (!client || client->status() != WS_CONNECTED) return;
-    
-    if (client->canSend()) {
-        client->text(message);
-    } else {
-        enqueueDeferred(clientId, message, false);
-    }
+    deliver(client, WsFrame::serialize(doc), key);
 }
 
 void onMessage(MessageCallback callback) {
     messageCallback = callback;
 }
 
+void onRestore(RestoreCallback callback) {
+    restoreCallback = callback;
+}
+
 bool hasClients() {
     return ws && ws->count() > 0;
 }
 
+size_t getClientCount() {
+    return ws ? ws->count() : 0;
+}
+
 size_t getDeferredCount() {
-    if (deferredHead >= deferredTail) return deferredHead - deferredTail;
-    return DEFERRED_QUEUE_SIZE - deferredTail + deferredHead;
+    size_t queued = 0;
+    for (auto& outbox : outboxes) queued += outbox.count;
+    return queued;
 }
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <functional>
 
 class AsyncWebServer;
@@ -8,16 +9,28 @@ class AsyncWebServer;
 namespace WebSocketServer {
 
 using MessageCallback = std::function<void(uint32_t clientId, const String& message)>;
+using RestoreCallback = std::function<void()>;
 
 AsyncWebServer* getServer(uint16_t port = 80);
 
 void init();
 void loop();
-void broadcast(const String& message);
-void sendTo(uint32_t clientId, const String& message);
+// The document is serialized once into a shared frame (see ws_frame.h);
+// a broadcast queues the same buffer for every client. A client that can't
+// keep up gets its own queue (see ws_outbox.h): frames with a `key` are state
+// and only the newest per key waits there; frames without one are always
+// delivered, in order. Call both from the main loop only: the queues have
+// no lock, so other tasks hand their messages to loop(), as OTA status and
+// onRestore do.
+void broadcast(const JsonDocument& doc, const char* key = nullptr);
+void sendTo(uint32_t clientId, const JsonDocument& doc, const char* key = nullptr);
 void onMessage(MessageCallback callback);
+// Runs from loop() after /api/config/restore has written the config files
+void onRestore(RestoreCallback callback);
 bool hasClients();
+size_t getClientCount();
 
+// Frames waiting in the per-client queues
 size_t getDeferredCount();
 
 }
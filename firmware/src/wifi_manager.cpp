@@ -1,6 +1,7 @@
 #include "wifi_manager.h"
 #include "captive_portal.h"
 #include "event_log.h"
+#include "time_utils.h"
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_sntp.h>
@@ -11,6 +12,7 @@ namespace {
     bool provisioningActive = false;
     bool wasConnected = false;
     volatile bool timeSynced = false;
+    volatile uint32_t timeSyncCount = 0;
     unsigned long lastReconnectAttempt = 0;
     const unsigned long RECONNECT_INTERVAL = 30000;
     int reconnectFailures = 0;
@@ -18,12 +20,13 @@ namespace {
 
     void onTimeSync(struct timeval* tv) {
         timeSynced = true;
+        timeSyncCount++;
         Serial.println("[WiFi] NTP time synced");
     }
 
     void startNTP() {
         sntp_set_time_sync_notification_cb(onTimeSync);
-        configTime(0, 0, "time.cloudflare.com", "pool.ntp.org");
+        configTzTime(TimeUtils::getTimezone(), "time.cloudflare.com", "pool.ntp.org");
         Serial.println("[WiFi] NTP time sync started");
     }
 
@@ -60,6 +63,10 @@ bool isTimeSynced() {
     return timeSynced;
 }
 
+uint32_t getTimeSyncCount() {
+    return timeSyncCount;
+}
+
 String getIP() {
     return WiFi.localIP().toString();
 }
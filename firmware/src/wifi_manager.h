@@ -8,6 +8,7 @@ namespace WiFiManager {
     
     bool isConnected();
     bool isTimeSynced();
+    uint32_t getTimeSyncCount();    // bumped on every NTP sync
     String getIP();
     
     void startProvisioning();
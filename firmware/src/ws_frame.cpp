@@ -0,0 +1,41 @@
+#include "ws_frame.h"
+#include <atomic>
+
+namespace WsFrame {
+
+namespace {
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> liveBytes{0};
+    size_t peakBytes = 0;
+    uint32_t created = 0;
+
+    struct Release {
+        size_t bytes;
+        void operator()(std::vector<uint8_t>* frame) const {
+            live--;
+            liveBytes -= bytes;
+            delete frame;
+        }
+    };
+}
+
+Ref serialize(const JsonDocument& doc) {
+    size_t length = measureJson(doc);
+    // serializeJson needs one byte past the text for its terminator
+    size_t bytes = length + 1;
+    Ref frame(new std::vector<uint8_t>(bytes), Release{bytes});
+    serializeJson(doc, (char*)frame->data(), bytes);
+    frame->resize(length);
+
+    live++;
+    size_t total = liveBytes += bytes;
+    if (total > peakBytes) peakBytes = total;
+    created++;
+    return frame;
+}
+
+Stats getStats() {
+    return {live, liveBytes, peakBytes, created};
+}
+
+}
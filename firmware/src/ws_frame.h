@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <memory>
+#include <vector>
+
+// Serialized WebSocket messages. A frame is immutable once built and shared
+// by every client queue it waits in, so a broadcast costs one buffer however
+// many clients are connected; it is freed when the last queue lets go. Ref
+// is the web server's AsyncWebSocketSharedBuffer.
+namespace WsFrame {
+
+using Ref = std::shared_ptr<std::vector<uint8_t>>;
+
+struct Stats {
+    size_t live;            // frames still referenced by some queue
+    size_t liveBytes;       // their buffers
+    size_t peakBytes;       // high-water mark of liveBytes
+    uint32_t created;
+};
+
+// Sized by measureJson first, so the buffer is allocated once at its size
+Ref serialize(const JsonDocument& doc);
+
+// Frames are released from the network task, so the counts are atomic
+Stats getStats();
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ws_frame.h"
+
+// Frames waiting for one client that can't take them yet, oldest first.
+// A keyed frame is state ("sensors", "devices", "device_status:fan"): a newer
+// frame with the same key replaces the queued one and moves to the back, so
+// it still lands after any delta queued since. Unkeyed frames (events,
+// deltas, replies) are never replaced or dropped; when the queue is full of
+// them push() fails, and the client is too far behind to catch up in order.
+struct WsOutbox {
+    static constexpr uint8_t CAPACITY = 16;
+    static constexpr size_t MAX_KEY_LENGTH = 40;
+
+    uint32_t clientId = 0;      // 0 while the slot is free
+    WsFrame::Ref frames[CAPACITY];
+    char keys[CAPACITY][MAX_KEY_LENGTH];
+    uint8_t count = 0;
+    uint32_t replaced = 0;
+
+    bool empty() const { return count == 0; }
+    const WsFrame::Ref& front() const { return frames[0]; }
+
+    bool push(const WsFrame::Ref& frame, const char* key) {
+        if (key && *key) {
+            for (uint8_t i = 0; i < count; i++) {
+                if (strcmp(keys[i], key) == 0) {
+                    removeAt(i);
+                    replaced++;
+                    break;
+                }
+            }
+        }
+        if (count == CAPACITY) return false;
+        frames[count] = frame;
+        strlcpy(keys[count], key ? key : "", MAX_KEY_LENGTH);
+        count++;
+        return true;
+    }
+
+    void pop() {
+        if (count > 0) removeAt(0);
+    }
+
+    void clear() {
+        while (count > 0) frames[--count].reset();
+    }
+
+private:
+    void removeAt(uint8_t index) {
+        for (uint8_t i = index; i + 1 < count; i++) {
+            frames[i] = std::move(frames[i + 1]);
+            memcpy(keys[i], keys[i + 1], MAX_KEY_LENGTH);
+        }
+        frames[--count].reset();
+    }
+};
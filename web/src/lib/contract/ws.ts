@@ -24,9 +24,12 @@ export const SensorTypeSchema = v.picklist([
 	"light",
 	"vpd",
 	"dewpoint",
+	"absolute_humidity",
+	"enthalpy",
 ]);
 
 export const HardwareTypeSchema = v.picklist(["sht3x", "sht4x", "scd4x", "as7341", "calculated"]);
+export const SensorAggregateSchema = v.picklist(["avg", "min", "max"]);
 
 export const DeviceTypeSchema = v.picklist([
 	"fan",
@@ -55,6 +58,11 @@ export const SensorSchema = v.strictObject({
 	tempSourceId: v.optional(v.string()),
 	humSourceId: v.optional(v.string()),
 	leafTempOffset: v.optional(v.number()),
+	aggregate: v.optional(SensorAggregateSchema),
+	sourceIds: v.optional(v.array(v.string())),
+	sampleIntervalMs: v.optional(v.number()),
+	oversample: v.optional(v.number()),
+	smoothing: v.optional(v.number()),
 });
 
 export const SensorReadingPayloadSchema = v.strictObject({
@@ -71,6 +79,7 @@ export const DeviceSchema = v.strictObject({
 	type: DeviceTypeSchema,
 	controlMethod: DeviceControlMethodSchema,
 	ipAddress: v.optional(v.string()),
+	channel: v.optional(v.number()),
 	isOn: v.boolean(),
 	isOnline: v.optional(v.boolean()),
 	controlMode: DeviceControlModeSchema,
@@ -98,10 +107,41 @@ export const ScheduleConfigSchema = v.strictObject({
 	endTime: v.string(),
 });
 
+// Leaves reuse the trigger, schedule and cycle keys; window times are in the
+// device's POSIX zone (system_info.timezone). The firmware compiles the tree
+// (at most 16 nodes, 6 levels deep) and runs it in place of `triggers`.
+export const RuleLeafSchema = v.union([
+	v.strictObject({
+		sensorId: v.string(),
+		dayThreshold: v.optional(v.number()),
+		nightThreshold: v.optional(v.number()),
+		deadzone: v.optional(v.number()),
+		triggerAbove: v.optional(v.boolean()),
+	}),
+	v.strictObject({ startTime: v.string(), endTime: v.optional(v.string()) }),
+	v.strictObject({ daytime: v.boolean() }),
+	v.strictObject({ deviceId: v.string(), isOn: v.optional(v.boolean()) }),
+	v.strictObject({ onDurationSec: v.number(), offDurationSec: v.optional(v.number()) }),
+]);
+
+export type RuleExpression =
+	| v.InferOutput<typeof RuleLeafSchema>
+	| { and: RuleExpression[] }
+	| { or: RuleExpression[] }
+	| { not: RuleExpression };
+
+export const RuleExpressionSchema: v.GenericSchema<RuleExpression> = v.union([
+	RuleLeafSchema,
+	v.strictObject({ and: v.array(v.lazy(() => RuleExpressionSchema)) }),
+	v.strictObject({ or: v.array(v.lazy(() => RuleExpressionSchema)) }),
+	v.strictObject({ not: v.lazy(() => RuleExpressionSchema) }),
+]);
+
 export const DeviceModeConfigSchema = v.strictObject({
 	deviceId: v.string(),
 	mode: DeviceModeSchema,
 	triggers: v.optional(v.array(AutoTriggerSchema)),
+	rule: v.optional(RuleExpressionSchema),
 	cycle: v.optional(CycleConfigSchema),
 	schedule: v.optional(ScheduleConfigSchema),
 });
@@ -162,6 +202,15 @@ function frame<TTag extends string, TData>(
 	});
 }
 
+// Entries changed since the previous frame for the same list: `remove` holds
+// ids to drop, applied before `upsert` replaces or appends entries by id
+function delta<TItem extends v.GenericSchema>(item: TItem) {
+	return v.strictObject({
+		upsert: v.array(item),
+		remove: v.array(v.string()),
+	});
+}
+
 function frameNoData<TTag extends string>(tag: TTag) {
 	return v.strictObject({
 		type: v.literal(tag),
@@ -179,10 +228,16 @@ export const SensorsMessage = frame("sensors", v.array(SensorReadingPayloadSchem
 
 export const SensorConfigMessage = frame("sensor_config", v.array(SensorSchema));
 
+export const SensorConfigDeltaMessage = frame("sensor_config_delta", delta(SensorSchema));
+
 export const DevicesMessage = frame("devices", v.array(DeviceSchema));
 
+export const DevicesDeltaMessage = frame("devices_delta", delta(DeviceSchema));
+
 export const DeviceModesMessage = frame("device_modes", v.array(DeviceModeConfigSchema));
 
+export const DeviceModesDeltaMessage = frame("device_modes_delta", delta(DeviceModeConfigSchema));
+
 export const ClimateConfigMessage = frame("climate_config", ClimateConfigPayloadSchema);
 
 export const EventsMessage = frame("events", v.array(EventEntrySchema));
@@ -191,6 +246,8 @@ export const EventMessage = frame("event", EventEntrySchema);
 
 export const EnergyMessage = frame("energy", v.array(DeviceEnergySchema));
 
+export const EnergyDeltaMessage = frame("energy_delta", delta(DeviceEnergySchema));
+
 export const DliMessage = frame("dli", v.strictObject({ dli: v.number() }));
 
 export const HistoryMessage = frame(
@@ -222,11 +279,22 @@ export const SystemInfoMessage = frame(
 		wifiRssi: v.number(),
 		ipAddress: v.string(),
 		firmwareVersion: v.string(),
+		timezone: v.string(),
+		timezoneSet: v.boolean(),
+		pollRate: v.number(),
+		pollTarget: v.number(),
+		wsClients: v.number(),
+		wsQueuedBytes: v.number(),
 	})
 );
 
 export const ClearHistoryAck = frame("clear_history", v.strictObject({ success: v.boolean() }));
 
+export const AddDeviceAck = frame(
+	"add_device",
+	v.strictObject({ success: v.boolean(), error: v.optional(v.string()) })
+);
+
 export const RestartAck = frame("restart", v.strictObject({ success: v.boolean() }));
 
 export const OtaStatusMessage = frame(
@@ -243,17 +311,22 @@ export const ServerToClientMessage = v.variant("type", [
 	PongMessage,
 	SensorsMessage,
 	SensorConfigMessage,
+	SensorConfigDeltaMessage,
 	DevicesMessage,
+	DevicesDeltaMessage,
 	DeviceModesMessage,
+	DeviceModesDeltaMessage,
 	ClimateConfigMessage,
 	EventsMessage,
 	EventMessage,
 	EnergyMessage,
+	EnergyDeltaMessage,
 	DliMessage,
 	HistoryMessage,
 	PpfdCalibrationMessage,
 	SystemInfoMessage,
 	ClearHistoryAck,
+	AddDeviceAck,
 	RestartAck,
 	OtaStatusMessage,
 ]);
@@ -289,6 +362,7 @@ export const DeviceControlRequest = frame(
 	v.strictObject({
 		method: v.string(),
 		target: v.string(),
+		channel: v.optional(v.number()),
 		on: v.boolean(),
 	})
 );
@@ -299,6 +373,7 @@ export const SetDeviceModeRequest = frame(
 		deviceId: v.string(),
 		mode: DeviceModeSchema,
 		triggers: v.optional(v.array(AutoTriggerSchema)),
+		rule: v.optional(RuleExpressionSchema),
 		cycle: v.optional(CycleConfigSchema),
 		schedule: v.optional(ScheduleConfigSchema),
 	})
@@ -317,6 +392,7 @@ export const AddDeviceRequest = frame(
 		deviceType: DeviceTypeSchema,
 		controlMethod: DeviceControlMethodSchema,
 		ipAddress: v.optional(v.string()),
+		channel: v.optional(v.number()),
 		controlMode: DeviceControlModeSchema,
 		hasEnergyMonitoring: v.optional(v.boolean()),
 	})
@@ -330,6 +406,7 @@ export const UpdateDeviceRequest = frame(
 		deviceType: v.optional(DeviceTypeSchema),
 		controlMethod: v.optional(DeviceControlMethodSchema),
 		ipAddress: v.optional(v.string()),
+		channel: v.optional(v.number()),
 		controlMode: v.optional(DeviceControlModeSchema),
 		hasEnergyMonitoring: v.optional(v.boolean()),
 	})
@@ -349,6 +426,11 @@ export const AddSensorRequest = frame(
 		tempSourceId: v.optional(v.string()),
 		humSourceId: v.optional(v.string()),
 		leafTempOffset: v.optional(v.number()),
+		aggregate: v.optional(v.picklist(["", "avg", "min", "max"])),
+		sourceIds: v.optional(v.array(v.string())),
+		sampleIntervalMs: v.optional(v.number()),
+		oversample: v.optional(v.number()),
+		smoothing: v.optional(v.number()),
 	})
 );
 
@@ -364,6 +446,11 @@ export const UpdateSensorRequest = frame(
 		tempSourceId: v.optional(v.string()),
 		humSourceId: v.optional(v.string()),
 		leafTempOffset: v.optional(v.number()),
+		aggregate: v.optional(v.picklist(["", "avg", "min", "max"])),
+		sourceIds: v.optional(v.array(v.string())),
+		sampleIntervalMs: v.optional(v.number()),
+		oversample: v.optional(v.number()),
+		smoothing: v.optional(v.number()),
 	})
 );
 
@@ -400,6 +487,8 @@ export const ResetClimateTargetsRequest = frame(
 	v.strictObject({ phase: ClimatePhaseSchema })
 );
 
+export const SetTimezoneRequest = frame("set_timezone", v.strictObject({ timezone: v.string() }));
+
 export const ClientToServerMessage = v.variant("type", [
 	PingRequest,
 	GetInitRequest,
@@ -432,6 +521,7 @@ export const ClientToServerMessage = v.variant("type", [
 	SetClimatePhaseRequest,
 	SetClimateTargetsRequest,
 	ResetClimateTargetsRequest,
+	SetTimezoneRequest,
 ]);
 
 // -----------------------------------------------------------------------------
@@ -446,17 +536,22 @@ export const WS_MESSAGE_TAGS = {
 		"pong",
 		"sensors",
 		"sensor_config",
+		"sensor_config_delta",
 		"devices",
+		"devices_delta",
 		"device_modes",
+		"device_modes_delta",
 		"climate_config",
 		"events",
 		"event",
 		"energy",
+		"energy_delta",
 		"dli",
 		"history",
 		"ppfd_calibration",
 		"system_info",
 		"clear_history",
+		"add_device",
 		"restart",
 		"ota_status",
 	],
@@ -492,6 +587,7 @@ export const WS_MESSAGE_TAGS = {
 		"set_climate_phase",
 		"set_climate_targets",
 		"reset_climate_targets",
+		"set_timezone",
 	],
 } as const;
 
@@ -4,6 +4,7 @@ import CloudIcon from "@lucide/svelte/icons/cloud";
 import SunIcon from "@lucide/svelte/icons/sun";
 import GaugeIcon from "@lucide/svelte/icons/gauge";
 import ThermometerSnowflakeIcon from "@lucide/svelte/icons/thermometer-snowflake";
+import FlameIcon from "@lucide/svelte/icons/flame";
 import FanIcon from "@lucide/svelte/icons/fan";
 import LightbulbIcon from "@lucide/svelte/icons/lightbulb";
 import HeaterIcon from "@lucide/svelte/icons/heater";
@@ -20,6 +21,8 @@ export const sensorIcons: Record<SensorType, Component> = {
 	light: SunIcon,
 	vpd: GaugeIcon,
 	dewpoint: ThermometerSnowflakeIcon,
+	absolute_humidity: BubblesIcon,
+	enthalpy: FlameIcon,
 };
 
 export const deviceIcons: Record<DeviceType, Component> = {
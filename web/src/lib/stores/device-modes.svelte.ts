@@ -1,6 +1,15 @@
 import type { DeviceModeConfig } from "$lib/types";
+import { applyDelta } from "$lib/utils";
 import { websocket } from "./websocket.svelte";
-import { localToUtc, utcToLocal } from "$lib/utils";
+
+function isDeviceModeConfig(item: unknown): item is DeviceModeConfig {
+	return (
+		item !== null &&
+		typeof item === "object" &&
+		typeof (item as Record<string, unknown>).deviceId === "string" &&
+		typeof (item as Record<string, unknown>).mode === "string"
+	);
+}
 
 export const deviceModes = $state<DeviceModeConfig[]>([]);
 
@@ -9,13 +18,9 @@ export function setDeviceMode(config: DeviceModeConfig): void {
 		deviceId: config.deviceId,
 		mode: config.mode,
 		triggers: config.triggers ?? [],
+		rule: config.rule,
 		cycle: config.cycle,
-		schedule: config.schedule
-			? {
-					startTime: localToUtc(config.schedule.startTime),
-					endTime: localToUtc(config.schedule.endTime),
-				}
-			: undefined,
+		schedule: config.schedule,
 	});
 }
 
@@ -30,24 +35,16 @@ export function getDeviceMode(deviceId: string): DeviceModeConfig | undefined {
 export function initDeviceModesWebSocket(): void {
 	websocket.on("device_modes", (data: unknown) => {
 		if (!Array.isArray(data)) return;
-		const items = data
-			.filter(
-				(item): item is DeviceModeConfig =>
-					item !== null &&
-					typeof item === "object" &&
-					typeof (item as Record<string, unknown>).deviceId === "string" &&
-					typeof (item as Record<string, unknown>).mode === "string"
-			)
-			.map((item) => ({
-				...item,
-				schedule: item.schedule
-					? {
-							startTime: utcToLocal(item.schedule.startTime),
-							endTime: utcToLocal(item.schedule.endTime),
-						}
-					: item.schedule,
-			}));
 		deviceModes.length = 0;
-		deviceModes.push(...items);
+		deviceModes.push(...data.filter(isDeviceModeConfig));
+	});
+
+	websocket.on("device_modes_delta", (data: unknown) => {
+		applyDelta(
+			deviceModes,
+			data,
+			(m) => m.deviceId,
+			(item) => (isDeviceModeConfig(item) ? item : undefined)
+		);
 	});
 }
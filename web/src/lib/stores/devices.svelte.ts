@@ -1,4 +1,6 @@
 import type { Device } from "$lib/types";
+import { applyDelta } from "$lib/utils";
+import { toast } from "svelte-sonner";
 import { websocket } from "./websocket.svelte";
 
 function parseTimestamp(value: unknown): Date | undefined {
@@ -8,6 +10,19 @@ function parseTimestamp(value: unknown): Date | undefined {
 	return undefined;
 }
 
+function parseDevice(item: unknown): Device | undefined {
+	if (!item || typeof item !== "object") return undefined;
+	const d = item as Device & { timestamp?: unknown };
+	if (typeof d.id !== "string" || typeof d.name !== "string") return undefined;
+	return {
+		...d,
+		isOn: d.isOn ?? false,
+		isOnline: d.isOnline ?? true,
+		hasEnergyMonitoring: d.hasEnergyMonitoring ?? false,
+		timestamp: parseTimestamp(d.timestamp),
+	};
+}
+
 export const devices = $state<Device[]>([]);
 export const pendingDevices = $state<Set<string>>(new Set());
 
@@ -31,6 +46,7 @@ export function toggleDevice(deviceId: string): void {
 	websocket.send("device_control", {
 		method: device.controlMethod,
 		target: getDeviceTarget(device),
+		channel: device.channel ?? 0,
 		on: newState,
 	});
 
@@ -49,6 +65,7 @@ export function addDevice(device: Device): void {
 		deviceType: device.type,
 		controlMethod: device.controlMethod,
 		ipAddress: device.ipAddress,
+		channel: device.channel ?? 0,
 		hasEnergyMonitoring: device.hasEnergyMonitoring ?? false,
 	});
 }
@@ -64,6 +81,7 @@ export function updateDevice(deviceId: string, updates: Partial<Omit<Device, "id
 		deviceType: updates.type,
 		controlMethod: updates.controlMethod,
 		ipAddress: updates.ipAddress,
+		channel: updates.channel,
 		hasEnergyMonitoring: updates.hasEnergyMonitoring,
 	});
 }
@@ -71,23 +89,20 @@ export function updateDevice(deviceId: string, updates: Partial<Omit<Device, "id
 export function initDeviceWebSocket(): void {
 	websocket.on("devices", (data: unknown) => {
 		if (!Array.isArray(data)) return;
-		const items = data.filter(
-			(item): item is Device & { timestamp?: unknown } =>
-				item &&
-				typeof item === "object" &&
-				typeof item.id === "string" &&
-				typeof item.name === "string"
-		);
 		devices.length = 0;
-		items.forEach((d) => {
-			devices.push({
-				...d,
-				isOn: d.isOn ?? false,
-				isOnline: d.isOnline ?? true,
-				hasEnergyMonitoring: d.hasEnergyMonitoring ?? false,
-				timestamp: parseTimestamp(d.timestamp),
-			});
-		});
+		for (const item of data) {
+			const device = parseDevice(item);
+			if (device) devices.push(device);
+		}
+	});
+
+	websocket.on("devices_delta", (data: unknown) => {
+		applyDelta(devices, data, (d) => d.id, parseDevice);
+	});
+
+	websocket.on("add_device", (data: unknown) => {
+		const msg = data as { success?: boolean; error?: string } | undefined;
+		if (msg && msg.success === false) toast.error(`Device not added: ${msg.error ?? "unknown error"}`);
 	});
 
 	websocket.on("device_status", (data: unknown) => {
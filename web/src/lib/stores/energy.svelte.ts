@@ -1,6 +1,20 @@
 import type { DeviceEnergy } from "$lib/types";
+import { applyDelta } from "$lib/utils";
 import { websocket } from "./websocket.svelte";
 
+function parseEnergy(item: unknown): DeviceEnergy | undefined {
+	if (!item || typeof item !== "object") return undefined;
+	const e = item as Record<string, unknown>;
+	if (typeof e.deviceId !== "string") return undefined;
+	return {
+		deviceId: e.deviceId,
+		deviceName: String(e.deviceName ?? ""),
+		watts: Number(e.watts ?? 0),
+		kWh: Number(e.kWh ?? 0),
+		resetTimestamp: new Date(Number(e.resetTimestamp ?? 0) * 1000),
+	};
+}
+
 export const deviceEnergies = $state<DeviceEnergy[]>([]);
 
 const _totalWatts = $derived(deviceEnergies.reduce((sum, d) => sum + d.watts, 0));
@@ -24,22 +38,14 @@ export function initEnergyWebSocket(): void {
 	websocket.on("energy", (data: unknown) => {
 		if (!Array.isArray(data)) return;
 
-		const items = data.filter(
-			(item): item is Record<string, unknown> =>
-				item !== null &&
-				typeof item === "object" &&
-				typeof (item as Record<string, unknown>).deviceId === "string"
-		);
-
 		deviceEnergies.length = 0;
-		for (const item of items) {
-			deviceEnergies.push({
-				deviceId: String(item.deviceId),
-				deviceName: String(item.deviceName ?? ""),
-				watts: Number(item.watts ?? 0),
-				kWh: Number(item.kWh ?? 0),
-				resetTimestamp: new Date(Number(item.resetTimestamp ?? 0) * 1000),
-			});
+		for (const item of data) {
+			const energy = parseEnergy(item);
+			if (energy) deviceEnergies.push(energy);
 		}
 	});
+
+	websocket.on("energy_delta", (data: unknown) => {
+		applyDelta(deviceEnergies, data, (e) => e.deviceId, parseEnergy);
+	});
 }
@@ -1,6 +1,16 @@
 import type { Sensor, SensorReading, HistoricalReading, SpectralData } from "$lib/types";
+import { applyDelta } from "$lib/utils";
 import { websocket } from "./websocket.svelte";
 
+function isSensor(item: unknown): item is Sensor {
+	return (
+		item !== null &&
+		typeof item === "object" &&
+		typeof (item as Record<string, unknown>).id === "string" &&
+		typeof (item as Record<string, unknown>).name === "string"
+	);
+}
+
 export const sensors = $state<Sensor[]>([]);
 export const sensorReadings = $state<Record<string, SensorReading>>({});
 export const sensorHistory = $state<Record<string, Record<string, HistoricalReading[]>>>({});
@@ -112,15 +122,12 @@ export function updateSensorReading(sensorId: string, value: number, timestamp?:
 export function initSensorWebSocket(): void {
 	websocket.on("sensor_config", (data: unknown) => {
 		if (!Array.isArray(data)) return;
-		const items = data.filter(
-			(item): item is Sensor =>
-				item &&
-				typeof item === "object" &&
-				typeof item.id === "string" &&
-				typeof item.name === "string"
-		);
 		sensors.length = 0;
-		sensors.push(...items);
+		sensors.push(...data.filter(isSensor));
+	});
+
+	websocket.on("sensor_config_delta", (data: unknown) => {
+		applyDelta(sensors, data, (s) => s.id, (item) => (isSensor(item) ? item : undefined));
 	});
 
 	websocket.on("sensors", (data: unknown) => {
@@ -232,6 +239,11 @@ export function addSensor(sensor: Sensor): void {
 		tempSourceId: sensor.tempSourceId ?? "",
 		humSourceId: sensor.humSourceId ?? "",
 		leafTempOffset: sensor.leafTempOffset ?? 0,
+		aggregate: sensor.aggregate,
+		sourceIds: sensor.sourceIds,
+		sampleIntervalMs: sensor.sampleIntervalMs,
+		oversample: sensor.oversample,
+		smoothing: sensor.smoothing,
 	});
 }
 
@@ -250,6 +262,11 @@ export function updateSensor(sensorId: string, updates: Partial<Omit<Sensor, "id
 		tempSourceId: updates.tempSourceId ?? "",
 		humSourceId: updates.humSourceId ?? "",
 		leafTempOffset: updates.leafTempOffset,
+		aggregate: updates.aggregate ?? "",
+		sourceIds: updates.sourceIds ?? [],
+		sampleIntervalMs: updates.sampleIntervalMs,
+		oversample: updates.oversample,
+		smoothing: updates.smoothing,
 	});
 }
 
@@ -1,12 +1,32 @@
 import type { SystemInfo } from "$lib/types";
+import { browserPosixTimezone } from "$lib/utils";
+import { toast } from "svelte-sonner";
 import { websocket } from "./websocket.svelte";
 
 export const systemInfo = $state<{ data: SystemInfo | null }>({ data: null });
 
+let initialized = false;
+let timezoneOffered = false;
+
+// A device nobody has given a zone runs in UTC, while schedules are entered
+// in local time; the first browser to connect supplies its own zone
+function adoptBrowserTimezone(info: SystemInfo): void {
+	if (info.timezoneSet || timezoneOffered) return;
+	timezoneOffered = true;
+	const timezone = browserPosixTimezone();
+	setTimezone(timezone);
+	toast.info(`Device time zone set to ${timezone}`, {
+		description: "Taken from this browser; change it under Settings.",
+	});
+}
+
 export function initSystemInfoWebSocket(): void {
+	if (initialized) return;
+	initialized = true;
 	websocket.on("system_info", (data: unknown) => {
 		if (data && typeof data === "object" && "uptime" in data) {
 			systemInfo.data = data as SystemInfo;
+			adoptBrowserTimezone(systemInfo.data);
 		}
 	});
 }
@@ -14,3 +34,7 @@ export function initSystemInfoWebSocket(): void {
 export function requestSystemInfo(): void {
 	websocket.send("get_system_info");
 }
+
+export function setTimezone(timezone: string): void {
+	websocket.send("set_timezone", { timezone });
+}
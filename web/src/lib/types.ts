@@ -54,6 +54,7 @@ export interface Device {
 	type: DeviceType;
 	controlMethod: DeviceControlMethod;
 	ipAddress?: string;
+	channel?: number;
 	isOn: boolean;
 	isOnline?: boolean;
 	controlMode: DeviceControlMode;
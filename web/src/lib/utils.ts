@@ -9,22 +9,100 @@ export function formatUnit(unit: string): string {
 	return /^[°%]/.test(unit) ? unit : ` ${unit}`;
 }
 
-export function utcToLocal(hhmm: string): string {
-	const match = /^(\d{1,2}):(\d{2})$/.exec(hhmm);
-	if (!match) return hhmm;
-	const utcMinutes = Number(match[1]) * 60 + Number(match[2]);
-	const offsetMinutes = -new Date().getTimezoneOffset();
-	const localMinutes = (((utcMinutes + offsetMinutes) % 1440) + 1440) % 1440;
-	return `${String(Math.floor(localMinutes / 60)).padStart(2, "0")}:${String(localMinutes % 60).padStart(2, "0")}`;
+const QUARTER_HOUR_MS = 15 * 60 * 1000;
+
+function posixOffset(minutesEast: number): string {
+	const sign = minutesEast > 0 ? "-" : "";
+	const abs = Math.abs(minutesEast);
+	const minutes = abs % 60;
+	return `${sign}${Math.floor(abs / 60)}${minutes ? `:${String(minutes).padStart(2, "0")}` : ""}`;
+}
+
+// POSIX wants letters; "GMT+1" and the like become a placeholder
+function zoneName(at: number, fallback: string): string {
+	const name = new Intl.DateTimeFormat("en-US", { timeZoneName: "short" })
+		.formatToParts(new Date(at))
+		.find((part) => part.type === "timeZoneName")?.value;
+	return name && /^[A-Za-z]{3,6}$/.test(name) ? name : fallback;
+}
+
+// POSIX "Mm.w.d/time" for a switch, in the wall time in force before it
+function posixRule(at: number, offsetBefore: number): string {
+	const local = new Date(at + offsetBefore * 60000);
+	const day = local.getUTCDate();
+	const daysInMonth = new Date(
+		Date.UTC(local.getUTCFullYear(), local.getUTCMonth() + 1, 0)
+	).getUTCDate();
+	const week = day + 7 > daysInMonth ? 5 : Math.ceil(day / 7);
+	const hours = local.getUTCHours();
+	const minutes = local.getUTCMinutes();
+	const time = minutes ? `/${hours}:${String(minutes).padStart(2, "0")}` : `/${hours}`;
+	return `M${local.getUTCMonth() + 1}.${week}.${local.getUTCDay()}${time === "/2" ? "" : time}`;
+}
+
+/**
+ * The browser's time zone as a POSIX TZ string for the device, e.g.
+ * "CET-1CEST,M3.5.0,M10.5.0/3". Rules are read from this year's DST switches.
+ */
+export function browserPosixTimezone(): string {
+	const offsetAt = (ms: number) => -new Date(ms).getTimezoneOffset();
+	const year = new Date().getFullYear();
+	const start = Date.UTC(year, 0, 1);
+	const end = Date.UTC(year + 1, 0, 1);
+
+	const switches: { at: number; before: number; after: number }[] = [];
+	for (let t = start; t < end; t += QUARTER_HOUR_MS) {
+		const before = offsetAt(t);
+		const after = offsetAt(t + QUARTER_HOUR_MS);
+		if (before !== after) switches.push({ at: t + QUARTER_HOUR_MS, before, after });
+	}
+
+	if (switches.length !== 2) {
+		const offset = offsetAt(start);
+		return `${zoneName(start, "STD")}${posixOffset(offset)}`;
+	}
+
+	const standard = Math.min(switches[0].before, switches[0].after);
+	const daylight = Math.max(switches[0].before, switches[0].after);
+	const toDst = switches.find((s) => s.after === daylight)!;
+	const toStd = switches.find((s) => s.after === standard)!;
+	const dstOffset = daylight - standard === 60 ? "" : posixOffset(daylight);
+	return (
+		`${zoneName(toStd.at, "STD")}${posixOffset(standard)}${zoneName(toDst.at, "DST")}${dstOffset}` +
+		`,${posixRule(toDst.at, standard)},${posixRule(toStd.at, daylight)}`
+	);
 }
 
-export function localToUtc(hhmm: string): string {
-	const match = /^(\d{1,2}):(\d{2})$/.exec(hhmm);
-	if (!match) return hhmm;
-	const localMinutes = Number(match[1]) * 60 + Number(match[2]);
-	const offsetMinutes = -new Date().getTimezoneOffset();
-	const utcMinutes = (((localMinutes - offsetMinutes) % 1440) + 1440) % 1440;
-	return `${String(Math.floor(utcMinutes / 60)).padStart(2, "0")}:${String(utcMinutes % 60).padStart(2, "0")}`;
+/**
+ * Applies a `*_delta` frame to a list mirrored from the firmware: ids in
+ * `remove` are dropped, then each parsed `upsert` entry replaces the entry
+ * with the same key or is appended.
+ */
+export function applyDelta<T>(
+	items: T[],
+	data: unknown,
+	keyOf: (item: T) => string,
+	parse: (raw: unknown) => T | undefined
+): void {
+	if (!data || typeof data !== "object") return;
+	const { upsert, remove } = data as { upsert?: unknown; remove?: unknown };
+
+	if (Array.isArray(remove)) {
+		const removed = new Set(remove);
+		for (let i = items.length - 1; i >= 0; i--) {
+			if (removed.has(keyOf(items[i]))) items.splice(i, 1);
+		}
+	}
+
+	if (Array.isArray(upsert)) {
+		for (const raw of upsert) {
+			const item = parse(raw);
+			if (!item) continue;
+			const index = items.findIndex((existing) => keyOf(existing) === keyOf(item));
+			if (index >= 0) items[index] = item;
+			else items.push(item);
+		}
+	}
 }
 
 // eslint-disable-next-line @typescript-eslint/no-explicit-any
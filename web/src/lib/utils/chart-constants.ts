@@ -7,6 +7,8 @@ export const SENSOR_TYPE_COLORS: Record<string, string> = {
 	light: "hsl(45, 93%, 47%)",
 	vpd: "hsl(280, 65%, 60%)",
 	dewpoint: "hsl(175, 70%, 45%)",
+	absolute_humidity: "hsl(210, 60%, 60%)",
+	enthalpy: "hsl(20, 80%, 55%)",
 };
 
 export const DEVICE_TYPE_COLORS: Record<DeviceType, string> = {
@@ -25,6 +27,8 @@ export const NORMALIZATION_RANGES: Record<string, [number, number]> = {
 	co2: [300, 2000],
 	light: [0, 1500],
 	vpd: [0, 2.5],
+	absolute_humidity: [0, 30],
+	enthalpy: [0, 100],
 	device: [0, 1],
 };
 
@@ -35,6 +39,8 @@ export const SENSOR_TYPE_LABELS: Record<string, string> = {
 	light: "Light",
 	vpd: "VPD",
 	dewpoint: "Dew Point",
+	absolute_humidity: "Absolute Humidity",
+	enthalpy: "Enthalpy",
 };
 
 export type TimeRange = "6h" | "24h" | "7d";